@@ -0,0 +1,177 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef MESH_ALLOC_COUNT
+
+/* Plain atomics only: anything that allocates would recurse. */
+static std::atomic< long long > _allocations(0);
+static std::atomic< long long > _frees(0);
+static std::atomic< long long > _bytes(0);
+
+static void _countAllocation(size_t size) {
+	_allocations.fetch_add(1, std::memory_order_relaxed);
+	_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void _countFree(void* pointer) {
+	if (pointer) {
+		_frees.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+#ifdef __GLIBC__
+
+/* Interpose the C allocator and forward to glibc's own entry points, so
+ * every allocation of the process passes through here. */
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void __libc_free(void* pointer);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+
+void* malloc(size_t size) noexcept {
+	_countAllocation(size);
+	return __libc_malloc(size);
+}
+
+void free(void* pointer) noexcept {
+	_countFree(pointer);
+	__libc_free(pointer);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+	_countAllocation(count * size);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+	_countAllocation(size);
+	_countFree(pointer);
+	return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+	_countAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+	_countAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+	if (alignment % sizeof(void*) || (alignment & (alignment - 1))) {
+		return EINVAL;
+	}
+	_countAllocation(size);
+	*pointer = __libc_memalign(alignment, size);
+	return *pointer || !size ? 0 : ENOMEM;
+}
+
+void* valloc(size_t size) noexcept {
+	_countAllocation(size);
+	return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) noexcept {
+	_countAllocation(size);
+	return __libc_pvalloc(size);
+}
+
+}
+
+#else
+
+/* Without glibc only the C++ allocation functions can be replaced; the
+ * array, nothrow and sized forms all end up in these two. */
+void* operator new(size_t size) {
+	_countAllocation(size);
+	if (void* pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	_countAllocation(size);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+	_countFree(pointer);
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	operator delete(pointer);
+}
+
+#endif
+
+bool allocationCountingEnabled() {
+	return true;
+}
+
+AllocationCount allocationCount() {
+	AllocationCount count;
+	count.allocations = _allocations.load(std::memory_order_relaxed);
+	count.frees = _frees.load(std::memory_order_relaxed);
+	count.bytes = _bytes.load(std::memory_order_relaxed);
+	return count;
+}
+
+#else
+
+bool allocationCountingEnabled() {
+	return false;
+}
+
+AllocationCount allocationCount() {
+	return AllocationCount();
+}
+
+#endif
+
+AllocationScope::AllocationScope() : mStart(allocationCount()) {
+}
+
+AllocationCount AllocationScope::count() const {
+	AllocationCount now = allocationCount();
+	now.allocations -= mStart.allocations;
+	now.frees -= mStart.frees;
+	now.bytes -= mStart.bytes;
+	return now;
+}
@@ -0,0 +1,39 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+/* Heap allocation counting for tests and benchmarks, to check that the
+ * steady state of a kernel allocates nothing.
+ *
+ * Built with MESH_ALLOC_COUNT defined. With glibc the counter sits in
+ * malloc itself, so it sees operator new as well as Eigen's aligned
+ * allocations; elsewhere only operator new is replaced and allocations
+ * Eigen makes directly through malloc go uncounted. Counts are process
+ * wide and cover every thread. Without MESH_ALLOC_COUNT nothing is
+ * replaced and all counts stay zero. */
+
+struct AllocationCount {
+	long long allocations = 0;
+	long long frees = 0;
+	long long bytes = 0; // requested by the allocations
+};
+
+bool allocationCountingEnabled();
+
+/* Totals since the process started. */
+AllocationCount allocationCount();
+
+/* Allocations made between construction and count(), e.g.
+ *   AllocationScope scope;
+ *   polynomialSmooth(mesh, cache, options, workspace);
+ *   assert(scope.count().allocations == 0); */
+class AllocationScope {
+public:
+	AllocationScope();
+
+	AllocationCount count() const;
+
+private:
+	AllocationCount mStart;
+};
+
+#endif
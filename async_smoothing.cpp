@@ -0,0 +1,192 @@
+#include "async_smoothing.h"
+#include "laplacian.h"
+#include "mesh.h"
+
+CancellationToken::CancellationToken() : mFlag(std::make_shared< std::atomic< bool > >(false)) {
+}
+
+void CancellationToken::cancel() {
+	mFlag->store(true);
+}
+
+bool CancellationToken::isCancelled() const {
+	return mFlag->load();
+}
+
+struct AsyncSmoother::Job {
+	AsyncSmoothOptions options;
+	ProgressCallback progress;
+	CancellationToken token;
+	Revision topology;
+	Eigen::SparseMatrix< double > L;
+	Eigen::MatrixXd X;
+	std::shared_ptr< std::vector< int > > ringOffsets;
+	std::shared_ptr< std::vector< int > > ringNeighbors;
+};
+
+AsyncSmoother::AsyncSmoother() : mWorker(1), mBusy(false) {
+	mGeneration = 0;
+	mApplied = 0;
+	mRingMesh = nullptr;
+	mRingTopology = 0;
+}
+
+AsyncSmoother::~AsyncSmoother() {
+	cancel();
+	wait();
+}
+
+CancellationToken AsyncSmoother::start(const Mesh& mesh,
+                                       LaplacianCache& cache,
+                                       const AsyncSmoothOptions& options,
+                                       ProgressCallback progress) {
+	cancel();
+	wait();
+
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int n = vertices.size();
+	auto job = std::make_shared< Job >();
+	job->options = options;
+	job->progress = progress;
+	if (options.method != ASYNC_NORMALS) {
+		job->L = cache.matrix(mesh, options.cotangentWeights);
+	}
+	job->X.resize(n, 3);
+	for (int i = 0; i < n; ++i) {
+		job->X.row(i) = vertices[i]->position().cast< double >().transpose();
+	}
+
+	Revision topology = topologyRevision(mesh);
+	job->topology = topology;
+	if (mRingMesh != &mesh || mRingTopology != topology) {
+		// Fresh vectors, the previous ones may still be held by a job
+		mRingOffsets = std::make_shared< std::vector< int > >(n + 1, 0);
+		mRingNeighbors = std::make_shared< std::vector< int > >();
+		mRingNeighbors->reserve(n * 6);
+		for (int i = 0; i < n; ++i) {
+			// Same traversal order as computeVertexNormals
+			HEdge* edge = vertices[i]->halfEdge();
+			HEdge* anedge = edge;
+			do {
+				mRingNeighbors->push_back(anedge->end()->index());
+				anedge = anedge->twin()->next();
+			} while (anedge != edge);
+			(*mRingOffsets)[i + 1] = mRingNeighbors->size();
+		}
+		mRingMesh = &mesh;
+		mRingTopology = topology;
+	}
+	job->ringOffsets = mRingOffsets;
+	job->ringNeighbors = mRingNeighbors;
+
+	mToken = CancellationToken();
+	job->token = mToken;
+	mBusy = true;
+	mRunning = mWorker.submit([this, job]() { run(job); });
+	return mToken;
+}
+
+void AsyncSmoother::cancel() {
+	mToken.cancel();
+}
+
+void AsyncSmoother::wait() {
+	if (mRunning.valid()) {
+		mRunning.wait();
+	}
+}
+
+bool AsyncSmoother::isRunning() const {
+	return mBusy.load();
+}
+
+std::shared_ptr< const MeshGeneration > AsyncSmoother::latest() const {
+	return std::atomic_load(&mLatest);
+}
+
+bool AsyncSmoother::apply(Mesh& mesh) {
+	std::shared_ptr< const MeshGeneration > generation = latest();
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	if (!generation || generation->generation == mApplied || generation->topology != topologyRevision(mesh)
+	    || generation->positions.rows() != (int)vertices.size()) {
+		return false;
+	}
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		vertices[i]->setPosition(generation->positions.row(i).transpose());
+		vertices[i]->setNormal(generation->normals.row(i).transpose());
+	}
+	mApplied = generation->generation;
+	mesh.setVertexPosDirty(true);
+	mesh.setVertexNormalDirty(true);
+	return true;
+}
+
+void AsyncSmoother::run(const std::shared_ptr< Job >& job) {
+	const AsyncSmoothOptions& options = job->options;
+	int n = job->X.rows();
+	int steps = options.method == ASYNC_NORMALS ? 0 : options.iterations;
+
+	Eigen::SparseMatrix< float > A;
+	if (options.method == ASYNC_IMPLICIT) {
+		Eigen::SparseMatrix< double > I(n, n);
+		I.setIdentity();
+		A = (I - options.lambda * job->L).cast< float >();
+	}
+	for (int k = 0; k < steps; ++k) {
+		if (job->token.isCancelled()) {
+			mBusy = false;
+			return;
+		}
+		if (options.method == ASYNC_EXPLICIT) {
+			job->X += options.lambda * (job->L * job->X);
+		} else {
+			SolveTrace trace;
+			trace.source = "AsyncSmoother";
+			Eigen::MatrixXd X = job->X;
+			solveColumns(A, job->X, X, options.solve, &trace);
+			reportSolveTrace(trace, options.solve);
+			job->X = X;
+		}
+		if (job->progress) {
+			job->progress(float(k + 1) / (steps + 1));
+		}
+	}
+	if (job->token.isCancelled()) {
+		mBusy = false;
+		return;
+	}
+	publish(job);
+	if (job->progress) {
+		job->progress(1.0f);
+	}
+	mBusy = false;
+}
+
+void AsyncSmoother::publish(const std::shared_ptr< Job >& job) {
+	int n = job->X.rows();
+	auto generation = std::make_shared< MeshGeneration >();
+	generation->topology = job->topology;
+	generation->positions = job->X.cast< float >();
+	generation->normals.setZero(n, 3);
+
+	// Area-weighted face normals around each one-ring, as computeVertexNormals
+	const std::vector< int >& offsets = *job->ringOffsets;
+	const std::vector< int >& neighbors = *job->ringNeighbors;
+	const VertexMatrix& P = generation->positions;
+	for (int i = 0; i < n; ++i) {
+		int begin = offsets[i];
+		int count = offsets[i + 1] - begin;
+		Eigen::Vector3f center = P.row(i).transpose();
+		Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+		for (int j = 0; j < count; ++j) {
+			Eigen::Vector3f a = P.row(neighbors[begin + j]).transpose() - center;
+			Eigen::Vector3f b = P.row(neighbors[begin + (j + 1) % count]).transpose() - center;
+			normal += b.cross(a);
+		}
+		normal.normalize();
+		generation->normals.row(i) = normal.transpose();
+	}
+
+	generation->generation = ++mGeneration;
+	std::atomic_store(&mLatest, std::shared_ptr< const MeshGeneration >(generation));
+}
@@ -0,0 +1,118 @@
+#ifndef ASYNC_SMOOTHING_H
+#define ASYNC_SMOOTHING_H
+
+#include "revision.h"
+#include "solver.h"
+#include "spmv.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Mesh;
+class LaplacianCache;
+
+/* Positions and normals produced by one finished background job. Once
+ * published a generation is never modified, so readers may hold on to
+ * it for as long as they like. */
+struct MeshGeneration {
+	int generation = 0;
+	// Topology revision of the mesh the job started from
+	Revision topology = 0;
+	VertexMatrix positions;
+	VertexMatrix normals;
+};
+
+/* Shared flag a running job polls between steps. Copies refer to the
+ * same flag. */
+class CancellationToken {
+public:
+	CancellationToken();
+
+	void cancel();
+	bool isCancelled() const;
+
+private:
+	std::shared_ptr< std::atomic< bool > > mFlag;
+};
+
+enum AsyncSmoothMethod {
+	ASYNC_EXPLICIT, // x += lambda * L x
+	ASYNC_IMPLICIT, // (I - lambda * L) x' = x
+	ASYNC_NORMALS   // only recompute normals of the current positions
+};
+
+struct AsyncSmoothOptions {
+	AsyncSmoothMethod method = ASYNC_IMPLICIT;
+	bool cotangentWeights = true;
+	double lambda = 1.0;
+	int iterations = 1;
+	SolveOptions solve;
+};
+
+/* Called on the worker thread with the completed fraction in [0, 1]. */
+typedef std::function< void(float) > ProgressCallback;
+
+/* Runs smoothing on a worker thread against a private copy of the
+ * positions, so the mesh is never written while the renderer reads it.
+ *
+ * start() snapshots positions, the operator and the one-ring lists on
+ * the calling thread and returns at once. When the job finishes it
+ * publishes a new MeshGeneration with a single atomic pointer swap;
+ * the viewer keeps drawing latest() until then and may copy a newer
+ * generation into the mesh with apply() on its own thread. A cancelled
+ * job publishes nothing. */
+class AsyncSmoother {
+public:
+	AsyncSmoother();
+	/* Cancels the running job and waits for it. */
+	~AsyncSmoother();
+
+	/* Cancel any running job and start a new one. */
+	CancellationToken start(const Mesh& mesh,
+	                        LaplacianCache& cache,
+	                        const AsyncSmoothOptions& options,
+	                        ProgressCallback progress = ProgressCallback());
+
+	void cancel();
+	/* Block until the current job, if any, has finished. */
+	void wait();
+	bool isRunning() const;
+
+	/* Last published generation, or null before the first one. */
+	std::shared_ptr< const MeshGeneration > latest() const;
+
+	/* Copy latest() into the mesh if it is newer than what was applied
+	 * before and was computed from the mesh's current topology revision,
+	 * so a reloaded or different mesh never receives it. Call this from
+	 * the thread that owns the mesh. Returns true when positions
+	 * changed. */
+	bool apply(Mesh& mesh);
+
+private:
+	struct Job;
+
+	void run(const std::shared_ptr< Job >& job);
+	void publish(const std::shared_ptr< Job >& job);
+
+	ThreadPool mWorker;
+	std::future< void > mRunning;
+	CancellationToken mToken;
+	std::atomic< bool > mBusy;
+
+	// Published generations are swapped with std::atomic_store
+	std::shared_ptr< const MeshGeneration > mLatest;
+	int mGeneration;
+	int mApplied;
+
+	// One-ring lists in traversal order, cached across jobs
+	const Mesh* mRingMesh;
+	Revision mRingTopology;
+	std::shared_ptr< std::vector< int > > mRingOffsets;
+	std::shared_ptr< std::vector< int > > mRingNeighbors;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "batch_smoothing.h"
+#include "laplacian.h"
+#include "mesh.h"
+#include "multigrid.h"
+#include "spmv.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+BatchSmoothStats batchSmooth(const std::vector< Mesh* >& meshes, const BatchSmoothOptions& options) {
+	BatchSmoothStats stats;
+	ThreadPool& pool = options.pool ? *options.pool : ThreadPool::global();
+	int numMeshes = meshes.size();
+	stats.numMeshes = numMeshes;
+	if (numMeshes == 0) {
+		return stats;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector< Eigen::SparseMatrix< float > > blocks(numMeshes);
+	pool.parallelFor(numMeshes, [&](int k) {
+		blocks[k] = umbrellaOperator(*meshes[k], options.cotangentWeights).cast< float >();
+		blocks[k].makeCompressed();
+	});
+
+	// Row and non-zero offsets of every block
+	std::vector< int > rowOffsets(numMeshes + 1, 0);
+	std::vector< int > nnzOffsets(numMeshes + 1, 0);
+	int largestBlock = 0;
+	for (int k = 0; k < numMeshes; ++k) {
+		largestBlock = std::max(largestBlock, (int)blocks[k].rows());
+		rowOffsets[k + 1] = rowOffsets[k] + blocks[k].rows();
+		nnzOffsets[k + 1] = nnzOffsets[k] + blocks[k].nonZeros();
+	}
+	int n = rowOffsets[numMeshes];
+	stats.numVertices = n;
+	stats.nonZeros = nnzOffsets[numMeshes];
+
+	// Block-diagonal L by concatenating the compressed columns directly
+	Eigen::SparseMatrix< float > L(n, n);
+	L.resizeNonZeros(stats.nonZeros);
+	VertexMatrix X(n, 3);
+	L.outerIndexPtr()[n] = stats.nonZeros;
+	pool.parallelFor(numMeshes, [&](int k) {
+		const Eigen::SparseMatrix< float >& block = blocks[k];
+		int rows = rowOffsets[k];
+		int nnz = nnzOffsets[k];
+		for (int j = 0; j < block.cols(); ++j) {
+			L.outerIndexPtr()[rows + j] = nnz + block.outerIndexPtr()[j];
+		}
+		for (int e = 0; e < block.nonZeros(); ++e) {
+			L.innerIndexPtr()[nnz + e] = rows + block.innerIndexPtr()[e];
+			L.valuePtr()[nnz + e] = block.valuePtr()[e];
+		}
+		const std::vector< Vertex* >& vertices = meshes[k]->vertices();
+		for (int i = 0; i < (int)vertices.size(); ++i) {
+			X.row(rows + i) = vertices[i]->position().transpose();
+		}
+		blocks[k] = Eigen::SparseMatrix< float >();
+	});
+	stats.assemblySeconds = _seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	if (options.implicit) {
+		// A = I - lambda * L, written over L: every row holds its -1 diagonal
+		Eigen::SparseMatrix< float >& A = L;
+		float lambda = options.lambda;
+		pool.parallelFor(numMeshes, [&](int m) {
+			for (int j = rowOffsets[m]; j < rowOffsets[m + 1]; ++j) {
+				for (Eigen::SparseMatrix< float >::InnerIterator it(A, j); it; ++it) {
+					it.valueRef() = (it.row() == j ? 1.0f : 0.0f) - lambda * it.value();
+				}
+			}
+		});
+		const SolveOptions& solve = options.solve;
+		if (solve.precision == SOLVER_SINGLE) {
+			// Every mesh converges on its own: blockBicgstab keeps the
+			// inner products and the stopping test per block. Aggregates
+			// never cross blocks, so multigrid stays block-diagonal and is
+			// chosen by the largest mesh rather than the stacked size.
+			SellMatrix sell(A);
+			sell.setPool(&pool);
+			MultigridSolver multigrid;
+			const Preconditioner* M = nullptr;
+			if (largestBlock >= solve.multigridMinSize) {
+				multigrid.setup(A);
+				M = &multigrid;
+			}
+			Eigen::VectorXf b(n);
+			Eigen::VectorXf x(n);
+			for (int k = 0; k < options.iterations; ++k) {
+				SolveTrace trace;
+				trace.source = "batchSmooth";
+				trace.rows = n;
+				trace.nonZeros = A.nonZeros();
+				trace.multigridLevels = M ? multigrid.numLevels() : 0;
+				trace.errorTolerance = solve.errorTolerance;
+				trace.maxIterations = solve.maxIterations;
+				trace.columns.assign(3, KrylovTrace());
+				auto solveStart = std::chrono::steady_clock::now();
+				for (int j = 0; j < 3; ++j) {
+					// Zero initial guess, as implicitSmooth uses per mesh
+					b = X.col(j);
+					x.setZero();
+					blockBicgstab(sell, rowOffsets, b, x, solve.maxIterations, solve.errorTolerance, M,
+					              &trace.columns[j]);
+					X.col(j) = x;
+				}
+				trace.solveSeconds = _seconds(solveStart);
+				reportSolveTrace(trace, solve);
+			}
+		} else {
+			// Refinement tests a relative residual, which does not
+			// decompose over blocks, so each mesh is refined on its own
+			pool.parallelFor(numMeshes, [&](int m) {
+				int rows = rowOffsets[m];
+				int size = rowOffsets[m + 1] - rows;
+				Eigen::SparseMatrix< float > block = A.block(rows, rows, size, size);
+				Eigen::MatrixXd B = X.block(rows, 0, size, 3).cast< double >();
+				Eigen::MatrixXd Y;
+				for (int k = 0; k < options.iterations; ++k) {
+					SolveTrace trace;
+					trace.source = "batchSmooth";
+					solveColumns(block, B, Y, solve, &trace);
+					reportSolveTrace(trace, solve);
+					B = Y;
+				}
+				X.block(rows, 0, size, 3) = B.cast< float >();
+			});
+		}
+	} else {
+		SellMatrix sell(L);
+		sell.setPool(&pool);
+		VertexMatrix LX(n, 3);
+		for (int k = 0; k < options.iterations; ++k) {
+			sell.multiply(X, LX);
+			X += float(options.lambda) * LX;
+		}
+	}
+	stats.smoothSeconds = _seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	pool.parallelFor(numMeshes, [&](int k) {
+		Mesh& mesh = *meshes[k];
+		const std::vector< Vertex* >& vertices = mesh.vertices();
+		int rows = rowOffsets[k];
+		for (int i = 0; i < (int)vertices.size(); ++i) {
+			vertices[i]->setPosition(X.row(rows + i).transpose());
+		}
+		mesh.computeVertexNormals();
+		mesh.setVertexPosDirty(true);
+	});
+	stats.scatterSeconds = _seconds(start);
+	return stats;
+}
@@ -0,0 +1,45 @@
+#ifndef BATCH_SMOOTHING_H
+#define BATCH_SMOOTHING_H
+
+#include "solver.h"
+#include <vector>
+
+class Mesh;
+class ThreadPool;
+
+struct BatchSmoothOptions {
+	bool implicit = false;
+	bool cotangentWeights = true;
+	double lambda = 1.0;
+	int iterations = 1;
+	// Implicit only
+	SolveOptions solve;
+	// Defaults to ThreadPool::global()
+	ThreadPool* pool = nullptr;
+};
+
+/* Where the time of one batchSmooth call went, in seconds. */
+struct BatchSmoothStats {
+	int numMeshes = 0;
+	int numVertices = 0;
+	int nonZeros = 0;
+	double assemblySeconds = 0.0;
+	double smoothSeconds = 0.0;
+	double scatterSeconds = 0.0;
+};
+
+/* Smooth many meshes at once. The umbrella operators of all meshes are
+ * assembled in parallel and packed into one block-diagonal SELL-C
+ * matrix over the stacked positions, so every explicit step is a single
+ * parallel product and every implicit step a single blockBicgstab per
+ * coordinate for the whole batch, in which each mesh converges against
+ * errorTolerance on its own. Mixed precision refines each mesh
+ * separately instead. Positions are scattered back and normals
+ * recomputed per mesh, again in parallel. Meshes must be distinct
+ * objects. The gain comes only from spreading the batch over the pool:
+ * on a single thread a loop of implicitSmooth is faster, since each small
+ * mesh stays in cache while the stacked vectors do not. bench/batch_bench
+ * measures both. */
+BatchSmoothStats batchSmooth(const std::vector< Mesh* >& meshes, const BatchSmoothOptions& options);
+
+#endif
@@ -0,0 +1,117 @@
+/* Throughput benchmark of batchSmooth against a loop of implicitSmooth.
+ *
+ * Usage: batch_bench [meshes] [subdivisions] [repetitions]
+ *
+ * The batch is made of noisy scan spheres, each with a different seed, so
+ * the meshes need different numbers of iterations. Both variants run one
+ * implicit cotangent step on freshly loaded meshes, including operator
+ * assembly and the normal update, and report meshes per second together
+ * with the worst iteration count and the largest difference between the
+ * two results. */
+#include "batch_smoothing.h"
+#include "mesh.h"
+#include "mesh_generators.h"
+#include "mesh_io.h"
+#include "smoothing.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+typedef std::vector< std::unique_ptr< Mesh > > MeshList;
+
+static bool _load(const std::vector< MeshArrays >& arrays, MeshList& meshes) {
+	meshes.clear();
+	for (const MeshArrays& a : arrays) {
+		meshes.emplace_back(new Mesh);
+		if (!loadMeshArrays(*meshes.back(), a)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? std::max(1, atoi(argv[1])) : 1000;
+	int subdivisions = argc > 2 ? std::max(0, atoi(argv[2])) : 3;
+	int reps = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+
+	std::vector< MeshArrays > arrays;
+	for (int k = 0; k < count; ++k) {
+		GeneratorOptions generator;
+		generator.seed = k + 1;
+		generator.noise = 0.3f;
+		arrays.push_back(generateScanSphere(subdivisions, 0, generator));
+	}
+	printf("meshes %d, vertices %d each, threads %d\n", count, (int)arrays[0].positions.rows(),
+	       ThreadPool::global().size());
+
+	MeshList single;
+	MeshList batch;
+	double bestSingle = 1e30;
+	double bestBatch = 1e30;
+	int singleIterations = 0;
+	int batchIterations = 0;
+	bool converged = true;
+	BatchSmoothStats stats;
+	for (int r = 0; r < reps; ++r) {
+		if (!_load(arrays, single)) {
+			return 1;
+		}
+		ImplicitSmoothOptions options;
+		options.solve.traceCallback = [&](const SolveTrace& trace) {
+			singleIterations = std::max(singleIterations, trace.iterations());
+		};
+		auto start = std::chrono::steady_clock::now();
+		for (std::unique_ptr< Mesh >& mesh : single) {
+			implicitSmooth(*mesh, options);
+		}
+		bestSingle = std::min(bestSingle, _seconds(start));
+
+		if (!_load(arrays, batch)) {
+			return 1;
+		}
+		std::vector< Mesh* > meshes;
+		for (std::unique_ptr< Mesh >& mesh : batch) {
+			meshes.push_back(mesh.get());
+		}
+		BatchSmoothOptions batchOptions;
+		batchOptions.implicit = true;
+		batchOptions.solve.traceCallback = [&](const SolveTrace& trace) {
+			batchIterations = std::max(batchIterations, trace.iterations());
+			converged = converged && trace.converged();
+		};
+		start = std::chrono::steady_clock::now();
+		BatchSmoothStats s = batchSmooth(meshes, batchOptions);
+		double seconds = _seconds(start);
+		if (seconds < bestBatch) {
+			bestBatch = seconds;
+			stats = s;
+		}
+	}
+
+	float err = 0.0f;
+	for (int k = 0; k < count; ++k) {
+		const std::vector< Vertex* >& a = single[k]->vertices();
+		const std::vector< Vertex* >& b = batch[k]->vertices();
+		for (int i = 0; i < (int)a.size(); ++i) {
+			err = std::max(err, (a[i]->position() - b[i]->position()).cwiseAbs().maxCoeff());
+		}
+	}
+
+	printf("%-28s %10s %12s %12s\n", "variant", "ms", "meshes/s", "iterations");
+	printf("%-28s %10.3f %12.1f %12d\n", "implicitSmooth per mesh", bestSingle * 1e3, count / bestSingle,
+	       singleIterations);
+	printf("%-28s %10.3f %12.1f %12d   converged %s, max diff %g\n", "batchSmooth", bestBatch * 1e3,
+	       count / bestBatch, batchIterations, converged ? "yes" : "no", err);
+	printf("  batch assembly %.3f ms, smooth %.3f ms, scatter %.3f ms\n", stats.assemblySeconds * 1e3,
+	       stats.smoothSeconds * 1e3, stats.scatterSeconds * 1e3);
+	return 0;
+}
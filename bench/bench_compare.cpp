@@ -0,0 +1,333 @@
+/* Regression gate between two mesh_bench reports.
+ *
+ * Usage: bench_compare [--threshold percent] [--confidence level]
+ *                      [--resamples n] [--min-samples n] [--filter text]
+ *                      [--require-all] baseline.json candidate.json
+ *
+ * Benchmarks are matched by name ("stage/faces"). For each pair the
+ * ratio of the candidate median to the baseline median is reported with
+ * a bootstrap confidence interval: both sample sets are resampled with
+ * replacement and the percentile interval of the resampled median ratio
+ * is taken. The resampling is seeded and draws its indices from the raw
+ * mt19937 output, whose sequence the standard fixes, so a rerun on the
+ * same files gives the same intervals with any standard library.
+ *
+ * A benchmark regressed when its median ratio exceeds 1 + threshold and
+ * the whole interval lies above 1, i.e. the slowdown is both large enough
+ * to matter and not explained by the spread of the repetitions. With few
+ * repetitions the bootstrap has next to nothing to resample, so a pair
+ * with fewer than --min-samples on either side is shown but never
+ * flagged either way; run mesh_bench with --repetitions 10 or more for a
+ * useful gate. Defaults: 5 percent, 0.95, 2000 resamples, 5 samples.
+ *
+ * Exit status: 0 when nothing regressed, 1 on a regression (or on a
+ * baseline benchmark missing from the candidate with --require-all),
+ * 2 when the options or the files cannot be read. */
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* The little JSON that mesh_bench writes: objects, arrays, strings,
+ * numbers and literals. Values the comparison ignores are skipped. */
+struct _JsonValue {
+	enum Type { NONE, NUMBER, STRING, ARRAY, OBJECT };
+
+	Type type = NONE;
+	double number = 0.0;
+	std::string text;
+	std::vector< _JsonValue > items;
+	std::vector< std::pair< std::string, _JsonValue > > members;
+
+	const _JsonValue* find(const char* key) const {
+		for (const std::pair< std::string, _JsonValue >& member : members) {
+			if (member.first == key) {
+				return &member.second;
+			}
+		}
+		return nullptr;
+	}
+};
+
+class _JsonParser {
+public:
+	explicit _JsonParser(const std::string& text) : mText(text), mPos(0) {}
+
+	bool parse(_JsonValue& value) {
+		return parseValue(value) && (skipSpace(), mPos == mText.size());
+	}
+
+private:
+	void skipSpace() {
+		while (mPos < mText.size() && std::isspace((unsigned char)mText[mPos])) {
+			++mPos;
+		}
+	}
+
+	bool consume(char c) {
+		skipSpace();
+		if (mPos < mText.size() && mText[mPos] == c) {
+			++mPos;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseString(std::string& out) {
+		if (!consume('"')) {
+			return false;
+		}
+		while (mPos < mText.size() && mText[mPos] != '"') {
+			if (mText[mPos] == '\\' && mPos + 1 < mText.size()) {
+				++mPos; // escapes are kept verbatim, names have none
+			}
+			out += mText[mPos++];
+		}
+		return mPos++ < mText.size();
+	}
+
+	bool parseValue(_JsonValue& value) {
+		skipSpace();
+		if (mPos >= mText.size()) {
+			return false;
+		}
+		char c = mText[mPos];
+		if (c == '{') {
+			value.type = _JsonValue::OBJECT;
+			++mPos;
+			if (consume('}')) {
+				return true;
+			}
+			do {
+				std::pair< std::string, _JsonValue > member;
+				if (!parseString(member.first) || !consume(':') || !parseValue(member.second)) {
+					return false;
+				}
+				value.members.push_back(std::move(member));
+			} while (consume(','));
+			return consume('}');
+		}
+		if (c == '[') {
+			value.type = _JsonValue::ARRAY;
+			++mPos;
+			if (consume(']')) {
+				return true;
+			}
+			do {
+				value.items.push_back(_JsonValue());
+				if (!parseValue(value.items.back())) {
+					return false;
+				}
+			} while (consume(','));
+			return consume(']');
+		}
+		if (c == '"') {
+			value.type = _JsonValue::STRING;
+			return parseString(value.text);
+		}
+		if (c == '-' || std::isdigit((unsigned char)c)) {
+			char* end = nullptr;
+			value.type = _JsonValue::NUMBER;
+			value.number = std::strtod(mText.c_str() + mPos, &end);
+			mPos = end - mText.c_str();
+			return true;
+		}
+		for (const char* literal : {"true", "false", "null"}) {
+			if (!mText.compare(mPos, std::strlen(literal), literal)) {
+				mPos += std::strlen(literal);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const std::string& mText;
+	size_t mPos;
+};
+
+/* Samples in seconds per benchmark name. */
+static bool _readReport(const char* filename, std::map< std::string, std::vector< double > >& samples) {
+	std::ifstream in(filename);
+	if (!in) {
+		std::fprintf(stderr, "cannot read %s\n", filename);
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	std::string text = buffer.str();
+	_JsonValue root;
+	const _JsonValue* benchmarks = nullptr;
+	if (!_JsonParser(text).parse(root) || !(benchmarks = root.find("benchmarks")) ||
+	    benchmarks->type != _JsonValue::ARRAY) {
+		std::fprintf(stderr, "%s is not a mesh_bench report\n", filename);
+		return false;
+	}
+	for (const _JsonValue& benchmark : benchmarks->items) {
+		const _JsonValue* name = benchmark.find("name");
+		const _JsonValue* values = benchmark.find("samples");
+		const _JsonValue* median = benchmark.find("median");
+		if (!name || name->type != _JsonValue::STRING) {
+			continue;
+		}
+		std::vector< double >& out = samples[name->text];
+		if (values) {
+			for (const _JsonValue& value : values->items) {
+				if (value.type == _JsonValue::NUMBER) {
+					out.push_back(value.number);
+				}
+			}
+		}
+		if (out.empty() && median && median->type == _JsonValue::NUMBER) {
+			out.push_back(median->number); // older reports without samples
+		}
+	}
+	return true;
+}
+
+static double _median(std::vector< double > samples) {
+	std::sort(samples.begin(), samples.end());
+	int n = samples.size();
+	return n == 0 ? 0.0 : (n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]));
+}
+
+/* Uniform index below n from one raw 32-bit draw, by multiply and shift.
+ * std::uniform_int_distribution would do, but its algorithm is left to
+ * the library, so intervals would change between toolchains. The bias
+ * is below n / 2^32. */
+static size_t _pick(std::mt19937& random, size_t n) {
+	return size_t((std::uint64_t(random()) * n) >> 32);
+}
+
+/* Percentile bootstrap interval of median(candidate) / median(baseline). */
+static void _ratioInterval(const std::vector< double >& baseline, const std::vector< double >& candidate,
+                           double confidence, int resamples, std::mt19937& random, double& low, double& high) {
+	std::vector< double > ratios;
+	std::vector< double > a(baseline.size());
+	std::vector< double > b(candidate.size());
+	for (int r = 0; r < resamples; ++r) {
+		for (double& x : a) {
+			x = baseline[_pick(random, baseline.size())];
+		}
+		for (double& x : b) {
+			x = candidate[_pick(random, candidate.size())];
+		}
+		double base = _median(a);
+		if (base > 0.0) {
+			ratios.push_back(_median(b) / base);
+		}
+	}
+	if (ratios.empty()) {
+		low = high = 1.0;
+		return;
+	}
+	std::sort(ratios.begin(), ratios.end());
+	double tail = 0.5 * (1.0 - confidence);
+	int n = ratios.size();
+	low = ratios[std::min(n - 1, int(std::floor(tail * n)))];
+	high = ratios[std::min(n - 1, int(std::ceil((1.0 - tail) * n)) - 1)];
+}
+
+int main(int argc, char** argv) {
+	double threshold = 5.0;
+	double confidence = 0.95;
+	int resamples = 2000;
+	int minSamples = 5;
+	bool requireAll = false;
+	std::string filter;
+	std::vector< const char* > files;
+	for (int i = 1; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--threshold") && hasValue) {
+			threshold = std::atof(argv[++i]);
+		} else if (!std::strcmp(argv[i], "--confidence") && hasValue) {
+			confidence = std::atof(argv[++i]);
+		} else if (!std::strcmp(argv[i], "--resamples") && hasValue) {
+			resamples = std::max(1, std::atoi(argv[++i]));
+		} else if (!std::strcmp(argv[i], "--min-samples") && hasValue) {
+			minSamples = std::max(1, std::atoi(argv[++i]));
+		} else if (!std::strcmp(argv[i], "--filter") && hasValue) {
+			filter = argv[++i];
+		} else if (!std::strcmp(argv[i], "--require-all")) {
+			requireAll = true;
+		} else if (argv[i][0] == '-' && argv[i][1] == '-') {
+			std::fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		} else {
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.size() != 2 || threshold < 0.0 || confidence <= 0.0 || confidence >= 1.0) {
+		std::fprintf(stderr, "usage: bench_compare [--threshold percent] [--confidence level] [--resamples n]\n"
+		                     "                     [--min-samples n] [--filter text] [--require-all]\n"
+		                     "                     baseline.json candidate.json\n");
+		return 2;
+	}
+
+	std::map< std::string, std::vector< double > > baseline;
+	std::map< std::string, std::vector< double > > candidate;
+	if (!_readReport(files[0], baseline) || !_readReport(files[1], candidate)) {
+		return 2;
+	}
+
+	std::mt19937 random(1);
+	int regressions = 0;
+	int improvements = 0;
+	int missing = 0;
+	int undersampled = 0;
+	std::printf("%-44s %12s %12s %9s %19s\n", "benchmark", "baseline s", "candidate s", "change", "interval");
+	for (const std::pair< const std::string, std::vector< double > >& entry : baseline) {
+		const std::string& name = entry.first;
+		if (!filter.empty() && name.find(filter) == std::string::npos) {
+			continue;
+		}
+		std::map< std::string, std::vector< double > >::const_iterator other = candidate.find(name);
+		if (other == candidate.end() || other->second.empty() || entry.second.empty()) {
+			std::printf("%-44s %12s\n", name.c_str(), "missing");
+			++missing;
+			continue;
+		}
+		double base = _median(entry.second);
+		double cand = _median(other->second);
+		double ratio = base > 0.0 ? cand / base : 1.0;
+		double low, high;
+		_ratioInterval(entry.second, other->second, confidence, resamples, random, low, high);
+		const char* verdict = "";
+		if ((int)entry.second.size() < minSamples || (int)other->second.size() < minSamples) {
+			verdict = "  too few samples";
+			++undersampled;
+		} else if (ratio > 1.0 + threshold * 0.01 && low > 1.0) {
+			verdict = "  REGRESSION";
+			++regressions;
+		} else if (ratio < 1.0 - threshold * 0.01 && high < 1.0) {
+			verdict = "  improved";
+			++improvements;
+		}
+		std::printf("%-44s %12.6g %12.6g %+8.1f%% [%+7.1f%%, %+7.1f%%]%s\n", name.c_str(), base, cand,
+		            (ratio - 1.0) * 100.0, (low - 1.0) * 100.0, (high - 1.0) * 100.0, verdict);
+	}
+	for (const std::pair< const std::string, std::vector< double > >& entry : candidate) {
+		if (!baseline.count(entry.first) && (filter.empty() || entry.first.find(filter) != std::string::npos)) {
+			std::printf("%-44s %12s\n", entry.first.c_str(), "new");
+		}
+	}
+
+	std::printf("\n%d regressed, %d improved beyond %g%% at %g confidence", regressions, improvements, threshold,
+	            confidence);
+	if (missing) {
+		std::printf(", %d missing from the candidate", missing);
+	}
+	if (undersampled) {
+		std::printf(", %d not judged with fewer than %d samples", undersampled, minSamples);
+	}
+	std::printf("\n");
+	return regressions || (requireAll && missing) ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/* Microbenchmark of one-ring traversal through half-edge pointers against
+ * the index ranges of circulators.h.
+ *
+ * Usage: circulator_bench [grid resolution] [repetitions]
+ *
+ * The mesh is a slightly noisy grid patch, so almost every vertex has
+ * valence 6. Timed are a one-ring position sum, the cotangent weights of
+ * every vertex, and the LaplacianCache refresh after a move, which runs
+ * on the ranges, next to a full operator assembly. */
+#include "circulators.h"
+#include "laplacian.h"
+#include "mesh.h"
+#include "mesh_generators.h"
+#include "mesh_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+/* Best-of-reps timing in milliseconds. */
+static double _time(int reps, const std::function< void() >& fn) {
+	fn();
+	double best = 1e30;
+	for (int r = 0; r < reps; ++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		fn();
+		auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::milli >(t1 - t0).count());
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	int res = argc > 1 ? std::max(2, atoi(argv[1])) : 300;
+	int reps = argc > 2 ? std::max(1, atoi(argv[2])) : 10;
+
+	GeneratorOptions generator;
+	generator.noise = 0.1f;
+	Mesh mesh;
+	if (!loadMeshArrays(mesh, generateGridPatch(res, 0, generator))) {
+		return 1;
+	}
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int n = vertices.size();
+	HalfEdgeTopology topology;
+	double tTopology = _time(reps, [&]() { topology = halfEdgeTopology(mesh); });
+	printf("vertices %d, faces %d\n", n, (int)mesh.faces().size());
+
+	Eigen::Vector3f sumPointers = Eigen::Vector3f::Zero();
+	double tSumPointers = _time(reps, [&]() {
+		sumPointers.setZero();
+		for (Vertex* vertex : vertices) {
+			HEdge* edge = vertex->halfEdge();
+			HEdge* anedge = edge;
+			do {
+				sumPointers += anedge->end()->position();
+				anedge = anedge->twin()->next();
+			} while (anedge != edge);
+		}
+	});
+	Eigen::Vector3f sumRanges = Eigen::Vector3f::Zero();
+	double tSumRanges = _time(reps, [&]() {
+		sumRanges.setZero();
+		for (int v = 0; v < n; ++v) {
+			for (int u : vertexVertices(topology, v)) {
+				sumRanges += vertices[u]->position();
+			}
+		}
+	});
+	Eigen::Vector3f sumFixed = Eigen::Vector3f::Zero();
+	double tSumFixed = _time(reps, [&]() {
+		sumFixed.setZero();
+		for (int v = 0; v < n; ++v) {
+			forEachRingVertex(topology, v, [&](const auto& ring) {
+				for (int u : ring) {
+					sumFixed += vertices[u]->position();
+				}
+			});
+		}
+	});
+
+	std::vector< Vertex* > neighbors;
+	std::vector< double > weights;
+	double weightSum = 0.0;
+	double tWeightsPointers = _time(reps, [&]() {
+		weightSum = 0.0;
+		for (Vertex* vertex : vertices) {
+			umbrellaWeights(vertex, true, neighbors, weights);
+			weightSum += weights[0];
+		}
+	});
+	double weightSumRanges = 0.0;
+	double tWeightsRanges = _time(reps, [&]() {
+		weightSumRanges = 0.0;
+		for (int v = 0; v < n; ++v) {
+			umbrellaWeights(topology, vertices, v, true, weights);
+			weightSumRanges += weights[0];
+		}
+	});
+
+	LaplacianCache cache;
+	cache.sell(mesh, true);
+	double tRefresh = _time(reps, [&]() {
+		mesh.setVertexPosDirty(true);
+		cache.sell(mesh, true);
+	});
+	Eigen::SparseMatrix< double > L;
+	double tAssembly = _time(reps, [&]() { L = umbrellaOperator(mesh, true); });
+	double err = (L - cache.matrix(mesh, true)).cwiseAbs().sum();
+
+	printf("%-36s %10s\n", "kernel", "ms");
+	printf("%-36s %10.3f\n", "halfEdgeTopology build", tTopology);
+	printf("%-36s %10.3f\n", "one-ring sum, half-edge pointers", tSumPointers);
+	printf("%-36s %10.3f   diff %g\n", "one-ring sum, vertexVertices", tSumRanges, (sumRanges - sumPointers).norm());
+	printf("%-36s %10.3f   diff %g\n", "one-ring sum, forEachRingVertex", tSumFixed, (sumFixed - sumPointers).norm());
+	printf("%-36s %10.3f\n", "cotangent weights, pointers", tWeightsPointers);
+	printf("%-36s %10.3f   diff %g\n", "cotangent weights, topology", tWeightsRanges, weightSumRanges - weightSum);
+	printf("%-36s %10.3f\n", "umbrellaOperator assembly", tAssembly);
+	printf("%-36s %10.3f   diff %g\n", "LaplacianCache cotangent refresh", tRefresh, err);
+	return 0;
+}
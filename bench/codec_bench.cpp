@@ -0,0 +1,61 @@
+/* Throughput benchmark of the mesh codec.
+ *
+ * Usage: codec_bench [icosphere subdivisions] [repetitions]
+ *
+ * Encodes and decodes a noisy icosphere and a grid patch with holes of
+ * about the same size, straight from MeshArrays so no half-edge
+ * structure is involved. Throughput is measured against the raw arrays,
+ * 24 bytes per vertex for position and normal plus 12 bytes per face. */
+#include "mesh_codec.h"
+#include "mesh_generators.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+/* Best-of-reps timing in milliseconds. */
+static double _time(int reps, const std::function< void() >& fn) {
+	fn();
+	double best = 1e30;
+	for (int r = 0; r < reps; ++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		fn();
+		auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::milli >(t1 - t0).count());
+	}
+	return best;
+}
+
+static void _run(const char* name, const MeshArrays& arrays, int reps) {
+	Eigen::Vector3f bboxMin = arrays.positions.colwise().minCoeff().transpose();
+	Eigen::Vector3f bboxMax = arrays.positions.colwise().maxCoeff().transpose();
+	std::vector< std::uint8_t > data;
+	double tEncode = _time(reps, [&]() { data = encodeMesh(arrays, bboxMin, bboxMax); });
+	MeshArrays decoded;
+	bool ok = true;
+	double tDecode = _time(reps, [&]() { ok = decodeMesh(data.data(), data.size(), decoded); });
+
+	double raw = 24.0 * arrays.positions.rows() + 12.0 * arrays.faces.rows();
+	printf("%-10s %9d %9d %8.2f %10.3f %10.1f %10.3f %10.1f %s\n", name, (int)arrays.positions.rows(),
+	       (int)arrays.faces.rows(), raw / data.size(), tEncode, raw * 1e-3 / tEncode, tDecode,
+	       raw * 1e-3 / tDecode, ok && decoded.faces.rows() == arrays.faces.rows() ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	int subdivisions = argc > 1 ? std::max(0, atoi(argv[1])) : 8;
+	int reps = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+
+	GeneratorOptions generator;
+	generator.noise = 0.1f;
+	MeshArrays sphere = generateIcosphere(subdivisions, generator);
+	int res = int(std::sqrt(sphere.positions.rows())) + 1;
+	MeshArrays grid = generateGridPatch(res, 16, generator);
+
+	printf("%-10s %9s %9s %8s %10s %10s %10s %10s\n", "mesh", "vertices", "faces", "ratio", "encode ms",
+	       "MB/s", "decode ms", "MB/s");
+	_run("icosphere", sphere, reps);
+	_run("grid", grid, reps);
+	return 0;
+}
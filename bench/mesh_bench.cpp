@@ -0,0 +1,329 @@
+/* Benchmark suite for the mesh pipeline.
+ *
+ * Usage: mesh_bench [--sizes 1000,10000,...] [--repetitions N]
+ *                   [--filter text] [--workdir dir] [--out file.json]
+ *
+ * For every size a noisy grid patch from generateGridPatch with about
+ * that many faces is written as OBJ and run through loadMeshFile,
+ * half-edge construction, collectMeshStats, computeVertexNormals and both
+ * variants of umbrellaSmooth and implicitUmbrellaSmooth. Half-edge
+ * construction is the part of each loadMeshFile after its OBJ parse, read
+ * from the trace scopes of that same call, so it is only reported in
+ * MESH_TRACE builds. Smoothing runs start from the loaded positions every
+ * repetition.
+ *
+ * The JSON report lists every sample, so two reports can be compared
+ * statistically with bench_compare, together with the median, vertices
+ * per second and the peak resident set size of the process so far. The
+ * default sweep goes from 1k to 10M faces; pass --sizes to stay smaller.
+ *
+ * Built with MESH_PERF, every benchmark also reports hardware counters
+ * summed over its repetitions under "counters": the whole stage under its
+ * own name, plus the instrumented kernels it ran (addFaces,
+ * solveColumns, polynomialSmooth, ...).
+ *
+ * Built with MESH_ALLOC_COUNT, "allocations" is the number of heap
+ * allocations of the last repetition, i.e. after warm-up. The cached
+ * smoothers run with a LaplacianCache and SmoothingWorkspace kept across
+ * repetitions and should report 0, as should computeVertexNormals. This
+ * is also checked for every size, whatever the filter: the three kernels
+ * run twice and any allocation in the second run is reported on stderr
+ * and makes the tool exit with 1, after the report is written.
+ *
+ * No build target exists for this tool, nor for bench_compare, the
+ * tools or the Python library: they all need mesh.h, which declares Mesh
+ * and is not part of this tree, and the demo's CMake project builds only
+ * the viewer. Compile them with the top-level sources against the
+ * project providing mesh.h, Eigen and libigl, and link with -pthread. */
+#include "allocation_counter.h"
+#include "laplacian.h"
+#include "mesh.h"
+#include "mesh_generators.h"
+#include "mesh_io.h"
+#include "perf_counters.h"
+#include "smoothing.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <igl/read_triangle_mesh.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* Peak resident set size of the process in bytes. */
+static std::int64_t _peakRss() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return std::int64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/* Write a res x res grid patch with a little height noise, 2 (res - 1)^2
+ * faces, as OBJ with six significant digits. */
+static bool _writeGrid(const std::string& filename, int res) {
+	GeneratorOptions generator;
+	generator.noise = 0.1f;
+	MeshSaveOptions options;
+	options.format = MESH_FORMAT_OBJ;
+	options.normals = false;
+	options.precision = 6;
+	return saveMesh(generateGridPatch(res, 0, generator), filename, options);
+}
+
+struct BenchResult {
+	std::string name;
+	int faces;
+	int vertices;
+	std::vector< double > samples; // seconds
+	std::int64_t peakRss;
+	std::string counters = "{}"; // perfCountersJson over all repetitions
+	long long allocations = 0;   // during the last repetition
+};
+
+static double _median(std::vector< double > samples) {
+	std::sort(samples.begin(), samples.end());
+	int n = samples.size();
+	return n == 0 ? 0.0 : (n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]));
+}
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Comma-separated positive sizes; false on anything else. */
+static bool _parseSizes(const char* text, std::vector< int >& sizes) {
+	sizes.clear();
+	while (*text) {
+		char* end = nullptr;
+		long size = std::strtol(text, &end, 10);
+		if (end == text || size <= 0 || (*end && *end != ',')) {
+			return false;
+		}
+		sizes.push_back(size);
+		text = *end == ',' ? end + 1 : end;
+	}
+	return !sizes.empty();
+}
+
+static void _writeJson(FILE* out, const std::vector< BenchResult >& results, int repetitions) {
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+	std::fprintf(out, "{\n  \"context\": {\"date\": \"%s\", \"threads\": %d, \"repetitions\": %d, \"perfCounters\": %s,"
+	             " \"allocationCounting\": %s},\n", date, ThreadPool::global().size(), repetitions,
+	             perfCountersAvailable() ? "true" : "false", allocationCountingEnabled() ? "true" : "false");
+	std::fprintf(out, "  \"benchmarks\": [\n");
+	for (int i = 0; i < (int)results.size(); ++i) {
+		const BenchResult& r = results[i];
+		double median = _median(r.samples);
+		std::fprintf(out, "    {\"name\": \"%s/%d\", \"stage\": \"%s\", \"faces\": %d, \"vertices\": %d,",
+		             r.name.c_str(), r.faces, r.name.c_str(), r.faces, r.vertices);
+		std::fprintf(out, " \"median\": %.9g, \"min\": %.9g, \"verticesPerSecond\": %.6g, \"peakRssBytes\": %lld,",
+		             median, *std::min_element(r.samples.begin(), r.samples.end()),
+		             median > 0.0 ? r.vertices / median : 0.0, (long long)r.peakRss);
+		std::fprintf(out, " \"samples\": [");
+		for (int k = 0; k < (int)r.samples.size(); ++k) {
+			std::fprintf(out, "%s%.9g", k ? ", " : "", r.samples[k]);
+		}
+		std::fprintf(out, "], \"allocations\": %lld, \"counters\": %s}%s\n", r.allocations, r.counters.c_str(),
+		             i + 1 < (int)results.size() ? "," : "");
+	}
+	std::fprintf(out, "  ]\n}\n");
+}
+
+#ifdef MESH_ALLOC_COUNT
+/* Allocations of the second of two runs of the kernels that should not
+ * allocate once warm. */
+static long long _steadyStateAllocations(Mesh& mesh, const std::function< void() >& restore) {
+	LaplacianCache cache;
+	SmoothingWorkspace workspace;
+	PolynomialSmoothOptions chebyshev;
+	GaussSeidelSmoothOptions gaussSeidel;
+	long long allocations = 0;
+	for (int pass = 0; pass < 2; ++pass) {
+		restore();
+		AllocationScope scope;
+		mesh.computeVertexNormals();
+		polynomialSmooth(mesh, cache, chebyshev, workspace);
+		gaussSeidelSmooth(mesh, cache, gaussSeidel, workspace);
+		allocations = scope.count().allocations;
+	}
+	return allocations;
+}
+#endif
+
+int main(int argc, char** argv) {
+	std::vector< int > sizes = {1000, 10000, 100000, 1000000, 10000000};
+	int repetitions = 5;
+	std::string filter;
+	std::string workdir = ".";
+	std::string outFile;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!std::strcmp(argv[i], "--sizes")) {
+			if (!_parseSizes(argv[i + 1], sizes)) {
+				std::fprintf(stderr, "invalid sizes %s\n", argv[i + 1]);
+				return 1;
+			}
+		} else if (!std::strcmp(argv[i], "--repetitions")) {
+			repetitions = std::max(1, std::atoi(argv[i + 1]));
+		} else if (!std::strcmp(argv[i], "--filter")) {
+			filter = argv[i + 1];
+		} else if (!std::strcmp(argv[i], "--workdir")) {
+			workdir = argv[i + 1];
+		} else if (!std::strcmp(argv[i], "--out")) {
+			outFile = argv[i + 1];
+		} else {
+			std::fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	std::vector< BenchResult > results;
+	bool allocationFailure = false;
+	for (int faces : sizes) {
+		int res = std::max(2, int(std::sqrt(faces / 2.0)) + 1);
+		std::string filename = workdir + "/mesh_bench_" + std::to_string(faces) + ".obj";
+		if (!_writeGrid(filename, res)) {
+			std::fprintf(stderr, "cannot write %s\n", filename.c_str());
+			return 1;
+		}
+
+		Mesh mesh;
+		mesh.loadMeshFile(filename);
+		int numVertices = mesh.vertices().size();
+		int numFaces = mesh.faces().size();
+		std::vector< Eigen::Vector3f > initial;
+		for (Vertex* v : mesh.vertices()) {
+			initial.push_back(v->position());
+		}
+		auto restore = [&]() {
+			for (int i = 0; i < numVertices; ++i) {
+				mesh.vertices()[i]->setPosition(initial[i]);
+			}
+			// Cached cotangent weights must follow the restored shape
+			mesh.setVertexPosDirty(true);
+		};
+
+		// Each stage: optional untimed setup, then the timed body
+		auto run = [&](const std::string& name, const std::function< void() >& setup,
+		               const std::function< void() >& body) {
+			if (!filter.empty() && name.find(filter) == std::string::npos) {
+				return;
+			}
+			BenchResult result;
+			result.name = name;
+			result.faces = numFaces;
+			result.vertices = numVertices;
+			resetPerfCounters();
+			for (int r = 0; r < repetitions; ++r) {
+				if (setup) {
+					setup();
+				}
+				AllocationScope allocations;
+				double seconds;
+				{
+#ifdef MESH_PERF
+					PerfScope counters(name.c_str());
+#endif
+					auto start = std::chrono::steady_clock::now();
+					body();
+					seconds = _seconds(start);
+				}
+				result.allocations = allocations.count().allocations;
+				result.samples.push_back(seconds);
+			}
+			result.peakRss = _peakRss();
+			result.counters = perfCountersJson();
+			std::fprintf(stderr, "%-28s %9d faces  median %10.6f s  %lld allocations\n", name.c_str(), numFaces,
+			             _median(result.samples), result.allocations);
+			results.push_back(result);
+		};
+
+		Eigen::MatrixXf V;
+		Eigen::MatrixXi F;
+		run("parseObj", nullptr, [&]() { igl::read_triangle_mesh(filename, V, F); });
+		run("loadMeshFile", nullptr, [&]() { mesh.loadMeshFile(filename); });
+
+#ifdef MESH_TRACE
+		// Construction is the load after its parse, both from the trace
+		// scopes of the same loadMeshFile call; counters cover addFaces
+		if (filter.empty() || std::string("halfEdgeConstruction").find(filter) != std::string::npos) {
+			BenchResult construction;
+			construction.name = "halfEdgeConstruction";
+			construction.faces = numFaces;
+			construction.vertices = numVertices;
+			resetPerfCounters();
+			for (int r = 0; r < repetitions; ++r) {
+				clearTrace();
+				mesh.loadMeshFile(filename);
+				construction.samples.push_back(traceSeconds("loadMeshFile") - traceSeconds("parse"));
+			}
+			construction.peakRss = _peakRss();
+			construction.counters = perfCountersJson();
+			std::fprintf(stderr, "%-28s %9d faces  median %10.6f s\n", construction.name.c_str(), numFaces,
+			             _median(construction.samples));
+			results.push_back(construction);
+		}
+#endif
+
+		run("collectMeshStats", nullptr, [&]() { mesh.collectMeshStats(); });
+		run("computeVertexNormals", nullptr, [&]() { mesh.computeVertexNormals(); });
+		run("umbrellaSmooth/uniform", restore, [&]() { mesh.umbrellaSmooth(false); });
+		run("umbrellaSmooth/cotangent", restore, [&]() { mesh.umbrellaSmooth(true); });
+		run("implicitUmbrellaSmooth/uniform", restore, [&]() { mesh.implicitUmbrellaSmooth(false); });
+		run("implicitUmbrellaSmooth/cotangent", restore, [&]() { mesh.implicitUmbrellaSmooth(true); });
+
+		LaplacianCache cache;
+		SmoothingWorkspace workspace;
+		PolynomialSmoothOptions chebyshev;
+		GaussSeidelSmoothOptions gaussSeidel;
+		run("polynomialSmooth/chebyshev", restore, [&]() { polynomialSmooth(mesh, cache, chebyshev, workspace); });
+		run("gaussSeidelSmooth/cotangent", restore, [&]() { gaussSeidelSmooth(mesh, cache, gaussSeidel, workspace); });
+
+#ifdef MESH_ALLOC_COUNT
+		long long steady = _steadyStateAllocations(mesh, restore);
+		if (steady != 0) {
+			std::fprintf(stderr, "%d faces: %lld allocations in warm computeVertexNormals, polynomialSmooth and "
+			             "gaussSeidelSmooth\n", numFaces, steady);
+			allocationFailure = true;
+		}
+#endif
+
+		std::remove(filename.c_str());
+	}
+
+	FILE* out = outFile.empty() ? stdout : std::fopen(outFile.c_str(), "w");
+	if (!out) {
+		std::fprintf(stderr, "cannot write %s\n", outFile.c_str());
+		return 1;
+	}
+	_writeJson(out, results, repetitions);
+	if (out != stdout) {
+		std::fclose(out);
+	}
+	return allocationFailure ? 1 : 0;
+}
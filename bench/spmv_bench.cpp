@@ -0,0 +1,88 @@
+/* Microbenchmark comparing the SELL-C SpMV kernel against Eigen.
+ *
+ * Usage: spmv_bench [grid resolution] [repetitions]
+ *
+ * The operator is the uniform umbrella matrix I - L of a triangulated
+ * regular grid, which has the valence-6 structure of typical meshes. */
+#include "spmv.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+static Eigen::SparseMatrix< float > _gridUmbrella(int res) {
+	int n = res * res;
+	std::vector< Eigen::Triplet< float > > triplets;
+	triplets.reserve(n * 7);
+	for (int y = 0; y < res; ++y) {
+		for (int x = 0; x < res; ++x) {
+			int i = y * res + x;
+			std::vector< int > neighbors;
+			if (x > 0) neighbors.push_back(i - 1);
+			if (x < res - 1) neighbors.push_back(i + 1);
+			if (y > 0) neighbors.push_back(i - res);
+			if (y < res - 1) neighbors.push_back(i + res);
+			if (x > 0 && y > 0) neighbors.push_back(i - res - 1);
+			if (x < res - 1 && y < res - 1) neighbors.push_back(i + res + 1);
+			triplets.push_back(Eigen::Triplet< float >(i, i, 2.0f));
+			for (int j : neighbors) {
+				triplets.push_back(Eigen::Triplet< float >(i, j, -1.0f / neighbors.size()));
+			}
+		}
+	}
+	Eigen::SparseMatrix< float > A(n, n);
+	A.setFromTriplets(triplets.begin(), triplets.end());
+	return A;
+}
+
+/* Best-of-reps timing in milliseconds. */
+static double _time(int reps, const std::function< void() >& fn) {
+	fn();
+	double best = 1e30;
+	for (int r = 0; r < reps; ++r) {
+		auto t0 = std::chrono::steady_clock::now();
+		fn();
+		auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration< double, std::milli >(t1 - t0).count());
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	int res = argc > 1 ? atoi(argv[1]) : 1000;
+	int reps = argc > 2 ? atoi(argv[2]) : 20;
+
+	Eigen::SparseMatrix< float > A = _gridUmbrella(res);
+	Eigen::SparseMatrix< float, Eigen::RowMajor > Arow = A;
+	SellMatrix sell(A);
+	int n = A.rows();
+
+	printf("rows %d, nnz %d, padded nnz %d, threads %d\n",
+	       n, sell.nonZeros(), sell.paddedNonZeros(), ThreadPool::global().size());
+
+	Eigen::VectorXf x = Eigen::VectorXf::Random(n);
+	Eigen::VectorXf y(n);
+	double tEigen = _time(reps, [&]() { y.noalias() = A * x; });
+	Eigen::VectorXf yRef = y;
+	double tEigenRow = _time(reps, [&]() { y.noalias() = Arow * x; });
+	double tSell = _time(reps, [&]() { sell.multiply(x, y); });
+	float err = (y - yRef).cwiseAbs().maxCoeff();
+
+	VertexMatrix X = VertexMatrix::Random(n, 3);
+	VertexMatrix Y(n, 3);
+	Eigen::MatrixXf Xcol = X;
+	Eigen::MatrixXf Ycol(n, 3);
+	double tEigen3 = _time(reps, [&]() { Ycol.noalias() = A * Xcol; });
+	double tSell3 = _time(reps, [&]() { sell.multiply(X, Y); });
+	float err3 = (Eigen::MatrixXf(Y) - Ycol).cwiseAbs().maxCoeff();
+
+	double gb = (sell.nonZeros() * 8.0 + n * 8.0) * 1e-6;
+	printf("%-28s %10s %10s\n", "kernel", "ms", "GB/s");
+	printf("%-28s %10.3f %10.2f\n", "eigen col-major  A*x", tEigen, gb / tEigen);
+	printf("%-28s %10.3f %10.2f\n", "eigen row-major  A*x", tEigenRow, gb / tEigenRow);
+	printf("%-28s %10.3f %10.2f   max err %g\n", "sell-c           A*x", tSell, gb / tSell, err);
+	printf("%-28s %10.3f\n", "eigen col-major  A*X (Nx3)", tEigen3);
+	printf("%-28s %10.3f              max err %g\n", "sell-c           A*X (Nx3)", tSell3, err3);
+	return 0;
+}
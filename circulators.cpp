@@ -0,0 +1,62 @@
+#include "circulators.h"
+#include "mesh.h"
+#include <unordered_map>
+
+HalfEdgeTopology halfEdgeTopology(const Mesh& mesh) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	const std::vector< Face* >& faces = mesh.faces();
+	const std::vector< HEdge* >& boundary = mesh.boundaryEdges();
+
+	HalfEdgeTopology topology;
+	topology.numVertices = vertices.size();
+	topology.numFaces = faces.size();
+	topology.revision = topologyRevision(mesh);
+	int numInterior = 3 * topology.numFaces;
+	int numHEdges = numInterior + boundary.size();
+
+	// Number the half-edges face by face, then the boundary ones
+	std::unordered_map< const HEdge*, int > ids;
+	ids.reserve(numHEdges);
+	std::vector< const HEdge* > hedges(numHEdges);
+	for (int f = 0; f < topology.numFaces; ++f) {
+		const HEdge* h = faces[f]->halfEdge();
+		for (int k = 0; k < 3; ++k) {
+			ids[h] = 3 * f + k;
+			hedges[3 * f + k] = h;
+			h = h->next();
+		}
+	}
+	for (int b = 0; b < (int)boundary.size(); ++b) {
+		ids[boundary[b]] = numInterior + b;
+		hedges[numInterior + b] = boundary[b];
+	}
+
+	topology.hedgeStart.resize(numHEdges);
+	topology.hedgeTwin.resize(numHEdges);
+	topology.boundaryNext.resize(boundary.size());
+	for (int h = 0; h < numHEdges; ++h) {
+		topology.hedgeStart[h] = hedges[h]->start()->index();
+		topology.hedgeTwin[h] = ids[hedges[h]->twin()];
+	}
+	for (int b = 0; b < (int)boundary.size(); ++b) {
+		topology.boundaryNext[b] = ids[boundary[b]->next()];
+	}
+
+	topology.ringOffsets.assign(topology.numVertices + 1, 0);
+	topology.ringHEdges.reserve(numHEdges);
+	topology.ringVertices.reserve(numHEdges);
+	for (int v = 0; v < topology.numVertices; ++v) {
+		const HEdge* edge = vertices[v]->halfEdge();
+		if (edge) {
+			int first = ids[edge];
+			int h = first;
+			do {
+				topology.ringHEdges.push_back(h);
+				topology.ringVertices.push_back(topology.end(h));
+				h = topology.next(topology.twin(h));
+			} while (h != first);
+		}
+		topology.ringOffsets[v + 1] = topology.ringHEdges.size();
+	}
+	return topology;
+}
@@ -0,0 +1,237 @@
+#ifndef CIRCULATORS_H
+#define CIRCULATORS_H
+
+#include "revision.h"
+#include <cstddef>
+#include <vector>
+
+class Mesh;
+
+/* Index-based copy of the half-edge connectivity for traversal-heavy
+ * kernels.
+ *
+ * Half-edge h < 3 * numFaces is corner h % 3 of face h / 3, so next and
+ * face are arithmetic; boundary half-edges are numbered after them. The
+ * one-ring of every vertex is stored contiguously, in the order the
+ * twin()->next() traversal visits it, both as outgoing half-edges and as
+ * neighbor vertices. Circulating a vertex is then a linear scan instead
+ * of a pointer chase. */
+struct HalfEdgeTopology {
+	int numVertices = 0;
+	int numFaces = 0;
+	// Topology revision of the mesh this was built from
+	Revision revision = 0;
+
+	std::vector< int > hedgeStart;   // start vertex of every half-edge
+	std::vector< int > hedgeTwin;
+	std::vector< int > boundaryNext; // next of boundary half-edge 3 * numFaces + b
+
+	std::vector< int > ringOffsets;  // numVertices + 1 entries
+	std::vector< int > ringHEdges;   // outgoing half-edges
+	std::vector< int > ringVertices; // their end vertices
+
+	int numHEdges() const {
+		return hedgeStart.size();
+	}
+	bool isBoundary(int h) const {
+		return h >= 3 * numFaces;
+	}
+	int next(int h) const {
+		if (isBoundary(h)) {
+			return boundaryNext[h - 3 * numFaces];
+		}
+		return h % 3 == 2 ? h - 2 : h + 1;
+	}
+	int twin(int h) const {
+		return hedgeTwin[h];
+	}
+	int start(int h) const {
+		return hedgeStart[h];
+	}
+	int end(int h) const {
+		return hedgeStart[hedgeTwin[h]];
+	}
+	/* Face to the left of h, or -1 for boundary half-edges. */
+	int face(int h) const {
+		return isBoundary(h) ? -1 : h / 3;
+	}
+	int valence(int v) const {
+		return ringOffsets[v + 1] - ringOffsets[v];
+	}
+	size_t memoryBytes() const {
+		return sizeof(int) * (hedgeStart.capacity() + hedgeTwin.capacity() + boundaryNext.capacity()
+		                      + ringOffsets.capacity() + ringHEdges.capacity() + ringVertices.capacity());
+	}
+};
+
+/* Build the index connectivity. Vertices keep their Vertex::index. */
+HalfEdgeTopology halfEdgeTopology(const Mesh& mesh);
+
+/* Number of elements of a range known at compile time, or DYNAMIC_SIZE. */
+static const int DYNAMIC_SIZE = -1;
+
+/* Contiguous range of indices. With a fixed Size the trip count of a
+ * range-for is a compile-time constant, so one-ring loops over regular
+ * vertices can be unrolled and vectorized. */
+template < int Size = DYNAMIC_SIZE >
+class IndexRange {
+public:
+	IndexRange(const int* begin, int size) : mBegin(begin), mSize(size) {
+	}
+
+	const int* begin() const {
+		return mBegin;
+	}
+	const int* end() const {
+		return mBegin + size();
+	}
+	int size() const {
+		return Size == DYNAMIC_SIZE ? mSize : Size;
+	}
+	int operator[](int k) const {
+		return mBegin[k];
+	}
+
+private:
+	const int* mBegin;
+	int mSize;
+};
+
+/* Consecutive integers, used for the three corners of a face. */
+template < int Size = DYNAMIC_SIZE >
+class CountingRange {
+public:
+	class iterator {
+	public:
+		explicit iterator(int i) : mI(i) {
+		}
+		int operator*() const {
+			return mI;
+		}
+		iterator& operator++() {
+			++mI;
+			return *this;
+		}
+		bool operator!=(const iterator& other) const {
+			return mI != other.mI;
+		}
+
+	private:
+		int mI;
+	};
+
+	CountingRange(int first, int size) : mFirst(first), mSize(size) {
+	}
+
+	iterator begin() const {
+		return iterator(mFirst);
+	}
+	iterator end() const {
+		return iterator(mFirst + size());
+	}
+	int size() const {
+		return Size == DYNAMIC_SIZE ? mSize : Size;
+	}
+
+private:
+	int mFirst;
+	int mSize;
+};
+
+/* Faces around a vertex: the left faces of its outgoing half-edges,
+ * skipping the hole at a boundary. */
+class VertexFaceRange {
+public:
+	class iterator {
+	public:
+		iterator(const HalfEdgeTopology* topology, const int* h, const int* end)
+		    : mTopology(topology), mH(h), mEnd(end) {
+			skip();
+		}
+		int operator*() const {
+			return mTopology->face(*mH);
+		}
+		iterator& operator++() {
+			++mH;
+			skip();
+			return *this;
+		}
+		bool operator!=(const iterator& other) const {
+			return mH != other.mH;
+		}
+
+	private:
+		void skip() {
+			while (mH != mEnd && mTopology->isBoundary(*mH)) {
+				++mH;
+			}
+		}
+
+		const HalfEdgeTopology* mTopology;
+		const int* mH;
+		const int* mEnd;
+	};
+
+	VertexFaceRange(const HalfEdgeTopology& topology, int v)
+	    : mTopology(&topology),
+	      mBegin(topology.ringHEdges.data() + topology.ringOffsets[v]),
+	      mEnd(topology.ringHEdges.data() + topology.ringOffsets[v + 1]) {
+	}
+
+	iterator begin() const {
+		return iterator(mTopology, mBegin, mEnd);
+	}
+	iterator end() const {
+		return iterator(mTopology, mEnd, mEnd);
+	}
+
+private:
+	const HalfEdgeTopology* mTopology;
+	const int* mBegin;
+	const int* mEnd;
+};
+
+/* Outgoing half-edges of vertex v. Pass Valence when it is known, e.g.
+ * from the dispatch in forEachRingVertex. */
+template < int Valence = DYNAMIC_SIZE >
+IndexRange< Valence > vertexHEdges(const HalfEdgeTopology& topology, int v) {
+	return IndexRange< Valence >(topology.ringHEdges.data() + topology.ringOffsets[v], topology.valence(v));
+}
+
+/* Neighbors of vertex v, in the same order as vertexHEdges. */
+template < int Valence = DYNAMIC_SIZE >
+IndexRange< Valence > vertexVertices(const HalfEdgeTopology& topology, int v) {
+	return IndexRange< Valence >(topology.ringVertices.data() + topology.ringOffsets[v], topology.valence(v));
+}
+
+inline VertexFaceRange vertexFaces(const HalfEdgeTopology& topology, int v) {
+	return VertexFaceRange(topology, v);
+}
+
+/* The three half-edges of face f, in next() order. */
+inline CountingRange< 3 > faceHEdges(const HalfEdgeTopology&, int f) {
+	return CountingRange< 3 >(3 * f, 3);
+}
+
+/* Call fn(range) with the neighbors of v. Vertices of valence 6 or 4 get
+ * a range of fixed size, so a generic lambda sees the trip count at
+ * compile time. The test is on the valence alone: 6 is the regular
+ * interior case and 4 the regular boundary one, but an interior vertex
+ * of valence 4 takes the fixed-size path as well, which is just as
+ * correct. */
+template < class Fn >
+void forEachRingVertex(const HalfEdgeTopology& topology, int v, Fn&& fn) {
+	switch (topology.valence(v)) {
+	case 6:
+		fn(vertexVertices< 6 >(topology, v));
+		break;
+	case 4:
+		fn(vertexVertices< 4 >(topology, v));
+		break;
+	default:
+		fn(vertexVertices(topology, v));
+		break;
+	}
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "constrained_smoothing.h"
+#include "laplacian.h"
+#include "memory_report.h"
+#include "mesh.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+ConstrainedSmoother::ConstrainedSmoother() {
+	mFactored = false;
+	mSymmetric = false;
+	mFactorCount = 0;
+	mMesh = nullptr;
+	mTopology = 0;
+	mCotangentWeights = false;
+	mLambda = 0.0;
+	mAssemblySeconds = 0.0;
+	mSetupSeconds = 0.0;
+}
+
+bool ConstrainedSmoother::setup(const Mesh& mesh,
+                                const std::vector< int >& pinned,
+                                bool cotangentWeights,
+                                double lambda) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int n = vertices.size();
+
+	// Pins must be distinct vertex indices
+	std::vector< char > seen(n, 0);
+	for (int i : pinned) {
+		if (i < 0 || i >= n || seen[i]) {
+			std::cout << __FUNCTION__ << ": invalid or repeated pinned vertex " << i << "\n";
+			mFactored = false;
+			return false;
+		}
+		seen[i] = 1;
+	}
+
+	Revision topology = topologyRevision(mesh);
+	if (mFactored && mMesh == &mesh && mTopology == topology && mPinned == pinned && mCotangentWeights == cotangentWeights && mLambda == lambda) {
+		return true;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	mFactored = false;
+	mMesh = &mesh;
+	mTopology = topology;
+	mPinned = pinned;
+	mCotangentWeights = cotangentWeights;
+	mLambda = lambda;
+
+	// Local numbering: free vertices >= 0, pinned ones -1 - k
+	std::vector< int > local(n, 0);
+	for (int k = 0; k < (int)pinned.size(); ++k) {
+		local[pinned[k]] = -1 - k;
+	}
+	mFree.clear();
+	for (int i = 0; i < n; ++i) {
+		if (local[i] >= 0) {
+			local[i] = mFree.size();
+			mFree.push_back(i);
+		}
+	}
+	int numFree = mFree.size();
+
+	// Row i scaled by D_i: D_i (1 + lambda) on the diagonal and
+	// -lambda * W_ij off it, with W_ij = D_i * w_ij
+	std::vector< Eigen::Triplet< double > > system;
+	std::vector< Eigen::Triplet< double > > coupling;
+	system.reserve(numFree * 7);
+	mRestRhs.resize(numFree, 3);
+	std::vector< Vertex* > neighbors;
+	std::vector< double > weights;
+	for (int k = 0; k < numFree; ++k) {
+		Vertex* vertex = vertices[mFree[k]];
+		double total = 0.0;
+		umbrellaWeights(vertex, cotangentWeights, neighbors, weights, &total);
+		system.push_back(Eigen::Triplet< double >(k, k, total * (1.0 + lambda)));
+		for (int j = 0; j < (int)neighbors.size(); ++j) {
+			int other = local[neighbors[j]->index()];
+			double w = lambda * total * weights[j];
+			if (other >= 0) {
+				system.push_back(Eigen::Triplet< double >(k, other, -w));
+			} else {
+				coupling.push_back(Eigen::Triplet< double >(k, -1 - other, w));
+			}
+		}
+		mRestRhs.row(k) = total * vertex->position().cast< double >().transpose();
+	}
+
+	Eigen::SparseMatrix< double >& S = mSystem;
+	S.resize(numFree, numFree);
+	S.setFromTriplets(system.begin(), system.end());
+	mCoupling.resize(numFree, pinned.size());
+	mCoupling.setFromTriplets(coupling.begin(), coupling.end());
+	mAssemblySeconds = _seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	Eigen::SparseMatrix< double > transposed = S.transpose();
+	double asymmetry = (S - transposed).norm();
+	mSymmetric = asymmetry <= 1e-9 * S.norm();
+	if (mSymmetric) {
+		mLDLT.compute(S);
+		mFactored = mLDLT.info() == Eigen::Success;
+	} else {
+		mLU.compute(S);
+		mFactored = mLU.info() == Eigen::Success;
+	}
+	mSetupSeconds = _seconds(start);
+	++mFactorCount;
+	return mFactored;
+}
+
+bool ConstrainedSmoother::solve(Mesh& mesh) {
+	if (!mFactored) {
+		return false;
+	}
+	// The pinned and free indices belong to the mesh that was set up
+	if (mMesh != &mesh || mTopology != topologyRevision(mesh)) {
+		std::cout << __FUNCTION__ << ": mesh or topology changed since setup\n";
+		return false;
+	}
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	Eigen::MatrixXd pinned(mPinned.size(), 3);
+	for (int k = 0; k < (int)mPinned.size(); ++k) {
+		pinned.row(k) = vertices[mPinned[k]]->position().cast< double >().transpose();
+	}
+	auto start = std::chrono::steady_clock::now();
+	Eigen::MatrixXd rhs = mRestRhs + mCoupling * pinned;
+	Eigen::MatrixXd X = mSymmetric ? Eigen::MatrixXd(mLDLT.solve(rhs)) : Eigen::MatrixXd(mLU.solve(rhs));
+	double seconds = _seconds(start);
+
+	SolveTrace trace;
+	trace.source = "ConstrainedSmoother";
+	trace.rows = mSystem.rows();
+	trace.nonZeros = mSystem.nonZeros();
+	trace.precision = SOLVER_DOUBLE;
+	trace.direct = true;
+	trace.assemblySeconds = mAssemblySeconds;
+	trace.setupSeconds = mSetupSeconds;
+	trace.solveSeconds = seconds;
+	trace.columns.assign(X.cols(), KrylovTrace());
+	Eigen::MatrixXd residual = rhs - mSystem * X;
+	for (int j = 0; j < (int)X.cols(); ++j) {
+		KrylovTrace& column = trace.columns[j];
+		double error = residual.col(j).squaredNorm();
+		column.seconds = seconds / X.cols();
+		// A sound factorization leaves a residual near double round-off
+		column.converged = std::isfinite(error) && error <= 1e-16 * rhs.col(j).squaredNorm();
+		column.residuals.push_back(error);
+	}
+	// Later solves reuse the factorization
+	mAssemblySeconds = 0.0;
+	mSetupSeconds = 0.0;
+	reportSolveTrace(trace, mTraceOptions);
+
+	for (int k = 0; k < (int)mFree.size(); ++k) {
+		vertices[mFree[k]]->setPosition(X.row(k).transpose().cast< float >());
+	}
+	mesh.computeVertexNormals();
+	mesh.setVertexPosDirty(true);
+	return true;
+}
+
+void ConstrainedSmoother::setTraceCallback(const SolveTraceCallback& callback) {
+	mTraceOptions.traceCallback = callback;
+}
+
+bool ConstrainedSmoother::isFactored() const {
+	return mFactored;
+}
+
+int ConstrainedSmoother::factorCount() const {
+	return mFactorCount;
+}
+
+int ConstrainedSmoother::numFree() const {
+	return mFree.size();
+}
+
+int ConstrainedSmoother::numPinned() const {
+	return mPinned.size();
+}
+
+size_t ConstrainedSmoother::memoryBytes() const {
+	size_t bytes = vectorBytes(mPinned) + vectorBytes(mFree) + sparseBytes(mSystem) + sparseBytes(mCoupling)
+	               + mRestRhs.size() * sizeof(double);
+	if (!mFactored) {
+		return bytes;
+	}
+	size_t n = mFree.size();
+	if (mSymmetric) {
+		// L, D and the fill-reducing permutation and its inverse
+		bytes += sparseBytes(mLDLT.matrixL().nestedExpression()) + n * sizeof(double) + 2 * n * sizeof(int);
+	} else {
+		// Supernodal storage, approximated by the factor entries
+		bytes += (mLU.nnzL() + mLU.nnzU()) * (sizeof(double) + sizeof(int)) + 2 * n * sizeof(int);
+	}
+	return bytes;
+}
@@ -0,0 +1,84 @@
+#ifndef CONSTRAINED_SMOOTHING_H
+#define CONSTRAINED_SMOOTHING_H
+
+#include "revision.h"
+#include "solver.h"
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseLU>
+#include <vector>
+
+class Mesh;
+
+/* Implicit umbrella smoothing with pinned handle vertices.
+ *
+ * Pinned positions are eliminated from (I - lambda * L) x' = x: the
+ * system is reduced to the free vertices and the pinned values move to
+ * the right-hand side. Scaling every row by its total umbrella weight D
+ * turns the reduced matrix into the symmetric D_FF (1 + lambda) - lambda
+ * W_FF, which is factorized once with sparse LDLT (or LU when boundary
+ * cotangents break the symmetry). The free rest positions are captured
+ * at setup, so moving the handles afterwards only changes the
+ * right-hand side and every solve() is a pair of triangular solves.
+ *
+ * Typical editing loop:
+ *   smoother.setup(mesh, flaggedRegion(mesh).interior, true, 1.0);
+ *   // move handle vertices with Vertex::setPosition, then
+ *   smoother.solve(mesh); */
+class ConstrainedSmoother {
+public:
+	ConstrainedSmoother();
+
+	/* Factorize the reduced system for the given pinned vertex indices.
+	 * Does nothing when the mesh topology, pins, weights and lambda are
+	 * unchanged since the last call; moving vertices does not refactor.
+	 * Returns false, leaving the smoother unfactored, if a pin is out of
+	 * range or repeated, or if the factorization failed. */
+	bool setup(const Mesh& mesh, const std::vector< int >& pinned, bool cotangentWeights, double lambda);
+
+	/* Solve for the free vertices against the current pinned positions
+	 * and write them back. Normals are recomputed afterwards. Every solve
+	 * is reported as a direct SolveTrace, the first after a factorization
+	 * with its assembly and setup time. Returns false without touching
+	 * the mesh if it is unfactored, or if mesh is not the one set up or
+	 * its topology changed since; setup again in that case. */
+	bool solve(Mesh& mesh);
+	/* Receives the solve traces; when empty the process-wide callback of
+	 * setSolveTraceCallback is used. */
+	void setTraceCallback(const SolveTraceCallback& callback);
+
+	bool isFactored() const;
+	/* Number of factorizations so far, for checking reuse. */
+	int factorCount() const;
+	int numFree() const;
+	int numPinned() const;
+	/* Bytes of the reduced system and its factorization. */
+	size_t memoryBytes() const;
+
+private:
+	bool mFactored;
+	bool mSymmetric;
+	int mFactorCount;
+
+	// Parameters of the current factorization
+	const Mesh* mMesh;
+	Revision mTopology;
+	std::vector< int > mPinned;
+	bool mCotangentWeights;
+	double mLambda;
+
+	std::vector< int > mFree;                  // free vertex indices
+	Eigen::SparseMatrix< double > mSystem;     // the scaled reduced matrix, for residuals
+	Eigen::SparseMatrix< double > mCoupling;   // lambda * W_FP
+	Eigen::MatrixXd mRestRhs;                  // D_F x_F at setup
+
+	Eigen::SimplicialLDLT< Eigen::SparseMatrix< double > > mLDLT;
+	Eigen::SparseLU< Eigen::SparseMatrix< double > > mLU;
+
+	SolveOptions mTraceOptions;
+	// Times of the last factorization, reported by the next solve
+	double mAssemblySeconds;
+	double mSetupSeconds;
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "laplacian.h"
+#include "memory_report.h"
+#include "mesh.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+void umbrellaWeights(const Vertex* vertex,
+                     bool cotangentWeights,
+                     std::vector< Vertex* >& neighbors,
+                     std::vector< double >& weights,
+                     double* totalWeight) {
+	// collect neighbors
+	neighbors.clear();
+	HEdge* edge = vertex->halfEdge();
+	neighbors.push_back(edge->end());
+	HEdge* anedge = edge->twin()->next();
+	while (edge != anedge) {
+		neighbors.push_back(anedge->end());
+		anedge = anedge->twin()->next();
+	}
+
+	int length = neighbors.size();
+	weights.assign(length, 1.0);
+	if (cotangentWeights) {
+		const Eigen::Vector3f& center = vertex->position();
+		for (int j = 0; j < length; ++j) {
+			int j_m1 = j - 1 < 0 ? j - 1 + length : j - 1;
+			int j_p1 = j + 1 >= length ? j + 1 - length : j + 1;
+			weights[j] = triangleCot(center, neighbors[j_m1]->position(), neighbors[j]->position())
+			           + triangleCot(center, neighbors[j_p1]->position(), neighbors[j]->position());
+		}
+	}
+
+	double totalWeights = 0.0;
+	for (int j = 0; j < length; ++j) {
+		totalWeights += weights[j];
+	}
+	for (int j = 0; j < length; ++j) {
+		weights[j] /= totalWeights;
+	}
+	if (totalWeight) {
+		*totalWeight = totalWeights;
+	}
+}
+
+void umbrellaWeights(const HalfEdgeTopology& topology,
+                     const std::vector< Vertex* >& vertices,
+                     int v,
+                     bool cotangentWeights,
+                     std::vector< double >& weights,
+                     double* totalWeight) {
+	forEachRingVertex(topology, v, [&](const auto& ring) {
+		int length = ring.size();
+		weights.assign(length, 1.0);
+		if (cotangentWeights) {
+			const Eigen::Vector3f& center = vertices[v]->position();
+			for (int j = 0; j < length; ++j) {
+				int j_m1 = j - 1 < 0 ? j - 1 + length : j - 1;
+				int j_p1 = j + 1 >= length ? j + 1 - length : j + 1;
+				const Eigen::Vector3f& neighbor = vertices[ring[j]]->position();
+				weights[j] = triangleCot(center, vertices[ring[j_m1]]->position(), neighbor)
+				           + triangleCot(center, vertices[ring[j_p1]]->position(), neighbor);
+			}
+		}
+	});
+
+	double totalWeights = 0.0;
+	for (double weight : weights) {
+		totalWeights += weight;
+	}
+	for (double& weight : weights) {
+		weight /= totalWeights;
+	}
+	if (totalWeight) {
+		*totalWeight = totalWeights;
+	}
+}
+
+Eigen::SparseMatrix< double > umbrellaOperator(const Mesh& mesh, bool cotangentWeights) {
+	TRACE_SCOPE("umbrellaOperator");
+	PERF_SCOPE("umbrellaOperator");
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int n = vertices.size();
+
+	std::vector< Eigen::Triplet< double > > triplets;
+	triplets.reserve(n * 7);
+	std::vector< Vertex* > neighbors;
+	std::vector< double > weights;
+	for (int i = 0; i < n; ++i) {
+		triplets.push_back(Eigen::Triplet< double >(i, i, -1.0));
+		umbrellaWeights(vertices[i], cotangentWeights, neighbors, weights);
+		for (int j = 0; j < (int)neighbors.size(); ++j) {
+			triplets.push_back(Eigen::Triplet< double >(i, neighbors[j]->index(), weights[j]));
+		}
+	}
+
+	Eigen::SparseMatrix< double > L(n, n);
+	L.setFromTriplets(triplets.begin(), triplets.end());
+	return L;
+}
+
+int VertexColoring::numColors() const {
+	return classOffsets.size() - 1;
+}
+
+VertexColoring greedyColoring(const Eigen::SparseMatrix< float, Eigen::RowMajor >& A) {
+	typedef Eigen::SparseMatrix< float, Eigen::RowMajor > RowMatrix;
+	int n = A.rows();
+	std::vector< int > color(n, -1);
+	// taken[c] == i marks color c as used by a neighbor of vertex i
+	std::vector< int > taken;
+	int numColors = 0;
+	for (int i = 0; i < n; ++i) {
+		for (RowMatrix::InnerIterator it(A, i); it; ++it) {
+			int c = color[it.col()];
+			if (c >= 0) {
+				taken[c] = i;
+			}
+		}
+		int c = 0;
+		while (c < numColors && taken[c] == i) {
+			++c;
+		}
+		if (c == numColors) {
+			taken.push_back(-1);
+			++numColors;
+		}
+		color[i] = c;
+	}
+
+	// Counting sort of the vertices by color
+	VertexColoring coloring;
+	coloring.classOffsets.assign(numColors + 1, 0);
+	for (int i = 0; i < n; ++i) {
+		++coloring.classOffsets[color[i] + 1];
+	}
+	for (int c = 0; c < numColors; ++c) {
+		coloring.classOffsets[c + 1] += coloring.classOffsets[c];
+	}
+	coloring.order.resize(n);
+	std::vector< int > fill(coloring.classOffsets.begin(), coloring.classOffsets.end() - 1);
+	for (int i = 0; i < n; ++i) {
+		coloring.order[fill[color[i]]++] = i;
+	}
+	return coloring;
+}
+
+/* Gershgorin discs of -L: centers -L(i,i), radii the off-diagonal
+ * absolute row sums. */
+static void _eigenvalueBounds(const Eigen::SparseMatrix< float, Eigen::RowMajor >& L, double& lower, double& upper) {
+	lower = 0.0;
+	upper = 0.0;
+	for (int i = 0; i < L.outerSize(); ++i) {
+		double center = 0.0;
+		double radius = 0.0;
+		for (Eigen::SparseMatrix< float, Eigen::RowMajor >::InnerIterator it(L, i); it; ++it) {
+			if (it.col() == i) {
+				center = -it.value();
+			} else {
+				radius += std::abs(it.value());
+			}
+		}
+		lower = std::min(lower, center - radius);
+		upper = std::max(upper, center + radius);
+	}
+}
+
+LaplacianCache::LaplacianCache() : mTopologyMesh(nullptr), mColoringMesh(nullptr), mColoringRevision(0), mBuildCount(0) {
+}
+
+LaplacianCache::Entry& LaplacianCache::entry(const Mesh& mesh, bool cotangentWeights) {
+	Entry& e = mEntries[cotangentWeights ? 1 : 0];
+	Revision topology = topologyRevision(mesh);
+	Revision revision = cotangentWeights ? geometryRevision(mesh) : topology;
+	if (e.mesh == &mesh && e.revision != revision && e.topology == topology) {
+		TRACE_SCOPE("laplacianRefresh");
+		refreshWeights(e, mesh, cotangentWeights);
+		_eigenvalueBounds(e.rows, e.lowerBound, e.upperBound);
+		e.revision = revision;
+		++mBuildCount;
+	} else if (e.mesh != &mesh || e.revision != revision) {
+		TRACE_SCOPE("laplacianAssembly");
+		e.matrix = umbrellaOperator(mesh, cotangentWeights);
+		e.rows = e.matrix.cast< float >();
+		e.sell.assign(e.matrix.cast< float >());
+		_eigenvalueBounds(e.rows, e.lowerBound, e.upperBound);
+		e.mesh = &mesh;
+		e.revision = revision;
+		e.topology = topology;
+		if (cotangentWeights) {
+			// Only cotangent weights are ever refreshed
+			if (mTopologyMesh != &mesh || mTopology.revision != topology) {
+				mTopology = halfEdgeTopology(mesh);
+				mTopologyMesh = &mesh;
+			}
+			findSlots(e);
+		}
+		++mBuildCount;
+	}
+	return e;
+}
+
+/* Entry (i, j) of a compressed sparse matrix, found by binary search in
+ * the inner vector of i for row-major and of j for column-major storage. */
+template < class Matrix >
+static int _entryPosition(const Matrix& A, int i, int j) {
+	int outer = Matrix::IsRowMajor ? i : j;
+	int inner = Matrix::IsRowMajor ? j : i;
+	const int* first = A.innerIndexPtr() + A.outerIndexPtr()[outer];
+	const int* last = A.innerIndexPtr() + A.outerIndexPtr()[outer + 1];
+	return std::lower_bound(first, last, inner) - A.innerIndexPtr();
+}
+
+void LaplacianCache::findSlots(Entry& e) {
+	e.matrixSlots.resize(mTopology.ringVertices.size());
+	e.rowSlots.resize(mTopology.ringVertices.size());
+	size_t ring = 0;
+	for (int i = 0; i < mTopology.numVertices; ++i) {
+		ring = std::max< size_t >(ring, mTopology.ringOffsets[i + 1] - mTopology.ringOffsets[i]);
+	}
+	// Sized for the largest ring now, so the first refresh allocates nothing
+	mWeights.reserve(ring);
+	for (int i = 0; i < mTopology.numVertices; ++i) {
+		for (int s = mTopology.ringOffsets[i]; s < mTopology.ringOffsets[i + 1]; ++s) {
+			e.matrixSlots[s] = _entryPosition(e.matrix, i, mTopology.ringVertices[s]);
+			e.rowSlots[s] = _entryPosition(e.rows, i, mTopology.ringVertices[s]);
+		}
+	}
+}
+
+/* Same weights as umbrellaOperator, written into the existing pattern
+ * through the slots found at assembly: off-diagonals are cleared first
+ * and then accumulated, so a neighbor met twice sums up the way
+ * setFromTriplets sums duplicates. */
+void LaplacianCache::refreshWeights(Entry& e, const Mesh& mesh, bool cotangentWeights) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	double* matrixValues = e.matrix.valuePtr();
+	float* rowValues = e.rows.valuePtr();
+	for (int slot : e.matrixSlots) {
+		matrixValues[slot] = 0.0;
+	}
+	for (int i = 0; i < mTopology.numVertices; ++i) {
+		umbrellaWeights(mTopology, vertices, i, cotangentWeights, mWeights);
+		int offset = mTopology.ringOffsets[i];
+		for (int j = 0; j < (int)mWeights.size(); ++j) {
+			matrixValues[e.matrixSlots[offset + j]] += mWeights[j];
+		}
+	}
+	for (int s = 0; s < (int)e.rowSlots.size(); ++s) {
+		rowValues[e.rowSlots[s]] = float(matrixValues[e.matrixSlots[s]]);
+	}
+	e.sell.updateValues(e.rows);
+}
+
+const Eigen::SparseMatrix< double >& LaplacianCache::matrix(const Mesh& mesh, bool cotangentWeights) {
+	return entry(mesh, cotangentWeights).matrix;
+}
+
+const SellMatrix& LaplacianCache::sell(const Mesh& mesh, bool cotangentWeights) {
+	return entry(mesh, cotangentWeights).sell;
+}
+
+const Eigen::SparseMatrix< float, Eigen::RowMajor >& LaplacianCache::rows(const Mesh& mesh, bool cotangentWeights) {
+	return entry(mesh, cotangentWeights).rows;
+}
+
+const VertexColoring& LaplacianCache::coloring(const Mesh& mesh) {
+	Revision revision = topologyRevision(mesh);
+	if (mColoringMesh != &mesh || mColoringRevision != revision) {
+		mColoring = greedyColoring(rows(mesh, false));
+		mColoringMesh = &mesh;
+		mColoringRevision = revision;
+	}
+	return mColoring;
+}
+
+void LaplacianCache::eigenvalueBounds(const Mesh& mesh, bool cotangentWeights, double& lower, double& upper) {
+	const Entry& e = entry(mesh, cotangentWeights);
+	lower = e.lowerBound;
+	upper = e.upperBound;
+}
+
+void LaplacianCache::invalidate() {
+	for (Entry& e : mEntries) {
+		e.mesh = nullptr;
+	}
+	mTopologyMesh = nullptr;
+	mColoringMesh = nullptr;
+}
+
+int LaplacianCache::buildCount() const {
+	return mBuildCount;
+}
+
+size_t LaplacianCache::memoryBytes() const {
+	size_t bytes = vectorBytes(mColoring.order) + vectorBytes(mColoring.classOffsets) + mTopology.memoryBytes()
+	               + vectorBytes(mWeights);
+	for (const Entry& e : mEntries) {
+		bytes += sparseBytes(e.matrix) + sparseBytes(e.rows) + e.sell.memoryBytes() + vectorBytes(e.matrixSlots)
+		         + vectorBytes(e.rowSlots);
+	}
+	return bytes;
+}
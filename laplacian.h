@@ -0,0 +1,114 @@
+#ifndef LAPLACIAN_H
+#define LAPLACIAN_H
+
+#include "circulators.h"
+#include "revision.h"
+#include "spmv.h"
+#include <Eigen/Sparse>
+#include <vector>
+
+class Mesh;
+class Vertex;
+
+/* Normalized umbrella weights of the one-ring of vertex, in the order the
+ * half-edge traversal visits the neighbors. The buffers are reused.
+ * totalWeight receives the sum of the raw weights when given. */
+void umbrellaWeights(const Vertex* vertex,
+                     bool cotangentWeights,
+                     std::vector< Vertex* >& neighbors,
+                     std::vector< double >& weights,
+                     double* totalWeight = nullptr);
+/* Same weights and order for vertex v, with the one-ring read from
+ * topology instead of chasing half-edge pointers; vertices are those of
+ * the mesh topology was built from. */
+void umbrellaWeights(const HalfEdgeTopology& topology,
+                     const std::vector< Vertex* >& vertices,
+                     int v,
+                     bool cotangentWeights,
+                     std::vector< double >& weights,
+                     double* totalWeight = nullptr);
+
+/* Row-normalized umbrella operator of the mesh: L(i,i) = -1 and
+ * L(i,j) = w_ij / sum_k w_ik over the one-ring of vertex i, with uniform
+ * or cotangent weights w_ij. Explicit smoothing applies x + lambda * L x
+ * and implicit smoothing solves (I - lambda * L) x' = x. Weights are
+ * computed in double. */
+Eigen::SparseMatrix< double > umbrellaOperator(const Mesh& mesh, bool cotangentWeights);
+
+/* Partition of the vertices into independent sets: no two vertices of a
+ * color class share an edge, so a class can be updated in parallel
+ * without races. order lists the vertices grouped by color, class c
+ * being order[classOffsets[c]] .. order[classOffsets[c + 1] - 1]. */
+struct VertexColoring {
+	std::vector< int > order;
+	std::vector< int > classOffsets;
+
+	int numColors() const;
+};
+
+/* Greedy coloring of the graph given by the off-diagonal sparsity of A. */
+VertexColoring greedyColoring(const Eigen::SparseMatrix< float, Eigen::RowMajor >& A);
+
+/* Umbrella operators of one mesh kept across smoothing calls, in both the
+ * Eigen form used for assembling solver systems and the SELL-C form used
+ * for products. An entry is rebuilt when a different mesh is passed, after
+ * invalidate(), or when the mesh revision it was built from is outdated:
+ * the topology revision for uniform weights and the coloring, and the
+ * geometry revision for cotangent weights, which follow the shape. When
+ * only the geometry moved, the cotangent weights are rewritten in place
+ * through the index topology kept with the operators, and the refresh
+ * allocates nothing. Positions written with
+ * Vertex::setPosition are only seen after Mesh::setVertexPosDirty(true);
+ * until then the cotangent weights of the old shape are served. */
+class LaplacianCache {
+public:
+	LaplacianCache();
+
+	const Eigen::SparseMatrix< double >& matrix(const Mesh& mesh, bool cotangentWeights);
+	const SellMatrix& sell(const Mesh& mesh, bool cotangentWeights);
+	/* Row-major float copy for row-wise sweeps. */
+	const Eigen::SparseMatrix< float, Eigen::RowMajor >& rows(const Mesh& mesh, bool cotangentWeights);
+	/* Coloring of the one-ring graph, shared by both weightings. */
+	const VertexColoring& coloring(const Mesh& mesh);
+	/* Gershgorin interval holding every eigenvalue of -L. It is [0, 2]
+	 * for uniform weights and cotangent weights of non-obtuse meshes, and
+	 * wider when obtuse triangles make cotangent weights negative. */
+	void eigenvalueBounds(const Mesh& mesh, bool cotangentWeights, double& lower, double& upper);
+
+	void invalidate();
+	/* Number of operator assemblies so far, for checking reuse. */
+	int buildCount() const;
+	/* Bytes of the cached operators and coloring. */
+	size_t memoryBytes() const;
+
+private:
+	struct Entry {
+		const Mesh* mesh = nullptr;
+		Revision revision = 0;
+		Revision topology = 0; // the sparsity pattern was built from
+		Eigen::SparseMatrix< double > matrix;
+		SellMatrix sell;
+		Eigen::SparseMatrix< float, Eigen::RowMajor > rows;
+		double lowerBound = 0.0; // eigenvalue bounds of -L
+		double upperBound = 2.0;
+		// Positions in matrix and rows of the entries of every one-ring
+		// slot of the topology, written by refreshWeights
+		std::vector< int > matrixSlots;
+		std::vector< int > rowSlots;
+	};
+
+	Entry& entry(const Mesh& mesh, bool cotangentWeights);
+	void findSlots(Entry& e);
+	void refreshWeights(Entry& e, const Mesh& mesh, bool cotangentWeights);
+
+	Entry mEntries[2]; // uniform, cotangent
+	HalfEdgeTopology mTopology;
+	const Mesh* mTopologyMesh;
+	std::vector< double > mWeights; // one-ring buffer of refreshWeights
+	VertexColoring mColoring;
+	const Mesh* mColoringMesh;
+	Revision mColoringRevision;
+	int mBuildCount;
+};
+
+#endif
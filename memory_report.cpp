@@ -0,0 +1,84 @@
+#include "memory_report.h"
+#include "mesh.h"
+#include <sstream>
+
+static const size_t ALLOCATION_OVERHEAD = 16;
+
+void MeshMemoryReport::addCache(const std::string& name, size_t bytes) {
+	caches.push_back(std::make_pair(name, bytes));
+}
+
+size_t MeshMemoryReport::meshBytes() const {
+	return vertices + interiorHEdges + boundaryHEdges + deadBoundaryHEdges + faces + adjacency + lists
+	       + vertexMatrix + faceMatrix + allocatorOverhead;
+}
+
+size_t MeshMemoryReport::cacheBytes() const {
+	size_t bytes = 0;
+	for (const std::pair< std::string, size_t >& cache : caches) {
+		bytes += cache.second;
+	}
+	return bytes;
+}
+
+size_t MeshMemoryReport::totalBytes() const {
+	return meshBytes() + cacheBytes();
+}
+
+double MeshMemoryReport::bytesPerVertex() const {
+	return numVertices ? double(totalBytes()) / numVertices : 0.0;
+}
+
+double MeshMemoryReport::bytesPerFace() const {
+	return numFaces ? double(totalBytes()) / numFaces : 0.0;
+}
+
+std::string MeshMemoryReport::toJson() const {
+	std::ostringstream out;
+	out << "{\"numVertices\":" << numVertices << ",\"numFaces\":" << numFaces
+	    << ",\"vertices\":" << vertices << ",\"interiorHEdges\":" << interiorHEdges
+	    << ",\"boundaryHEdges\":" << boundaryHEdges << ",\"deadBoundaryHEdges\":" << deadBoundaryHEdges
+	    << ",\"faces\":" << faces << ",\"adjacency\":" << adjacency << ",\"lists\":" << lists
+	    << ",\"vertexMatrix\":" << vertexMatrix << ",\"faceMatrix\":" << faceMatrix
+	    << ",\"heapBlocks\":" << heapBlocks << ",\"allocatorOverhead\":" << allocatorOverhead
+	    << ",\"caches\":{";
+	for (size_t i = 0; i < caches.size(); ++i) {
+		out << (i ? "," : "") << "\"" << caches[i].first << "\":" << caches[i].second;
+	}
+	out << "},\"meshBytes\":" << meshBytes() << ",\"cacheBytes\":" << cacheBytes()
+	    << ",\"totalBytes\":" << totalBytes() << ",\"bytesPerVertex\":" << bytesPerVertex()
+	    << ",\"bytesPerFace\":" << bytesPerFace() << "}";
+	return out.str();
+}
+
+MeshMemoryReport meshMemoryReport(const Mesh& mesh) {
+	MeshMemoryReport report;
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int numVertices = vertices.size();
+	int numFaces = mesh.faces().size();
+	size_t numInterior = mesh.edges().size();
+	size_t numBoundary = mesh.boundaryEdges().size();
+
+	report.numVertices = numVertices;
+	report.numFaces = numFaces;
+	report.vertices = numVertices * sizeof(Vertex);
+	report.interiorHEdges = numInterior * sizeof(HEdge);
+	report.boundaryHEdges = numBoundary * sizeof(HEdge);
+	// loadMeshFile frees the boundary half-edges unlinked by addFace
+	report.deadBoundaryHEdges = 0;
+	report.faces = numFaces * sizeof(Face);
+	report.lists = vectorBytes(vertices) + vectorBytes(mesh.faces()) + vectorBytes(mesh.edges())
+	               + vectorBytes(mesh.boundaryEdges());
+	report.vertexMatrix = 3 * size_t(numVertices) * sizeof(float);
+	report.faceMatrix = 3 * size_t(numFaces) * sizeof(int);
+
+	size_t adjacencyBlocks = 0;
+	for (const Vertex* v : vertices) {
+		report.adjacency += vectorBytes(v->adjHEdges);
+		adjacencyBlocks += v->adjHEdges.capacity() ? 1 : 0;
+	}
+	report.heapBlocks = numVertices + numInterior + numBoundary + numFaces + adjacencyBlocks + 4
+	                    + (numVertices ? 1 : 0) + (numFaces ? 1 : 0);
+	report.allocatorOverhead = report.heapBlocks * ALLOCATION_OVERHEAD;
+	return report;
+}
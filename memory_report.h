@@ -0,0 +1,75 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <Eigen/Sparse>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Mesh;
+
+/* Bytes held by a mesh, per structure, for capacity planning.
+ *
+ * Object sizes are sizeof of the half-edge classes; allocatorOverhead
+ * estimates the malloc bookkeeping of the separately allocated objects
+ * at 16 bytes each, typical of 64-bit allocators. Capacities are counted
+ * rather than sizes, since that is what stays resident.
+ *
+ * Dead boundary half-edges are the ones addFace creates and
+ * loadMeshFile unlinks when twins merge. loadMeshFile deletes them, so
+ * deadBoundaryHEdges is 0; the field stays so reports remain comparable
+ * with those of builds that leaked them, 3 per face minus the live
+ * boundary half-edges. Vertex::adjHEdges is cleared after loading but
+ * keeps its capacity. */
+struct MeshMemoryReport {
+	int numVertices = 0;
+	int numFaces = 0;
+
+	size_t vertices = 0;
+	size_t interiorHEdges = 0;
+	size_t boundaryHEdges = 0;
+	size_t deadBoundaryHEdges = 0;
+	size_t faces = 0;
+	size_t adjacency = 0;    // Vertex::adjHEdges capacity
+	size_t lists = 0;        // Mesh's pointer vectors
+	size_t vertexMatrix = 0; // parsed positions Mesh keeps, float
+	size_t faceMatrix = 0;   // parsed faces Mesh keeps, int
+	size_t heapBlocks = 0;
+	size_t allocatorOverhead = 0;
+
+	// Operators, factorizations and other derived data added by the caller
+	std::vector< std::pair< std::string, size_t > > caches;
+
+	void addCache(const std::string& name, size_t bytes);
+
+	size_t meshBytes() const;
+	size_t cacheBytes() const;
+	size_t totalBytes() const;
+	/* Total, including caches, per vertex and per face. */
+	double bytesPerVertex() const;
+	double bytesPerFace() const;
+
+	std::string toJson() const;
+};
+
+/* Account the mesh itself. Caches such as LaplacianCache::memoryBytes()
+ * or ConstrainedSmoother::memoryBytes() are added with addCache. The
+ * parsed matrices are assumed to match the current element counts, as
+ * they do after loadMeshFile. */
+MeshMemoryReport meshMemoryReport(const Mesh& mesh);
+
+template < class T >
+size_t vectorBytes(const std::vector< T >& v) {
+	return v.capacity() * sizeof(T);
+}
+
+/* Allocated entries plus the outer index of a compressed sparse matrix. */
+template < class Scalar, int Options, class StorageIndex >
+size_t sparseBytes(const Eigen::SparseMatrix< Scalar, Options, StorageIndex >& A) {
+	return A.data().allocatedSize() * (sizeof(Scalar) + sizeof(StorageIndex))
+	       + (A.outerSize() + 1) * sizeof(StorageIndex)
+	       + (A.isCompressed() ? 0 : A.outerSize() * sizeof(StorageIndex));
+}
+
+#endif
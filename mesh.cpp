@@ -1,4 +1,9 @@
 #include "mesh.h"
+#include "perf_counters.h"
+#include "revision.h"
+#include "solver.h"
+#include "trace.h"
+#include <chrono>
 #include <iostream>
 #include <igl/read_triangle_mesh.h>
 #include <Eigen/Sparse>
@@ -139,6 +144,10 @@ const Eigen::Vector3f& Vertex::position() const {
 	return mPosition;
 }
 
+/* A vertex does not know its mesh, so this cannot bump the geometry
+ * revision. Callers must follow their writes with
+ * Mesh::setVertexPosDirty(true), or caches such as LaplacianCache keep
+ * serving weights of the old shape. */
 const Eigen::Vector3f& Vertex::setPosition(const Eigen::Vector3f& p) {
 	mPosition = p;
 	return mPosition;
@@ -259,6 +268,7 @@ Mesh::Mesh() {
 
 Mesh::~Mesh() {
 	clear();
+	forgetRevisions(*this);
 }
 
 const std::vector< HEdge* >& Mesh::edges() const {
@@ -284,6 +294,9 @@ bool Mesh::isVertexPosDirty() const {
 
 void Mesh::setVertexPosDirty(bool b) {
 	mVertexPosFlag = b;
+	if (b) {
+		bumpGeometryRevision(*this);
+	}
 }
 
 bool Mesh::isVertexNormalDirty() const {
@@ -303,8 +316,13 @@ void Mesh::setVertexColorDirty(bool b) {
 }
 
 bool Mesh::loadMeshFile(const std::string filename) {
+	TRACE_SCOPE("loadMeshFile");
 	// Use libigl to parse the mesh file
-	bool iglFlag = igl::read_triangle_mesh(filename, mVertexMat, mFaceMat);
+	bool iglFlag;
+	{
+		TRACE_SCOPE("parse");
+		iglFlag = igl::read_triangle_mesh(filename, mVertexMat, mFaceMat);
+	}
 	if (iglFlag) {
 		clear();
 
@@ -318,17 +336,24 @@ bool Mesh::loadMeshFile(const std::string filename) {
 			                                 mVertexMat(vidx, 1),
 			                                 mVertexMat(vidx, 2)));
 		}
-		// Fill in the face list
-		for (int fidx = 0; fidx < numFaces; ++fidx) {
-			addFace(mFaceMat(fidx, 0), mFaceMat(fidx, 1), mFaceMat(fidx, 2));
+		// Fill in the face list, merging twins face by face
+		{
+			TRACE_SCOPE("addFaces");
+			PERF_SCOPE("addFaces");
+			for (int fidx = 0; fidx < numFaces; ++fidx) {
+				addFace(mFaceMat(fidx, 0), mFaceMat(fidx, 1), mFaceMat(fidx, 2));
+			}
 		}
 
+		TRACE_SCOPE("compactBoundary");
 		std::vector< HEdge* > hedgeList;
 		for (int i = 0; i < mBHEdgeList.size(); ++i) {
 			if (mBHEdgeList[i]->start()) {
 				hedgeList.push_back(mBHEdgeList[i]);
+			} else {
+				// Unlinked by addFace when its twins merged; nothing points to it
+				delete mBHEdgeList[i];
 			}
-			// TODO
 		}
 		mBHEdgeList = hedgeList;
 
@@ -337,6 +362,7 @@ bool Mesh::loadMeshFile(const std::string filename) {
 			mVertexList[i]->setIndex(i);
 			mVertexList[i]->setFlag(0);
 		}
+		bumpTopologyRevision(*this);
 	} else {
 		std::cout << __FUNCTION__ << ": mesh file loading failed!\n";
 	}
@@ -488,9 +514,11 @@ void Mesh::clear() {
 	mBHEdgeList.clear();
 	mVertexList.clear();
 	mFaceList.clear();
+	bumpTopologyRevision(*this);
 }
 
 std::vector< int > Mesh::collectMeshStats() {
+	TRACE_SCOPE("collectMeshStats");
 	int V = 0; // # of vertices
 	int E = 0; // # of half-edges
 	int F = 0; // # of faces
@@ -617,6 +645,8 @@ void simpleDFS(HEdge* edge) {
 }
 
 void Mesh::computeVertexNormals() {
+	TRACE_SCOPE("computeVertexNormals");
+	PERF_SCOPE("computeVertexNormals");
 	/*====== Programming Assignment 0 ======*/
 
 	/**********************************************/
@@ -634,28 +664,23 @@ void Mesh::computeVertexNormals() {
 		//4. computeVertexNormals init normal fred
 
 		Eigen::Vector3f normal = Eigen::Vector3f::Zero();
-		// get neighbors by half-edges and collect the positions
-		// center + 2 adjacent neighbors should make a face
-		// 0 and size - 1 is adjacent
+		// walk the one-ring by half-edges: center + 2 adjacent neighbors
+		// make a face. No neighbor list is collected, so the pass does not
+		// allocate.
 		Vertex* center = mVertexList[i];
-		std::vector<Eigen::Vector3f> neighbors;
-		HEdge* edge = center->halfEdge();
-		neighbors.push_back(edge->end()->position());
-		HEdge* anedge = edge->twin()->next();
-		while (edge != anedge) {
-			neighbors.push_back(anedge->end()->position());
-			anedge = anedge->twin()->next();
-		}
-		// get normal and area of each face and plus together
 		double totalWeights = 0.0;
-		for (int j = 0; j < neighbors.size() - 1; ++j) {
-			double area = triangleArea(center->position(), neighbors[j + 1], neighbors[j]);
-			normal += triangleNormal(center->position(), neighbors[j + 1], neighbors[j]) * area;
+		HEdge* edge = center->halfEdge();
+		HEdge* curr = edge;
+		do {
+			HEdge* next = curr->twin()->next();
+			const Eigen::Vector3f& a = curr->end()->position();
+			const Eigen::Vector3f& b = next->end()->position();
+			// get normal and area of each face and plus together
+			double area = triangleArea(center->position(), b, a);
+			normal += triangleNormal(center->position(), b, a) * area;
 			totalWeights += area;
-		}
-		double lastArea = triangleArea(center->position(), neighbors[0], neighbors[neighbors.size() - 1]);
-		normal += triangleNormal(center->position(), neighbors[0], neighbors[neighbors.size() - 1]) * lastArea;
-		totalWeights += lastArea;
+			curr = next;
+		} while (curr != edge);
 		// average by weights
 		normal /= totalWeights;
 		normal.normalize();
@@ -668,6 +693,7 @@ void Mesh::computeVertexNormals() {
 
 
 void Mesh::umbrellaSmooth(bool cotangentWeights) {
+	TRACE_SCOPE("umbrellaSmooth");
 	/*====== Programming Assignment 1 ======*/
 
 	if (cotangentWeights) {
@@ -691,6 +717,10 @@ void Mesh::umbrellaSmooth(bool cotangentWeights) {
 		// make sure all 0
 		Xt.setZero();
 		P.setZero();
+		// per-vertex buffers, reused so each vertex does not allocate anew
+		std::vector<Vertex*> neighbors;
+		std::vector<double> weights;
+		std::vector<int> indices;
 		// filling P and Xt
 		for (int i = 0; i < vertexNumber; ++i) {
 			Vertex* vertex = mVertexList[i];
@@ -702,7 +732,7 @@ void Mesh::umbrellaSmooth(bool cotangentWeights) {
 			// fill P with corresponding weights
 			P.coeffRef(i, i) = -1.0;
 			// collect neighbors
-			std::vector<Vertex*> neighbors;
+			neighbors.clear();
 			HEdge* edge = vertex->halfEdge();
 			neighbors.push_back(edge->end());
 			HEdge* anedge = edge->twin()->next();
@@ -714,8 +744,8 @@ void Mesh::umbrellaSmooth(bool cotangentWeights) {
 			double totalWeights = 0.0;
 			Eigen::Vector3f centerPosition = vertex->position();
 			int length = neighbors.size();
-			std::vector<double> weights;
-			std::vector<int> indices;
+			weights.clear();
+			indices.clear();
 			for (int j = 0; j < length; ++j) {
 				int j_m1 = j - 1 < 0 ? j - 1 + length : j - 1;
 				int j_p1 = j + 1 >= length ? j + 1 - length : j + 1;
@@ -804,83 +834,10 @@ void Mesh::umbrellaSmooth(bool cotangentWeights) {
 }
 
 void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
+	TRACE_SCOPE("implicitUmbrellaSmooth");
 	/*====== Programming Assignment 1 ======*/
 
-	/* A sparse linear system Ax=b solver using the conjugate gradient method. */
-	auto fnConjugateGradient = [](const Eigen::SparseMatrix< float >& A,
-	                              const Eigen::VectorXf& b,
-	                              int maxIterations,
-	                              float errorTolerance,
-	                              Eigen::VectorXf& x)
-	{
-		/**********************************************/
-		/*          Insert your code here.            */
-		/**********************************************/
-		/*
-		/* Params:
-		/*  A: 
-		/*  b: 
-		/*  maxIterations:	Max number of iterations
-		/*  errorTolerance: Error tolerance for the early stopping condition
-		/*  x:				Stores the final solution, but should be initialized. 
-		/**********************************************/
-		/*
-		/* Step 1: Implement the biconjugate gradient
-		/* method.
-		/* Hint: https://en.wikipedia.org/wiki/Biconjugate_gradient_method
-		/**********************************************/
-
-		Eigen::VectorXf r = b - A * x;
-		Eigen::VectorXf r_star = r;
-		double rou = 1.0;
-		double alpha = 1.0;
-		double w = 1.0;
-		Eigen::VectorXf v = r;
-		Eigen::VectorXf p = r;
-		v.setZero(); p.setZero();
-		for (int i = 0; i < maxIterations; ++i) {
-			Eigen::VectorXf diff = b - A * x;
-			double error = diff.dot(diff);
-			if (error < errorTolerance) {
-				// very close, further calculation not needed
-				break;
-			}
-
-			// std::cout<<i<<" ";
-
-			double rou_next = r_star.dot(r);
-			double beta = (rou_next / rou) * (alpha / w);
-			Eigen::VectorXf p_next = r + beta * (p - w * v);
-			Eigen::VectorXf v_next = A * p_next;
-			alpha = rou_next / (r_star.dot(v_next));
-			Eigen::VectorXf h = x + alpha * p_next;
-
-			diff = b - A * h;
-			error = diff.dot(diff);
-			if (error < errorTolerance) {
-				x = h;
-				// very close, further calculation not needed
-				break;
-			}
-
-			Eigen::VectorXf s = r - alpha * v_next;
-			Eigen::VectorXf t = A * s;
-			double w_next = t.dot(s) / t.dot(t);
-			Eigen::VectorXf x_next = h + w_next * s;
-
-			Eigen::VectorXf r_next = s - w_next * t;
-			// replace values
-			r = r_next;
-			rou = rou_next;
-			w = w_next;
-			v = v_next;
-			p = p_next;
-			x = x_next;
-		}
-		// std::cout<<"result x "<<x<<std::endl;
-		return x;
-	};
-	
+	/* Sparse linear systems are solved by the shared BiCGSTAB in solver.cpp. */
 
 	/* IMPORTANT:
 	/* Please refer to the following link about the sparse matrix construction in Eigen. */
@@ -889,6 +846,30 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 	// fred 7 
 	int MAX_ITERATIONS = 2000;
 	float ERROR_TOLERANCE = 1e-7;
+	// Above this size plain BiCGSTAB iteration counts grow with the mesh,
+	// so the multigrid-preconditioned solver is used instead
+	int MULTIGRID_MIN_VERTICES = 100000;
+
+	// Assembly starts here; the solve below reports it in its trace
+	auto assemblyStart = std::chrono::steady_clock::now();
+
+	/* Solve A X = B for the three coordinate columns of B. */
+	auto fnSolveSystem = [&](const Eigen::SparseMatrix< float >& A,
+	                         const Eigen::SparseMatrix< double >& B)
+	{
+		SolveOptions options;
+		options.maxIterations = MAX_ITERATIONS;
+		options.errorTolerance = ERROR_TOLERANCE;
+		options.multigridMinSize = MULTIGRID_MIN_VERTICES;
+		SolveTrace trace;
+		trace.source = "Mesh::implicitUmbrellaSmooth";
+		trace.assemblySeconds = std::chrono::duration< double >(
+			std::chrono::steady_clock::now() - assemblyStart).count();
+		Eigen::MatrixXd X;
+		solveColumns(A, Eigen::MatrixXd(B), X, options, &trace);
+		reportSolveTrace(trace, options);
+		return Eigen::MatrixXf(X.cast< float >());
+	};
 
 	if (cotangentWeights) {
 		/**********************************************/
@@ -897,7 +878,7 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 		/*
 		/* Step 2: Implement the cotangent weighting 
 		/* scheme for implicit mesh smoothing. Use
-		/* the above fnConjugateGradient for solving
+		/* the above fnSolveSystem for solving
 		/* sparse linear systems.
 		/*
 		/* Hint:
@@ -911,6 +892,10 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 		// make sure all 0
 		Xt.setZero();
 		P.setZero();
+		// per-vertex buffers, reused so each vertex does not allocate anew
+		std::vector<Vertex*> neighbors;
+		std::vector<double> weights;
+		std::vector<int> indices;
 		// filling P and Xt
 		for (int i = 0; i < vertexNumber; ++i) {
 			Vertex* vertex = mVertexList[i];
@@ -922,7 +907,7 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 			// fill P with corresponding weights
 			P.coeffRef(i, i) = 1.0 - lambda * (-1.0);
 			// collect neighbors
-			std::vector<Vertex*> neighbors;
+			neighbors.clear();
 			HEdge* edge = vertex->halfEdge();
 			neighbors.push_back(edge->end());
 			HEdge* anedge = edge->twin()->next();
@@ -934,8 +919,8 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 			double totalWeights = 0.0;
 			Eigen::Vector3f centerPosition = vertex->position();
 			int length = neighbors.size();
-			std::vector<double> weights;
-			std::vector<int> indices;
+			weights.clear();
+			indices.clear();
 			for (int j = 0; j < length; ++j) {
 				int j_m1 = j - 1 < 0 ? j - 1 + length : j - 1;
 				int j_p1 = j + 1 >= length ? j + 1 - length : j + 1;
@@ -955,15 +940,7 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 		}
 
 		// solve linear system
-		Eigen::MatrixXf Xt_p1(vertexNumber, 3);
-		Xt_p1.setZero();
-		for (int j = 0; j < 3; ++j) {
-			Eigen::VectorXf x(vertexNumber); x.setZero();
-			x = fnConjugateGradient(
-				P, Xt.col(j), MAX_ITERATIONS, ERROR_TOLERANCE, x
-			);
-			Xt_p1.col(j) = x;
-		}
+		Eigen::MatrixXf Xt_p1 = fnSolveSystem(P, Xt);
 		// fill the result back to vertices
 		for (int i = 0; i < vertexNumber; ++i) {
 			Eigen::Vector3f position;
@@ -980,7 +957,7 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 		/*
 		/* Step 3: Implement the uniform weighting 
 		/* scheme for implicit mesh smoothing. Use
-		/* the above fnConjugateGradient for solving
+		/* the above fnSolveSystem for solving
 		/* sparse linear systems.
 		/**********************************************/
 		int vertexNumber = mVertexList.size();
@@ -1012,15 +989,7 @@ void Mesh::implicitUmbrellaSmooth(bool cotangentWeights) {
 		}
 
 		// solve linear system
-		Eigen::MatrixXf Xt_p1(vertexNumber, 3);
-		Xt_p1.setZero();
-		for (int j = 0; j < 3; ++j) {
-			Eigen::VectorXf x(vertexNumber); x.setZero();
-			x = fnConjugateGradient(
-				P, Xt.col(j), MAX_ITERATIONS, ERROR_TOLERANCE, x
-			);
-			Xt_p1.col(j) = x;
-		}
+		Eigen::MatrixXf Xt_p1 = fnSolveSystem(P, Xt);
 		// fill the result back to vertices
 		for (int i = 0; i < vertexNumber; ++i) {
 			Eigen::Vector3f position;
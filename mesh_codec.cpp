@@ -0,0 +1,473 @@
+#include "mesh_codec.h"
+#include "mesh.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+enum _GateSymbol {
+	GATE_SKIP = 0, // no unvisited face behind the gate
+	GATE_NEW = 1,  // the face brings a new vertex
+	GATE_REF = 2   // the face closes onto a visited vertex
+};
+
+/* Fixed-size part of the encoding, followed by the streams in order. */
+struct _CodecHeader {
+	char magic[8];
+	std::uint32_t numVertices;
+	std::uint32_t numFaces;
+	std::uint32_t positionBits;
+	std::uint32_t normalBits;
+	float bboxMin[3];
+	float bboxMax[3];
+	std::uint32_t numSymbols;
+	std::uint32_t symbolBytes;
+	std::uint32_t refBytes;
+	std::uint32_t positionBytes;
+	std::uint32_t normalBytes;
+};
+
+static const char _CODEC_MAGIC[8] = {'M', 'E', 'S', 'H', 'C', 'M', 'P', '1'};
+
+/* Writes at most 5 bytes and returns the end of the varint. */
+static std::uint8_t* _putVarint(std::uint8_t* out, std::uint32_t value) {
+	while (value >= 0x80) {
+		*out++ = std::uint8_t(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = std::uint8_t(value);
+	return out;
+}
+
+static bool _getVarint(const std::uint8_t*& in, const std::uint8_t* end, std::uint32_t& value) {
+	value = 0;
+	for (int shift = 0; in < end && shift < 35; shift += 7) {
+		std::uint8_t byte = *in++;
+		value |= std::uint32_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::uint32_t _zigzag(std::int32_t value) {
+	return (std::uint32_t(value) << 1) ^ std::uint32_t(value >> 31);
+}
+
+static std::int32_t _unzigzag(std::uint32_t value) {
+	return std::int32_t(value >> 1) ^ -std::int32_t(value & 1);
+}
+
+/* Octahedral mapping of a unit vector to two bits-wide integers. */
+static void _encodeOctahedral(const float* n, int bits, std::uint16_t* out) {
+	float length = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	float x = length > 0.0f ? n[0] / length : 0.0f;
+	float y = length > 0.0f ? n[1] / length : 0.0f;
+	if (n[2] < 0.0f) {
+		float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	// Both values are non-negative, so truncation after + 0.5 rounds
+	float scale = float((1 << bits) - 1);
+	out[0] = std::uint16_t((x * 0.5f + 0.5f) * scale + 0.5f);
+	out[1] = std::uint16_t((y * 0.5f + 0.5f) * scale + 0.5f);
+}
+
+static void _decodeOctahedral(const std::uint16_t* in, int bits, float* n) {
+	float scale = float((1 << bits) - 1);
+	float x = in[0] / scale * 2.0f - 1.0f;
+	float y = in[1] / scale * 2.0f - 1.0f;
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0.0f) {
+		float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	n[0] = x / length;
+	n[1] = y / length;
+	n[2] = z / length;
+}
+
+/* Writes 2-bit symbols, four per byte, into room for maxSymbols. */
+class _SymbolWriter {
+public:
+	explicit _SymbolWriter(size_t maxSymbols) : mBytes(maxSymbols / 4 + 1, 0), mCount(0) {
+	}
+	void put(int symbol) {
+		mBytes[mCount >> 2] |= std::uint8_t(symbol << (2 * (mCount & 3)));
+		++mCount;
+	}
+	std::uint32_t numBytes() const {
+		return (mCount + 3) / 4;
+	}
+	std::vector< std::uint8_t > mBytes;
+	std::uint32_t mCount;
+};
+
+std::vector< std::uint8_t > encodeMesh(const MeshArrays& arrays,
+                                       const Eigen::Vector3f& bboxMin,
+                                       const Eigen::Vector3f& bboxMax,
+                                       const MeshCodecOptions& options) {
+	int numVertices = arrays.positions.rows();
+	int numFaces = arrays.faces.rows();
+	int positionBits = std::max(1, std::min(30, options.positionBits));
+	int normalBits = std::max(0, std::min(16, options.normalBits));
+	const int* F = arrays.faces.data();
+
+	// Twins through the outgoing half-edges of every vertex, h = 3f + k
+	// running from corner k to corner k + 1 of face f
+	std::vector< int > offsets(numVertices + 1, 0);
+	for (int h = 0; h < 3 * numFaces; ++h) {
+		++offsets[F[h] + 1];
+	}
+	for (int v = 0; v < numVertices; ++v) {
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector< int > outgoing(3 * numFaces);
+	std::vector< int > cursor(offsets.begin(), offsets.end() - 1);
+	for (int h = 0; h < 3 * numFaces; ++h) {
+		outgoing[cursor[F[h]]++] = h;
+	}
+	auto endOf = [&](int h) {
+		return F[h % 3 == 2 ? h - 2 : h + 1];
+	};
+	// The half-edges into v are the predecessors of those out of v, so
+	// every twin is found among the faces around v alone. Pairs are set
+	// from both sides at once, so a half-edge already paired is skipped
+	std::vector< int > twin(3 * numFaces, -1);
+	for (int v = 0; v < numVertices; ++v) {
+		for (int i = offsets[v]; i < offsets[v + 1]; ++i) {
+			int h = outgoing[i];
+			if (twin[h] >= 0) {
+				continue;
+			}
+			int x = endOf(h);
+			for (int j = offsets[v]; j < offsets[v + 1]; ++j) {
+				int g = outgoing[j];
+				int in = g % 3 == 0 ? g + 2 : g - 1;
+				if (F[in] == x) {
+					twin[h] = in;
+					twin[in] = h;
+					break;
+				}
+			}
+		}
+	}
+	std::vector< int >().swap(outgoing);
+	std::vector< int >().swap(cursor);
+
+	// Quantization grid
+	float scale[3];
+	for (int k = 0; k < 3; ++k) {
+		float extent = bboxMax[k] - bboxMin[k];
+		scale[k] = extent > 0.0f ? float((1 << positionBits) - 1) / extent : 0.0f;
+	}
+	std::int32_t maxValue = (1 << positionBits) - 1;
+	std::vector< std::int32_t > q(3 * numVertices);
+	for (int v = 0; v < numVertices; ++v) {
+		for (int k = 0; k < 3; ++k) {
+			float x = (arrays.positions(v, k) - bboxMin[k]) * scale[k] + 0.5f;
+			q[3 * v + k] = x <= 0.0f ? 0 : std::min(maxValue, std::int32_t(x));
+		}
+	}
+
+	// Octahedral normals in input order, a linear pass
+	std::vector< std::uint16_t > octahedral(normalBits ? 2 * numVertices : 0);
+	for (int v = 0; normalBits && v < numVertices; ++v) {
+		_encodeOctahedral(arrays.normals.row(v).data(), normalBits, &octahedral[2 * v]);
+	}
+
+	// Every stream is sized for the worst case up front, uninitialized,
+	// and only its used part is copied out: a component costs 3 symbols
+	// for its first face plus one per gate, each face pushes 2 gates,
+	// at most 3 references come per face and every varint takes at most
+	// 5 bytes
+	_SymbolWriter symbols(6 * size_t(numFaces) + numVertices);
+	std::unique_ptr< std::uint8_t[] > refs(new std::uint8_t[15 * size_t(numFaces) + 1]);
+	std::unique_ptr< std::uint8_t[] > positions(new std::uint8_t[15 * size_t(numVertices) + 1]);
+	std::vector< std::uint16_t > normals(octahedral.size());
+	std::uint8_t* refsEnd = refs.get();
+	std::uint8_t* positionsEnd = positions.get();
+
+	std::vector< int > newId(numVertices, -1);
+	int nextId = 0;
+	std::int32_t last[3] = {0, 0, 0};
+	// Emit vertex v, predicted at pred when it is new
+	auto emitVertex = [&](int v, const std::int32_t* pred) {
+		if (newId[v] >= 0) {
+			symbols.put(GATE_REF);
+			refsEnd = _putVarint(refsEnd, nextId - 1 - newId[v]);
+			return;
+		}
+		symbols.put(GATE_NEW);
+		if (normalBits) {
+			normals[2 * nextId] = octahedral[2 * v];
+			normals[2 * nextId + 1] = octahedral[2 * v + 1];
+		}
+		newId[v] = nextId++;
+		for (int k = 0; k < 3; ++k) {
+			positionsEnd = _putVarint(positionsEnd, _zigzag(q[3 * v + k] - pred[k]));
+			last[k] = q[3 * v + k];
+		}
+	};
+
+	std::vector< char > visited(numFaces, 0);
+	std::vector< int > gates;
+	for (int start = 0; start < numFaces; ++start) {
+		if (visited[start]) {
+			continue;
+		}
+		// A new component: its first face, then a depth-first sweep
+		visited[start] = 1;
+		for (int k = 0; k < 3; ++k) {
+			std::int32_t pred[3] = {last[0], last[1], last[2]};
+			emitVertex(F[3 * start + k], pred);
+		}
+		gates.push_back(3 * start + 2);
+		gates.push_back(3 * start + 1);
+		gates.push_back(3 * start);
+		while (!gates.empty()) {
+			int h = gates.back();
+			gates.pop_back();
+			int t = twin[h];
+			if (t < 0 || visited[t / 3]) {
+				symbols.put(GATE_SKIP);
+				continue;
+			}
+			int f = t / 3;
+			int k = t % 3;
+			visited[f] = 1;
+			int a = F[h];
+			int b = endOf(h);
+			int c = F[3 * (h / 3) + (h % 3 + 2) % 3];
+			int v = F[3 * f + (k + 2) % 3];
+			std::int32_t pred[3];
+			for (int d = 0; d < 3; ++d) {
+				pred[d] = q[3 * a + d] + q[3 * b + d] - q[3 * c + d];
+			}
+			emitVertex(v, pred);
+			gates.push_back(3 * f + (k + 2) % 3);
+			gates.push_back(3 * f + (k + 1) % 3);
+		}
+	}
+	// Vertices outside every face
+	for (int v = 0; v < numVertices; ++v) {
+		if (newId[v] < 0) {
+			std::int32_t pred[3] = {last[0], last[1], last[2]};
+			emitVertex(v, pred);
+		}
+	}
+
+	_CodecHeader header;
+	std::memcpy(header.magic, _CODEC_MAGIC, sizeof(header.magic));
+	header.numVertices = numVertices;
+	header.numFaces = numFaces;
+	header.positionBits = positionBits;
+	header.normalBits = normalBits;
+	for (int k = 0; k < 3; ++k) {
+		header.bboxMin[k] = bboxMin[k];
+		header.bboxMax[k] = bboxMax[k];
+	}
+	header.numSymbols = symbols.mCount;
+	header.symbolBytes = symbols.numBytes();
+	header.refBytes = refsEnd - refs.get();
+	header.positionBytes = positionsEnd - positions.get();
+	header.normalBytes = normals.size() * sizeof(std::uint16_t);
+
+	std::vector< std::uint8_t > out(sizeof(header) + header.symbolBytes + header.refBytes
+	                                + header.positionBytes + header.normalBytes);
+	std::uint8_t* p = out.data();
+	std::memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, symbols.mBytes.data(), header.symbolBytes);
+	p += header.symbolBytes;
+	std::memcpy(p, refs.get(), header.refBytes);
+	p += header.refBytes;
+	std::memcpy(p, positions.get(), header.positionBytes);
+	p += header.positionBytes;
+	std::memcpy(p, normals.data(), header.normalBytes);
+	return out;
+}
+
+std::vector< std::uint8_t > encodeMesh(const Mesh& mesh, const MeshCodecOptions& options) {
+	MeshArrays arrays = meshArrays(mesh);
+	Eigen::Vector3f bboxMin = mesh.initBboxMin();
+	Eigen::Vector3f bboxMax = mesh.initBboxMax();
+	if (arrays.positions.rows() > 0) {
+		bboxMin = bboxMin.cwiseMin(arrays.positions.colwise().minCoeff().transpose());
+		bboxMax = bboxMax.cwiseMax(arrays.positions.colwise().maxCoeff().transpose());
+	}
+	return encodeMesh(arrays, bboxMin, bboxMax, options);
+}
+
+bool decodeMesh(const std::uint8_t* data, size_t size, MeshArrays& arrays) {
+	_CodecHeader header;
+	if (size < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, _CODEC_MAGIC, sizeof(header.magic)) != 0
+	    || size < sizeof(header) + size_t(header.symbolBytes) + header.refBytes + header.positionBytes + header.normalBytes
+	    || header.positionBits < 1 || header.positionBits > 30 || header.normalBits > 16) {
+		return false;
+	}
+	// Counts beyond what the streams can hold are malformed: every new
+	// vertex takes three position varints of at least a byte, and every
+	// face at least one of the four 2-bit symbols packed in a byte
+	if (std::uint64_t(header.numSymbols) > 4 * std::uint64_t(header.symbolBytes)
+	    || header.numVertices > header.positionBytes / 3 || header.numFaces > header.numSymbols
+	    || header.numVertices > INT_MAX / 3 || header.numFaces > INT_MAX / 3) {
+		return false;
+	}
+	const std::uint8_t* symbols = data + sizeof(header);
+	const std::uint8_t* refs = symbols + header.symbolBytes;
+	const std::uint8_t* refsEnd = refs + header.refBytes;
+	const std::uint8_t* positions = refsEnd;
+	const std::uint8_t* positionsEnd = positions + header.positionBytes;
+	const std::uint16_t* normals = reinterpret_cast< const std::uint16_t* >(positionsEnd);
+	int numVertices = header.numVertices;
+	int numFaces = header.numFaces;
+	int normalBits = header.normalBits;
+	if (normalBits && header.normalBytes != 4 * size_t(numVertices)) {
+		return false;
+	}
+
+	arrays.positions.resize(numVertices, 3);
+	arrays.normals.setZero(numVertices, 3);
+	arrays.faces.resize(numFaces, 3);
+	std::vector< std::int32_t > q(3 * numVertices);
+	float step[3];
+	for (int k = 0; k < 3; ++k) {
+		step[k] = (header.bboxMax[k] - header.bboxMin[k]) / float((1 << header.positionBits) - 1);
+	}
+
+	std::uint32_t symbolIndex = 0;
+	int nextId = 0;
+	std::int32_t last[3] = {0, 0, 0};
+	bool ok = true;
+	auto nextSymbol = [&]() {
+		if (symbolIndex >= header.numSymbols) {
+			ok = false;
+			return int(GATE_SKIP);
+		}
+		int symbol = (symbols[symbolIndex >> 2] >> (2 * (symbolIndex & 3))) & 3;
+		++symbolIndex;
+		return symbol;
+	};
+	// Read the vertex of a NEW or REF symbol
+	auto readVertex = [&](int symbol, const std::int32_t* pred) {
+		if (symbol == GATE_REF) {
+			std::uint32_t delta;
+			if (!_getVarint(refs, refsEnd, delta) || delta >= std::uint32_t(nextId)) {
+				ok = false;
+				return 0;
+			}
+			return nextId - 1 - int(delta);
+		}
+		if (symbol != GATE_NEW || nextId >= numVertices) {
+			ok = false;
+			return 0;
+		}
+		int v = nextId++;
+		for (int k = 0; k < 3; ++k) {
+			std::uint32_t residual;
+			if (!_getVarint(positions, positionsEnd, residual)) {
+				ok = false;
+				return 0;
+			}
+			q[3 * v + k] = pred[k] + _unzigzag(residual);
+			last[k] = q[3 * v + k];
+			arrays.positions(v, k) = header.bboxMin[k] + q[3 * v + k] * step[k];
+		}
+		if (normalBits) {
+			_decodeOctahedral(normals + 2 * v, normalBits, arrays.normals.row(v).data());
+		}
+		return v;
+	};
+
+	// Gates are a directed edge a -> b of a decoded face and its third vertex c
+	struct Gate {
+		int a;
+		int b;
+		int c;
+	};
+	std::vector< Gate > gates;
+	int f = 0;
+	while (f < numFaces && ok) {
+		int v[3];
+		for (int k = 0; k < 3; ++k) {
+			std::int32_t pred[3] = {last[0], last[1], last[2]};
+			v[k] = readVertex(nextSymbol(), pred);
+		}
+		arrays.faces.row(f++) << v[0], v[1], v[2];
+		gates.push_back(Gate{v[2], v[0], v[1]});
+		gates.push_back(Gate{v[1], v[2], v[0]});
+		gates.push_back(Gate{v[0], v[1], v[2]});
+		while (!gates.empty() && ok) {
+			Gate gate = gates.back();
+			gates.pop_back();
+			int symbol = nextSymbol();
+			if (symbol == GATE_SKIP) {
+				continue;
+			}
+			if (f >= numFaces) {
+				ok = false;
+				break;
+			}
+			std::int32_t pred[3];
+			if (symbol == GATE_NEW) {
+				for (int d = 0; d < 3; ++d) {
+					pred[d] = q[3 * gate.a + d] + q[3 * gate.b + d] - q[3 * gate.c + d];
+				}
+			}
+			int w = readVertex(symbol, pred);
+			arrays.faces.row(f++) << gate.b, gate.a, w;
+			gates.push_back(Gate{w, gate.b, gate.a});
+			gates.push_back(Gate{gate.a, w, gate.b});
+		}
+	}
+	while (nextId < numVertices && ok) {
+		std::int32_t pred[3] = {last[0], last[1], last[2]};
+		readVertex(nextSymbol(), pred);
+	}
+	return ok;
+}
+
+bool saveCompressedMesh(const Mesh& mesh, const std::string& filename, const MeshCodecOptions& options) {
+	std::vector< std::uint8_t > data = encodeMesh(mesh, options);
+	FILE* out = std::fopen(filename.c_str(), "wb");
+	if (!out) {
+		std::cout << __FUNCTION__ << ": cannot open " << filename << "\n";
+		return false;
+	}
+	bool ok = std::fwrite(data.data(), 1, data.size(), out) == data.size();
+	ok = std::fclose(out) == 0 && ok;
+	return ok;
+}
+
+bool loadCompressedMesh(const std::string& filename, MeshArrays& arrays) {
+	FILE* in = std::fopen(filename.c_str(), "rb");
+	if (!in) {
+		std::cout << __FUNCTION__ << ": cannot open " << filename << "\n";
+		return false;
+	}
+	std::fseek(in, 0, SEEK_END);
+	long size = std::ftell(in);
+	std::fseek(in, 0, SEEK_SET);
+	std::vector< std::uint8_t > data(size > 0 ? size : 0);
+	bool ok = std::fread(data.data(), 1, data.size(), in) == data.size();
+	std::fclose(in);
+	if (!ok || !decodeMesh(data.data(), data.size(), arrays)) {
+		std::cout << __FUNCTION__ << ": " << filename << " is not a valid compressed mesh\n";
+		return false;
+	}
+	return true;
+}
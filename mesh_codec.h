@@ -0,0 +1,52 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include "mesh_io.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Mesh;
+
+struct MeshCodecOptions {
+	// Bits per quantized coordinate, at most 30
+	int positionBits = 14;
+	// Bits per octahedral normal component, at most 16; 0 drops normals
+	int normalBits = 10;
+};
+
+/* Compact mesh encoding for archiving and shipping meshes between stages.
+ *
+ * Positions are quantized on a grid over the bounding box. Connectivity
+ * is an Edgebreaker-style depth-first traversal over the twin half-edges:
+ * every gate edge popped from the traversal stack is encoded as a 2-bit
+ * symbol, telling whether the face behind it was already reached (skip),
+ * brings a new vertex, or closes onto a visited vertex, whose id is then
+ * stored as a small backward delta. New vertices are predicted from the
+ * gate's triangle by the parallelogram rule and only the residual is
+ * stored. Normals are octahedral. Every stream is written with plain
+ * bytes and varints, without entropy coding, to keep both directions fast.
+ * The encoder still trails the decoder: on meshes too large for the cache
+ * its traversal jumps between faces in input order, and those random
+ * accesses, not the stream writing, bound it (see bench/codec_bench).
+ *
+ * Vertices come out of the decoder in traversal order, so vertex indices
+ * are not preserved; faces keep their orientation. */
+
+/* Encode with the bounding box the mesh was loaded with, grown to cover
+ * the current positions if they moved outside of it. */
+std::vector< std::uint8_t > encodeMesh(const Mesh& mesh, const MeshCodecOptions& options = MeshCodecOptions());
+std::vector< std::uint8_t > encodeMesh(const MeshArrays& arrays,
+                                       const Eigen::Vector3f& bboxMin,
+                                       const Eigen::Vector3f& bboxMax,
+                                       const MeshCodecOptions& options = MeshCodecOptions());
+
+/* Returns false on malformed input. Normals are zero when not encoded. */
+bool decodeMesh(const std::uint8_t* data, size_t size, MeshArrays& arrays);
+
+/* File wrappers, conventionally with the .mcmp extension. */
+bool saveCompressedMesh(const Mesh& mesh, const std::string& filename, const MeshCodecOptions& options = MeshCodecOptions());
+bool loadCompressedMesh(const std::string& filename, MeshArrays& arrays);
+
+#endif
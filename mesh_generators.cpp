@@ -0,0 +1,293 @@
+#include "mesh_generators.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+static const float PI = 3.14159265358979f;
+
+/* Seeded random numbers built from the raw engine output only, which the
+ * standard fixes, unlike the distributions. */
+class _Random {
+public:
+	_Random(unsigned seed) : mEngine(seed) {}
+	// Uniform in [0, 1) from the top 24 bits
+	float uniform() { return (mEngine() >> 8) * (1.0f / 16777216.0f); }
+	float symmetric() { return 2.0f * uniform() - 1.0f; }
+	// Box-Muller, one value per call to keep the draw count fixed
+	float gaussian() {
+		float u = 1.0f - uniform();
+		float v = uniform();
+		return std::sqrt(-2.0f * std::log(u)) * std::cos(2.0f * PI * v);
+	}
+	Eigen::Vector3f direction() {
+		Eigen::Vector3f d(gaussian(), gaussian(), gaussian());
+		float norm = d.norm();
+		return norm > 0.0f ? Eigen::Vector3f(d / norm) : Eigen::Vector3f::UnitZ();
+	}
+
+private:
+	std::mt19937 mEngine;
+};
+
+struct _Shape {
+	std::vector< Eigen::Vector3f > points;
+	std::vector< Eigen::Vector3f > normals;
+	std::vector< Eigen::Vector3i > faces;
+};
+
+/* Drop vertices no face refers to and copy into flat arrays. */
+static MeshArrays _toArrays(const _Shape& shape) {
+	int numPoints = shape.points.size();
+	int numFaces = shape.faces.size();
+	std::vector< int > remap(numPoints, -1);
+	for (const Eigen::Vector3i& f : shape.faces) {
+		for (int k = 0; k < 3; ++k) {
+			remap[f[k]] = 0;
+		}
+	}
+	int numVertices = 0;
+	for (int i = 0; i < numPoints; ++i) {
+		if (remap[i] == 0) {
+			remap[i] = numVertices++;
+		}
+	}
+
+	MeshArrays arrays;
+	arrays.positions.resize(numVertices, 3);
+	arrays.normals.resize(numVertices, 3);
+	arrays.faces.resize(numFaces, 3);
+	for (int i = 0; i < numPoints; ++i) {
+		if (remap[i] >= 0) {
+			arrays.positions.row(remap[i]) = shape.points[i].transpose();
+			arrays.normals.row(remap[i]) = shape.normals[i].transpose();
+		}
+	}
+	for (int f = 0; f < numFaces; ++f) {
+		for (int k = 0; k < 3; ++k) {
+			arrays.faces(f, k) = remap[shape.faces[f][k]];
+		}
+	}
+	return arrays;
+}
+
+static float _meanEdgeLength(const _Shape& shape) {
+	double sum = 0.0;
+	for (const Eigen::Vector3i& f : shape.faces) {
+		for (int k = 0; k < 3; ++k) {
+			sum += (shape.points[f[(k + 1) % 3]] - shape.points[f[k]]).norm();
+		}
+	}
+	return shape.faces.empty() ? 0.0f : float(sum / (3.0 * shape.faces.size()));
+}
+
+/* Move every point along its normal by amplitude times a random draw. */
+static void _displace(_Shape& shape, _Random& random, float amplitude, bool gaussian) {
+	if (amplitude == 0.0f) {
+		return;
+	}
+	for (size_t i = 0; i < shape.points.size(); ++i) {
+		float t = gaussian ? random.gaussian() : random.symmetric();
+		shape.points[i] += amplitude * t * shape.normals[i];
+	}
+}
+
+static _Shape _icosphere(int subdivisions) {
+	const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	_Shape shape;
+	shape.points = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+	                {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+	                {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+	shape.faces = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+	               {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+	               {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+	               {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+	for (Eigen::Vector3f& p : shape.points) {
+		p.normalize();
+	}
+
+	// Split every edge once, sharing midpoints between the two faces
+	for (int level = 0; level < subdivisions; ++level) {
+		std::unordered_map< std::uint64_t, int > midpoints;
+		midpoints.reserve(shape.faces.size() * 3 / 2);
+		auto midpoint = [&](int a, int b) {
+			std::uint64_t key = (std::uint64_t(std::min(a, b)) << 32) | std::uint32_t(std::max(a, b));
+			auto found = midpoints.find(key);
+			if (found != midpoints.end()) {
+				return found->second;
+			}
+			int index = shape.points.size();
+			shape.points.push_back((shape.points[a] + shape.points[b]).normalized());
+			midpoints.emplace(key, index);
+			return index;
+		};
+		std::vector< Eigen::Vector3i > faces;
+		faces.reserve(4 * shape.faces.size());
+		for (const Eigen::Vector3i& f : shape.faces) {
+			int ab = midpoint(f[0], f[1]);
+			int bc = midpoint(f[1], f[2]);
+			int ca = midpoint(f[2], f[0]);
+			faces.emplace_back(f[0], ab, ca);
+			faces.emplace_back(f[1], bc, ab);
+			faces.emplace_back(f[2], ca, bc);
+			faces.emplace_back(ab, bc, ca);
+		}
+		shape.faces.swap(faces);
+	}
+	shape.normals = shape.points;
+	return shape;
+}
+
+MeshArrays generateIcosphere(int subdivisions, const GeneratorOptions& options) {
+	_Shape shape = _icosphere(std::max(0, subdivisions));
+	_Random random(options.seed);
+	_displace(shape, random, options.noise * _meanEdgeLength(shape), false);
+	return _toArrays(shape);
+}
+
+MeshArrays generateGridPatch(int resolution, int holes, const GeneratorOptions& options) {
+	int n = std::max(2, resolution);
+	int quads = n - 1;
+	_Shape shape;
+	shape.points.reserve(n * n);
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			shape.points.emplace_back(x / float(quads), y / float(quads), 0.0f);
+		}
+	}
+	shape.normals.assign(shape.points.size(), Eigen::Vector3f::UnitZ());
+
+	// Holes go to the centers of a cells x cells layout; each cell needs
+	// a quad of margin on every side of its hole
+	int cells = std::max(1, int(std::ceil(std::sqrt(double(std::max(0, holes))))));
+	int cellSize = quads / cells;
+	int holeSize = std::max(1, cellSize / 3);
+	if (cellSize < 3) {
+		holes = 0;
+	}
+	std::vector< char > removed(quads * quads, 0);
+	for (int h = 0; h < holes; ++h) {
+		int x0 = (h % cells) * cellSize + (cellSize - holeSize) / 2;
+		int y0 = (h / cells) * cellSize + (cellSize - holeSize) / 2;
+		for (int y = y0; y < y0 + holeSize; ++y) {
+			for (int x = x0; x < x0 + holeSize; ++x) {
+				removed[y * quads + x] = 1;
+			}
+		}
+	}
+
+	shape.faces.reserve(2 * quads * quads);
+	for (int y = 0; y < quads; ++y) {
+		for (int x = 0; x < quads; ++x) {
+			if (removed[y * quads + x]) {
+				continue;
+			}
+			int a = y * n + x;
+			int b = a + n;
+			shape.faces.emplace_back(a, a + 1, b);
+			shape.faces.emplace_back(a + 1, b + 1, b);
+		}
+	}
+	_Random random(options.seed);
+	_displace(shape, random, options.noise / quads, false);
+	return _toArrays(shape);
+}
+
+MeshArrays generateTorus(int majorSegments, int minorSegments, float minorRadius, const GeneratorOptions& options) {
+	int major = std::max(3, majorSegments);
+	int minor = std::max(3, minorSegments);
+	_Shape shape;
+	shape.points.reserve(major * minor);
+	shape.normals.reserve(major * minor);
+	for (int i = 0; i < major; ++i) {
+		float theta = 2.0f * PI * i / major;
+		for (int j = 0; j < minor; ++j) {
+			float phi = 2.0f * PI * j / minor;
+			Eigen::Vector3f normal(std::cos(phi) * std::cos(theta), std::cos(phi) * std::sin(theta), std::sin(phi));
+			shape.points.push_back(Eigen::Vector3f(std::cos(theta), std::sin(theta), 0.0f) + minorRadius * normal);
+			shape.normals.push_back(normal);
+		}
+	}
+	// Going around the major circle, then the minor one, faces outward
+	shape.faces.reserve(2 * major * minor);
+	for (int i = 0; i < major; ++i) {
+		for (int j = 0; j < minor; ++j) {
+			int a = i * minor + j;
+			int b = ((i + 1) % major) * minor + j;
+			int c = i * minor + (j + 1) % minor;
+			int d = ((i + 1) % major) * minor + (j + 1) % minor;
+			shape.faces.emplace_back(a, b, d);
+			shape.faces.emplace_back(a, d, c);
+		}
+	}
+	_Random random(options.seed);
+	_displace(shape, random, options.noise * _meanEdgeLength(shape), false);
+	return _toArrays(shape);
+}
+
+MeshArrays generateScanSphere(int subdivisions, int holes, const GeneratorOptions& options) {
+	_Shape shape = _icosphere(std::max(0, subdivisions));
+	_Random random(options.seed);
+	float h = _meanEdgeLength(shape);
+
+	// Cap centers far enough apart that holes never merge; the caps
+	// shrink as more are asked for and holes that find no room are dropped
+	std::vector< Eigen::Vector3f > centers;
+	float radius = std::max(2.0f * h, 0.3f / std::sqrt(float(std::max(1, holes))));
+	float separation = std::cos(std::min(PI, 2.0f * radius + 4.0f * h));
+	for (int attempt = 0; (int)centers.size() < holes && attempt < 100 * holes; ++attempt) {
+		Eigen::Vector3f c = random.direction();
+		bool apart = true;
+		for (const Eigen::Vector3f& other : centers) {
+			apart = apart && c.dot(other) < separation;
+		}
+		if (apart) {
+			centers.push_back(c);
+		}
+	}
+	if (!centers.empty()) {
+		float inside = std::cos(radius);
+		std::vector< char > seen(shape.points.size(), 0);
+		for (size_t i = 0; i < shape.points.size(); ++i) {
+			for (const Eigen::Vector3f& c : centers) {
+				seen[i] = seen[i] || shape.points[i].dot(c) > inside;
+			}
+		}
+		std::vector< Eigen::Vector3i > faces;
+		faces.reserve(shape.faces.size());
+		for (const Eigen::Vector3i& f : shape.faces) {
+			if (!seen[f[0]] && !seen[f[1]] && !seen[f[2]]) {
+				faces.push_back(f);
+			}
+		}
+		shape.faces.swap(faces);
+	}
+
+	// Slide points in the tangent plane, then back onto the sphere
+	for (Eigen::Vector3f& p : shape.points) {
+		Eigen::Vector3f offset = random.direction();
+		offset -= offset.dot(p) * p;
+		p = (p + 0.25f * h * random.uniform() * offset).normalized();
+	}
+	shape.normals = shape.points;
+	_displace(shape, random, options.noise * h, true);
+	return _toArrays(shape);
+}
+
+int icosphereSubdivisionsFor(int faces) {
+	int subdivisions = 0;
+	while (20LL << (2 * subdivisions) < faces) {
+		++subdivisions;
+	}
+	return subdivisions;
+}
+
+int gridResolutionFor(int faces) {
+	int resolution = std::max(2, int(std::sqrt(std::max(0, faces) / 2.0)) + 1);
+	while (2LL * (resolution - 1) * (resolution - 1) < faces) {
+		++resolution;
+	}
+	return resolution;
+}
@@ -0,0 +1,48 @@
+#ifndef MESH_GENERATORS_H
+#define MESH_GENERATORS_H
+
+#include "mesh_io.h"
+
+/* Procedural test meshes, so benchmarks and tests can scale to any size
+ * without shipping assets. Every random choice comes from a Mersenne
+ * Twister seeded with GeneratorOptions::seed and is turned into floats by
+ * hand rather than through <random> distributions, whose output differs
+ * between standard libraries, so equal seeds give the same mesh
+ * everywhere. Normals are the analytic ones of the underlying shape,
+ * before noise. Load a result into the half-edge structure with
+ * loadMeshArrays. */
+
+struct GeneratorOptions {
+	unsigned seed = 1;
+	// Displacement along the normal, relative to the mean edge length:
+	// uniform in [-noise, noise], Gaussian sigma for generateScanSphere
+	float noise = 0.0f;
+};
+
+/* Unit sphere from a subdivided icosahedron: 20 * 4^subdivisions faces,
+ * 10 * 4^subdivisions + 2 vertices, all of valence 6 but twelve of 5. */
+MeshArrays generateIcosphere(int subdivisions, const GeneratorOptions& options = GeneratorOptions());
+
+/* Unit square in the xy-plane, resolution x resolution vertices and
+ * 2 (resolution - 1)^2 faces before holes. Square holes are cut on a
+ * regular layout, away from each other and from the border, so the patch
+ * has exactly 1 + holes boundary loops; holes that do not fit are dropped. */
+MeshArrays generateGridPatch(int resolution, int holes = 0, const GeneratorOptions& options = GeneratorOptions());
+
+/* Closed genus-1 torus around the z-axis with major radius 1:
+ * majorSegments * minorSegments vertices, twice as many faces. */
+MeshArrays generateTorus(int majorSegments,
+                         int minorSegments,
+                         float minorRadius = 0.3f,
+                         const GeneratorOptions& options = GeneratorOptions());
+
+/* Scan-like unit sphere: an icosphere with tangential jitter, so edges
+ * and valences look irregular, Gaussian noise along the normal and
+ * roughly circular holes where the scanner saw nothing. */
+MeshArrays generateScanSphere(int subdivisions, int holes = 0, const GeneratorOptions& options = GeneratorOptions());
+
+/* Smallest size parameter reaching at least the given face count. */
+int icosphereSubdivisionsFor(int faces);
+int gridResolutionFor(int faces);
+
+#endif
@@ -0,0 +1,325 @@
+#include "mesh_io.h"
+#include "mesh.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static const int BLOCK_SIZE = 16384;
+
+MeshArrays meshArrays(const Mesh& mesh) {
+	TRACE_SCOPE("meshArrays");
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	const std::vector< Face* >& faces = mesh.faces();
+	int numVertices = vertices.size();
+	int numFaces = faces.size();
+	MeshArrays arrays;
+	arrays.positions.resize(numVertices, 3);
+	arrays.normals.resize(numVertices, 3);
+	arrays.faces.resize(numFaces, 3);
+
+	int numVertexBlocks = (numVertices + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int numFaceBlocks = (numFaces + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	ThreadPool::global().parallelFor(numVertexBlocks + numFaceBlocks, [&](int block) {
+		if (block < numVertexBlocks) {
+			int end = std::min(numVertices, (block + 1) * BLOCK_SIZE);
+			for (int i = block * BLOCK_SIZE; i < end; ++i) {
+				arrays.positions.row(i) = vertices[i]->position().transpose();
+				arrays.normals.row(i) = vertices[i]->normal().transpose();
+			}
+		} else {
+			block -= numVertexBlocks;
+			int end = std::min(numFaces, (block + 1) * BLOCK_SIZE);
+			for (int f = block * BLOCK_SIZE; f < end; ++f) {
+				const HEdge* h = faces[f]->halfEdge();
+				for (int k = 0; k < 3; ++k) {
+					arrays.faces(f, k) = h->start()->index();
+					h = h->next();
+				}
+			}
+		}
+	});
+	return arrays;
+}
+
+/* Create a new, empty file with the given extension in the system
+ * temporary directory and return its name, or "" on failure. The file
+ * is created exclusively and readable by the owner only, so no other
+ * user can plant a file or link under the name beforehand. */
+static std::string _temporaryFile(const char* extension) {
+	const char* directory = std::getenv("TMPDIR");
+	directory = directory ? directory : std::getenv("TEMP");
+#ifdef _WIN32
+	directory = directory ? directory : ".";
+	// A taken name, ours from another call or anybody else's, is skipped
+	static std::atomic< int > counter(0);
+	for (int attempt = 0; attempt < 100; ++attempt) {
+		std::string filename = std::string(directory) + "/mesh_" + std::to_string(getpid()) + "_"
+		                       + std::to_string(counter++) + extension;
+		int fd = _open(filename.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE);
+		if (fd >= 0) {
+			_close(fd);
+			return filename;
+		}
+	}
+	return std::string();
+#else
+	directory = directory ? directory : "/tmp";
+	std::string pattern = std::string(directory) + "/mesh_XXXXXX" + extension;
+	std::vector< char > filename(pattern.begin(), pattern.end());
+	filename.push_back('\0');
+	int fd = mkstemps(filename.data(), std::strlen(extension));
+	if (fd < 0) {
+		return std::string();
+	}
+	close(fd);
+	return filename.data();
+#endif
+}
+
+bool loadMeshArrays(Mesh& mesh, const MeshArrays& arrays) {
+	// Mesh::addFace is private, so the arrays take the loadMeshFile path
+	MeshSaveOptions options;
+	options.format = MESH_FORMAT_PLY;
+	options.normals = false;
+	std::string filename = _temporaryFile(".ply");
+	if (filename.empty()) {
+		std::cout << __FUNCTION__ << ": cannot create a temporary file\n";
+		return false;
+	}
+	bool ok = saveMesh(arrays, filename, options) && mesh.loadMeshFile(filename);
+	std::remove(filename.c_str());
+	return ok;
+}
+
+static MeshFormat _formatOf(const std::string& filename, MeshFormat format) {
+	if (format != MESH_FORMAT_AUTO) {
+		return format;
+	}
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == "ply") {
+		return MESH_FORMAT_PLY;
+	}
+	if (extension == "obj") {
+		return MESH_FORMAT_OBJ;
+	}
+	if (extension == "mbin") {
+		return MESH_FORMAT_NATIVE;
+	}
+	return MESH_FORMAT_AUTO;
+}
+
+/* Append the decimal digits of a non-negative integer. */
+static void _appendInt(std::string& out, int value) {
+	char digits[12];
+	int count = 0;
+	do {
+		digits[count++] = char('0' + value % 10);
+		value /= 10;
+	} while (value);
+	while (count) {
+		out.push_back(digits[--count]);
+	}
+}
+
+/* Format blocks of lines in parallel and write them out in order. Only a
+ * few blocks per thread are held at a time. */
+static bool _writeBlocks(FILE* out, int numLines, const std::function< void(int, int, std::string&) >& format) {
+	ThreadPool& pool = ThreadPool::global();
+	int numBlocks = (numLines + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int batch = 2 * (pool.size() + 1);
+	std::vector< std::string > texts(batch);
+	for (int first = 0; first < numBlocks; first += batch) {
+		int count = std::min(batch, numBlocks - first);
+		pool.parallelFor(count, [&](int k) {
+			int block = first + k;
+			texts[k].clear();
+			format(block * BLOCK_SIZE, std::min(numLines, (block + 1) * BLOCK_SIZE), texts[k]);
+		});
+		for (int k = 0; k < count; ++k) {
+			if (std::fwrite(texts[k].data(), 1, texts[k].size(), out) != texts[k].size()) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool _saveObj(FILE* out, const MeshArrays& arrays, const MeshSaveOptions& options) {
+	int precision = options.precision;
+	bool normals = options.normals;
+	auto formatVertices = [&](const VertexMatrix& values, const char* tag, int begin, int end, std::string& text) {
+		char line[128];
+		text.reserve(text.size() + (end - begin) * (4 + 3 * (precision + 7)));
+		for (int i = begin; i < end; ++i) {
+			int length = std::snprintf(line, sizeof(line), "%s %.*g %.*g %.*g\n", tag,
+			                           precision, values(i, 0), precision, values(i, 1), precision, values(i, 2));
+			text.append(line, length);
+		}
+	};
+
+	std::fprintf(out, "# %d vertices, %d faces\n", (int)arrays.positions.rows(), (int)arrays.faces.rows());
+	bool ok = _writeBlocks(out, arrays.positions.rows(), [&](int begin, int end, std::string& text) {
+		formatVertices(arrays.positions, "v", begin, end, text);
+	});
+	if (ok && normals) {
+		ok = _writeBlocks(out, arrays.normals.rows(), [&](int begin, int end, std::string& text) {
+			formatVertices(arrays.normals, "vn", begin, end, text);
+		});
+	}
+	if (ok) {
+		ok = _writeBlocks(out, arrays.faces.rows(), [&](int begin, int end, std::string& text) {
+			text.reserve(text.size() + (end - begin) * 40);
+			for (int f = begin; f < end; ++f) {
+				text.push_back('f');
+				for (int k = 0; k < 3; ++k) {
+					int index = arrays.faces(f, k) + 1;
+					text.push_back(' ');
+					_appendInt(text, index);
+					if (normals) {
+						text.append("//");
+						_appendInt(text, index);
+					}
+				}
+				text.push_back('\n');
+			}
+		});
+	}
+	return ok;
+}
+
+static bool _isLittleEndian() {
+	std::uint16_t probe = 1;
+	return *reinterpret_cast< std::uint8_t* >(&probe) == 1;
+}
+
+static bool _savePly(FILE* out, const MeshArrays& arrays, const MeshSaveOptions& options) {
+	int numVertices = arrays.positions.rows();
+	int numFaces = arrays.faces.rows();
+	bool normals = options.normals;
+	std::fprintf(out,
+	             "ply\nformat binary_%s_endian 1.0\nelement vertex %d\n"
+	             "property float x\nproperty float y\nproperty float z\n",
+	             _isLittleEndian() ? "little" : "big", numVertices);
+	if (normals) {
+		std::fprintf(out, "property float nx\nproperty float ny\nproperty float nz\n");
+	}
+	std::fprintf(out, "element face %d\nproperty list uchar int vertex_indices\nend_header\n", numFaces);
+
+	// Interleave in parallel blocks, the layout PLY wants per element
+	bool ok = _writeBlocks(out, numVertices, [&](int begin, int end, std::string& text) {
+		int stride = normals ? 6 : 3;
+		text.resize((end - begin) * stride * sizeof(float));
+		float* data = reinterpret_cast< float* >(&text[0]);
+		for (int i = begin; i < end; ++i, data += stride) {
+			std::memcpy(data, arrays.positions.row(i).data(), 3 * sizeof(float));
+			if (normals) {
+				std::memcpy(data + 3, arrays.normals.row(i).data(), 3 * sizeof(float));
+			}
+		}
+	});
+	if (ok) {
+		ok = _writeBlocks(out, numFaces, [&](int begin, int end, std::string& text) {
+			const int record = 1 + 3 * sizeof(int);
+			text.resize((end - begin) * record);
+			char* data = &text[0];
+			for (int f = begin; f < end; ++f, data += record) {
+				data[0] = 3;
+				std::memcpy(data + 1, arrays.faces.row(f).data(), 3 * sizeof(int));
+			}
+		});
+	}
+	return ok;
+}
+
+/* Header of the native .mbin format, followed by the positions, the
+ * normals when flagged and the faces, all in host byte order. */
+struct _NativeHeader {
+	char magic[8];
+	std::int32_t numVertices;
+	std::int32_t numFaces;
+	std::int32_t hasNormals;
+	std::int32_t reserved;
+};
+
+static bool _saveNative(FILE* out, const MeshArrays& arrays, const MeshSaveOptions& options) {
+	_NativeHeader header;
+	std::memcpy(header.magic, "MESHBIN1", 8);
+	header.numVertices = arrays.positions.rows();
+	header.numFaces = arrays.faces.rows();
+	header.hasNormals = options.normals ? 1 : 0;
+	header.reserved = 0;
+	size_t vertexFloats = 3 * size_t(header.numVertices);
+	size_t faceInts = 3 * size_t(header.numFaces);
+	return std::fwrite(&header, sizeof(header), 1, out) == 1
+	       && std::fwrite(arrays.positions.data(), sizeof(float), vertexFloats, out) == vertexFloats
+	       && (!options.normals || std::fwrite(arrays.normals.data(), sizeof(float), vertexFloats, out) == vertexFloats)
+	       && std::fwrite(arrays.faces.data(), sizeof(int), faceInts, out) == faceInts;
+}
+
+bool saveMesh(const MeshArrays& arrays, const std::string& filename, const MeshSaveOptions& options) {
+	TRACE_SCOPE("saveMesh");
+	MeshFormat format = _formatOf(filename, options.format);
+	if (format == MESH_FORMAT_AUTO) {
+		std::cout << __FUNCTION__ << ": unknown mesh format of " << filename << "\n";
+		return false;
+	}
+	FILE* out = std::fopen(filename.c_str(), "wb");
+	if (!out) {
+		std::cout << __FUNCTION__ << ": cannot open " << filename << "\n";
+		return false;
+	}
+	// Large buffer, the blocks are written whole anyway
+	std::setvbuf(out, nullptr, _IOFBF, 1 << 20);
+	bool ok = false;
+	if (format == MESH_FORMAT_PLY) {
+		ok = _savePly(out, arrays, options);
+	} else if (format == MESH_FORMAT_OBJ) {
+		ok = _saveObj(out, arrays, options);
+	} else {
+		ok = _saveNative(out, arrays, options);
+	}
+	ok = std::fclose(out) == 0 && ok;
+	if (!ok) {
+		std::cout << __FUNCTION__ << ": writing " << filename << " failed\n";
+	}
+	return ok;
+}
+
+bool saveMesh(const Mesh& mesh, const std::string& filename, const MeshSaveOptions& options) {
+	return saveMesh(meshArrays(mesh), filename, options);
+}
+
+/* One writer thread keeps asynchronous saves in submission order. */
+static ThreadPool& _writer() {
+	static ThreadPool writer(1);
+	return writer;
+}
+
+std::future< bool > saveMeshAsync(const Mesh& mesh, const std::string& filename, const MeshSaveOptions& options) {
+	auto arrays = std::make_shared< MeshArrays >(meshArrays(mesh));
+	auto result = std::make_shared< std::promise< bool > >();
+	std::future< bool > future = result->get_future();
+	_writer().submit([arrays, result, filename, options]() {
+		result->set_value(saveMesh(*arrays, filename, options));
+	});
+	return future;
+}
@@ -0,0 +1,57 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include "spmv.h"
+#include <Eigen/Core>
+#include <future>
+#include <string>
+
+class Mesh;
+
+typedef Eigen::Matrix< int, Eigen::Dynamic, 3, Eigen::RowMajor > FaceMatrix;
+
+/* Flat copy of a mesh: xyz and normal per vertex, three vertex indices
+ * per face. This is what the writers consume, and taking it is the only
+ * part of an asynchronous save that touches the mesh. */
+struct MeshArrays {
+	VertexMatrix positions;
+	VertexMatrix normals;
+	FaceMatrix faces;
+};
+
+/* Gather the arrays in parallel. Vertex indices are Vertex::index. */
+MeshArrays meshArrays(const Mesh& mesh);
+
+/* Replace the mesh with the given positions and faces, building the
+ * half-edge structure as loadMeshFile does; normals are not taken over.
+ * Goes through a temporary binary PLY file. */
+bool loadMeshArrays(Mesh& mesh, const MeshArrays& arrays);
+
+enum MeshFormat {
+	MESH_FORMAT_AUTO,   // from the file extension: .ply, .obj or .mbin
+	MESH_FORMAT_PLY,    // binary little-endian PLY
+	MESH_FORMAT_OBJ,    // Wavefront OBJ text
+	MESH_FORMAT_NATIVE  // .mbin, the arrays as they are in memory
+};
+
+struct MeshSaveOptions {
+	MeshFormat format = MESH_FORMAT_AUTO;
+	bool normals = true;
+	// Significant digits of OBJ coordinates; 9 round-trips a float
+	int precision = 9;
+};
+
+/* Write a mesh. OBJ text is formatted in parallel blocks on the thread
+ * pool and streamed to the file in order, so memory stays bounded.
+ * Returns false and prints the reason on failure. */
+bool saveMesh(const Mesh& mesh, const std::string& filename, const MeshSaveOptions& options = MeshSaveOptions());
+bool saveMesh(const MeshArrays& arrays, const std::string& filename, const MeshSaveOptions& options = MeshSaveOptions());
+
+/* Snapshot the mesh on the calling thread and write it on a background
+ * writer thread, so the caller can go on with the next job. Writes are
+ * serialized in submission order. */
+std::future< bool > saveMeshAsync(const Mesh& mesh,
+                                  const std::string& filename,
+                                  const MeshSaveOptions& options = MeshSaveOptions());
+
+#endif
@@ -0,0 +1,231 @@
+#include "mesh_python.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const int BLOCK_SIZE = 16384;
+
+/* The buffers the NumPy views alias, one set per load. */
+struct _Storage {
+	MeshArrays arrays;
+	VertexMatrix colors;
+};
+
+/* One reference handed out by meshPyAcquireBuffers. */
+struct MeshPyBuffers {
+	std::shared_ptr< _Storage > storage;
+};
+
+struct MeshPy {
+	mutable std::mutex mutex;
+	std::unique_ptr< ResidentMesh > resident;
+	// Replaced, never resized, by meshPyLoad; views may still hold the old one
+	std::shared_ptr< _Storage > storage;
+	std::string error;
+};
+
+/* Write positions and normals back into the buffers in place, so the
+ * views see the result of a kernel. */
+static void _pull(MeshPy& handle) {
+	TRACE_SCOPE("meshPyPull");
+	const std::vector< Vertex* >& vertices = handle.resident->mesh->vertices();
+	MeshArrays& arrays = handle.storage->arrays;
+	int numVertices = vertices.size();
+	int numBlocks = (numVertices + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	ThreadPool::global().parallelFor(numBlocks, [&](int block) {
+		int end = std::min(numVertices, (block + 1) * BLOCK_SIZE);
+		for (int i = block * BLOCK_SIZE; i < end; ++i) {
+			arrays.positions.row(i) = vertices[i]->position().transpose();
+			arrays.normals.row(i) = vertices[i]->normal().transpose();
+		}
+	});
+}
+
+/* Copy the positions and colors changed through the views into the mesh.
+ * Every vertex is compared, but only changed ones are written, so an
+ * untouched buffer does not bump the geometry revision and invalidate
+ * cached Laplacians. */
+static void _push(MeshPy& handle) {
+	TRACE_SCOPE("meshPyPush");
+	Mesh& mesh = *handle.resident->mesh;
+	const MeshArrays& arrays = handle.storage->arrays;
+	const VertexMatrix& colors = handle.storage->colors;
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int numVertices = vertices.size();
+	int numBlocks = (numVertices + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	std::atomic< bool > moved(false);
+	std::atomic< bool > recolored(false);
+	ThreadPool::global().parallelFor(numBlocks, [&](int block) {
+		int end = std::min(numVertices, (block + 1) * BLOCK_SIZE);
+		bool blockMoved = false;
+		bool blockRecolored = false;
+		for (int i = block * BLOCK_SIZE; i < end; ++i) {
+			Eigen::Vector3f position = arrays.positions.row(i).transpose();
+			if (position != vertices[i]->position()) {
+				vertices[i]->setPosition(position);
+				blockMoved = true;
+			}
+			Eigen::Vector3f color = colors.row(i).transpose();
+			if (color != vertices[i]->color()) {
+				vertices[i]->setColor(color);
+				blockRecolored = true;
+			}
+		}
+		if (blockMoved) {
+			moved = true;
+		}
+		if (blockRecolored) {
+			recolored = true;
+		}
+	});
+	if (moved) {
+		mesh.computeVertexNormals();
+		mesh.setVertexPosDirty(true);
+		_pull(handle);
+	}
+	if (recolored) {
+		mesh.setVertexColorDirty(true);
+	}
+}
+
+/* Check that a mesh is loaded; called with the handle locked. */
+static bool _loaded(MeshPy* handle) {
+	if (!handle->resident) {
+		handle->error = "no mesh loaded";
+		return false;
+	}
+	return true;
+}
+
+MeshPy* meshPyCreate() {
+	return new MeshPy;
+}
+
+void meshPyDestroy(MeshPy* handle) {
+	delete handle;
+}
+
+const char* meshPyError(const MeshPy* handle) {
+	return handle->error.c_str();
+}
+
+int meshPyLoad(MeshPy* handle, const char* filename) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	std::unique_ptr< ResidentMesh > resident(new ResidentMesh);
+	if (!loadResidentMesh(*resident, filename)) {
+		handle->error = std::string("cannot load ") + filename;
+		return 0;
+	}
+	std::shared_ptr< _Storage > storage = std::make_shared< _Storage >();
+	storage->arrays = meshArrays(*resident->mesh);
+	const std::vector< Vertex* >& vertices = resident->mesh->vertices();
+	storage->colors.resize(vertices.size(), 3);
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		storage->colors.row(i) = vertices[i]->color().transpose();
+	}
+	handle->resident = std::move(resident);
+	handle->storage = storage;
+	return 1;
+}
+
+int meshPyNumVertices(const MeshPy* handle) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	return handle->storage ? handle->storage->arrays.positions.rows() : 0;
+}
+
+int meshPyNumFaces(const MeshPy* handle) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	return handle->storage ? handle->storage->arrays.faces.rows() : 0;
+}
+
+MeshPyBuffers* meshPyAcquireBuffers(MeshPy* handle) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	if (!handle->storage) {
+		return nullptr;
+	}
+	MeshPyBuffers* buffers = new MeshPyBuffers;
+	buffers->storage = handle->storage;
+	return buffers;
+}
+
+void meshPyReleaseBuffers(MeshPyBuffers* buffers) {
+	delete buffers;
+}
+
+int meshPyBuffersNumVertices(const MeshPyBuffers* buffers) {
+	return buffers->storage->arrays.positions.rows();
+}
+
+int meshPyBuffersNumFaces(const MeshPyBuffers* buffers) {
+	return buffers->storage->arrays.faces.rows();
+}
+
+float* meshPyPositions(MeshPyBuffers* buffers) {
+	return buffers->storage->arrays.positions.data();
+}
+
+float* meshPyNormals(MeshPyBuffers* buffers) {
+	return buffers->storage->arrays.normals.data();
+}
+
+float* meshPyColors(MeshPyBuffers* buffers) {
+	return buffers->storage->colors.data();
+}
+
+int* meshPyFaces(MeshPyBuffers* buffers) {
+	return buffers->storage->arrays.faces.data();
+}
+
+int meshPyCommit(MeshPy* handle) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	if (!_loaded(handle)) {
+		return 0;
+	}
+	_push(*handle);
+	return 1;
+}
+
+int meshPySmooth(MeshPy* handle, const SmoothRequest* request, const int* pinned, int numPinned, SmoothReply* reply) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	if (!_loaded(handle)) {
+		return 0;
+	}
+	_push(*handle);
+	SmoothReply local;
+	std::vector< int > pins(pinned, pinned + std::max(0, numPinned));
+	if (!smoothResidentMesh(*handle->resident, *request, pins, reply ? *reply : local, handle->error)) {
+		return 0;
+	}
+	_pull(*handle);
+	return 1;
+}
+
+int meshPyStats(MeshPy* handle, MeshServiceInfo* info) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	if (!_loaded(handle)) {
+		return 0;
+	}
+	_push(*handle);
+	*info = residentMeshInfo(*handle->resident);
+	const _Storage& storage = *handle->storage;
+	info->cacheBytes += storage.colors.size() * sizeof(float) + storage.arrays.positions.size() * sizeof(float)
+	                    + storage.arrays.normals.size() * sizeof(float) + storage.arrays.faces.size() * sizeof(int);
+	return 1;
+}
+
+int meshPyReset(MeshPy* handle) {
+	std::lock_guard< std::mutex > lock(handle->mutex);
+	if (!_loaded(handle)) {
+		return 0;
+	}
+	resetResidentMesh(*handle->resident);
+	_pull(*handle);
+	return 1;
+}
@@ -0,0 +1,78 @@
+#ifndef MESH_PYTHON_H
+#define MESH_PYTHON_H
+
+#include "mesh_service.h"
+
+/* C interface behind the Python bindings in python/mesh_numpy.py, which
+ * load it with ctypes from a shared library built from the mesh sources.
+ *
+ * Mesh keeps its attributes inside the Vertex objects, so they cannot be
+ * aliased directly. Instead every load allocates contiguous row-major
+ * buffers: float xyz positions, normals and rgb colors per vertex and
+ * int vertex indices per face. NumPy views alias these buffers through a
+ * reference taken with meshPyAcquireBuffers. The buffers are refcounted:
+ * a later meshPyLoad or meshPyDestroy detaches them from the mesh but
+ * frees them only when the last reference is released, so a stale view
+ * reads the old data instead of freed memory.
+ *
+ * Data flows both ways through the buffers, and each way costs a pass
+ * over every vertex:
+ * - After every kernel, positions and normals of all vertices are copied
+ *   from the Vertex objects into the buffers, 24 bytes per vertex.
+ * - Before every smoothing, stats or meshPyCommit call, positions and
+ *   colors in the buffers are compared with those of every Vertex, and
+ *   the ones that differ are copied into the mesh.
+ *
+ * Calls on one handle are serialized. ctypes releases the GIL around
+ * every call, so smoothing runs while other Python threads continue.
+ * Functions returning int return 1 on success and 0 on failure, with the
+ * reason in meshPyError. */
+
+#ifdef _WIN32
+#define MESH_PY_API extern "C" __declspec(dllexport)
+#else
+#define MESH_PY_API extern "C" __attribute__((visibility("default")))
+#endif
+
+struct MeshPy;
+struct MeshPyBuffers;
+
+MESH_PY_API MeshPy* meshPyCreate();
+MESH_PY_API void meshPyDestroy(MeshPy* handle);
+MESH_PY_API const char* meshPyError(const MeshPy* handle);
+
+/* Load a mesh file into fresh buffers, detaching the previous ones. */
+MESH_PY_API int meshPyLoad(MeshPy* handle, const char* filename);
+MESH_PY_API int meshPyNumVertices(const MeshPy* handle);
+MESH_PY_API int meshPyNumFaces(const MeshPy* handle);
+
+/* A new reference to the buffers of the loaded mesh, null if none is
+ * loaded; every reference is released with meshPyReleaseBuffers. */
+MESH_PY_API MeshPyBuffers* meshPyAcquireBuffers(MeshPy* handle);
+MESH_PY_API void meshPyReleaseBuffers(MeshPyBuffers* buffers);
+/* The rows of the buffers, which outlive a reload of their mesh. */
+MESH_PY_API int meshPyBuffersNumVertices(const MeshPyBuffers* buffers);
+MESH_PY_API int meshPyBuffersNumFaces(const MeshPyBuffers* buffers);
+
+/* The buffers: numVertices x 3 floats, or numFaces x 3 ints for faces. */
+MESH_PY_API float* meshPyPositions(MeshPyBuffers* buffers);
+MESH_PY_API float* meshPyNormals(MeshPyBuffers* buffers);
+MESH_PY_API float* meshPyColors(MeshPyBuffers* buffers);
+MESH_PY_API int* meshPyFaces(MeshPyBuffers* buffers);
+
+/* Copy changed positions and colors from the buffers into the mesh and
+ * recompute normals if any position changed. */
+MESH_PY_API int meshPyCommit(MeshPy* handle);
+/* Run one smoothing request, as the mesh service does (see
+ * SmoothRequest); pinned may be null when numPinned is 0. reply may be
+ * null. */
+MESH_PY_API int meshPySmooth(MeshPy* handle,
+                             const SmoothRequest* request,
+                             const int* pinned,
+                             int numPinned,
+                             SmoothReply* reply);
+MESH_PY_API int meshPyStats(MeshPy* handle, MeshServiceInfo* info);
+/* Restore the positions the mesh was loaded with. */
+MESH_PY_API int meshPyReset(MeshPy* handle);
+
+#endif
@@ -0,0 +1,703 @@
+#include "mesh_service.h"
+#include "memory_report.h"
+#include "mesh.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(MeshServiceHeader) == 16, "the header is 16 bytes on the wire");
+static_assert(sizeof(SmoothRequest) == 24, "SmoothRequest layout changed");
+static_assert(sizeof(SmoothReply) == 24, "SmoothReply layout changed");
+static_assert(sizeof(MeshServiceInfo) == 40, "MeshServiceInfo layout changed");
+
+ResidentMesh::ResidentMesh() : mesh(new Mesh), factorizations(0) {
+}
+
+ResidentMesh::~ResidentMesh() {
+}
+
+template < class T >
+static void _append(std::vector< char >& out, const T& value) {
+	const char* bytes = reinterpret_cast< const char* >(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+MeshServiceInfo residentMeshInfo(ResidentMesh& resident) {
+	MeshServiceInfo info;
+	std::vector< int > stats = resident.mesh->collectMeshStats();
+	for (int k = 0; k < 6 && k < (int)stats.size(); ++k) {
+		info.stats[k] = stats[k];
+	}
+	info.meshBytes = meshMemoryReport(*resident.mesh).meshBytes();
+	info.cacheBytes = resident.cache.memoryBytes() + resident.workspace.memoryBytes();
+	if (resident.constrained) {
+		info.cacheBytes += resident.constrained->memoryBytes();
+	}
+	return info;
+}
+
+bool loadResidentMesh(ResidentMesh& resident, const std::string& filename) {
+	resident.filename = filename;
+	if (!resident.mesh->loadMeshFile(filename) || resident.mesh->vertices().empty()) {
+		return false;
+	}
+	const std::vector< Vertex* >& vertices = resident.mesh->vertices();
+	resident.loadedPositions.resize(vertices.size(), 3);
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		resident.loadedPositions.row(i) = vertices[i]->position().transpose();
+	}
+	return true;
+}
+
+void resetResidentMesh(ResidentMesh& resident) {
+	Mesh& mesh = *resident.mesh;
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		vertices[i]->setPosition(resident.loadedPositions.row(i).transpose());
+	}
+	mesh.computeVertexNormals();
+	mesh.setVertexPosDirty(true);
+	// Its rest positions were captured from the geometry just discarded
+	resident.constrained.reset();
+}
+
+/* Whether lo < value <= hi; false for NaN. */
+static bool _inRange(float value, float lo, float hi) {
+	return std::isfinite(value) && value > lo && value <= hi;
+}
+
+bool checkSmoothRequest(const SmoothRequest& request, std::string& error) {
+	switch (request.method) {
+	case SMOOTH_EXPLICIT:
+	case SMOOTH_IMPLICIT:
+	case SMOOTH_GAUSS_SEIDEL:
+		if (request.iterations > MESH_SERVICE_MAX_STEPS) {
+			error = "too many iterations";
+			return false;
+		}
+		break;
+	case SMOOTH_TAUBIN:
+		if (request.degree > MESH_SERVICE_MAX_STEPS) {
+			error = "degree too high";
+			return false;
+		}
+		if (!std::isfinite(request.mu) || request.mu >= 0.0f || request.mu < -MESH_SERVICE_MAX_LAMBDA) {
+			error = "mu out of range";
+			return false;
+		}
+		break;
+	case SMOOTH_CHEBYSHEV:
+		if (request.degree > MESH_SERVICE_MAX_STEPS) {
+			error = "degree too high";
+			return false;
+		}
+		if (!_inRange(request.passBand, 0.0f, 2.0f)) {
+			error = "passBand out of range";
+			return false;
+		}
+		return true; // lambda is not used
+	case SMOOTH_CONSTRAINED:
+		break;
+	default:
+		error = "unknown smoothing method";
+		return false;
+	}
+	if (!_inRange(request.lambda, 0.0f, MESH_SERVICE_MAX_LAMBDA)) {
+		error = "lambda out of range";
+		return false;
+	}
+	return true;
+}
+
+bool smoothResidentMesh(ResidentMesh& resident,
+                        const SmoothRequest& request,
+                        const std::vector< int >& pinned,
+                        SmoothReply& reply,
+                        std::string& error) {
+	TRACE_SCOPE("serviceSmooth");
+	if (!checkSmoothRequest(request, error)) {
+		return false;
+	}
+	Mesh& mesh = *resident.mesh;
+	bool cotangentWeights = request.cotangentWeights != 0;
+	auto start = std::chrono::steady_clock::now();
+	switch (request.method) {
+	case SMOOTH_EXPLICIT:
+	case SMOOTH_TAUBIN:
+	case SMOOTH_CHEBYSHEV: {
+		PolynomialSmoothOptions options;
+		options.cotangentWeights = cotangentWeights;
+		options.filter = request.method == SMOOTH_CHEBYSHEV ? FILTER_CHEBYSHEV : FILTER_TAUBIN;
+		options.degree = request.degree;
+		options.lambda = request.lambda;
+		options.mu = request.mu;
+		options.passBand = request.passBand;
+		if (request.method == SMOOTH_EXPLICIT) {
+			// Taubin steps with mu = lambda are plain explicit steps
+			options.degree = request.iterations;
+			options.mu = request.lambda;
+		}
+		polynomialSmooth(mesh, resident.cache, options, resident.workspace);
+		break;
+	}
+	case SMOOTH_IMPLICIT: {
+		ImplicitSmoothOptions options;
+		options.cotangentWeights = cotangentWeights;
+		options.lambda = request.lambda;
+		options.solve.traceCallback = [&reply](const SolveTrace& trace) {
+			reply.solverIterations += trace.iterations();
+		};
+		for (std::uint32_t k = 0; k < request.iterations; ++k) {
+			implicitSmooth(mesh, resident.cache, options);
+		}
+		break;
+	}
+	case SMOOTH_GAUSS_SEIDEL: {
+		GaussSeidelSmoothOptions options;
+		options.cotangentWeights = cotangentWeights;
+		options.lambda = request.lambda;
+		options.sweeps = request.iterations;
+		gaussSeidelSmooth(mesh, resident.cache, options, resident.workspace);
+		break;
+	}
+	case SMOOTH_CONSTRAINED: {
+		int numVertices = mesh.vertices().size();
+		for (int i : pinned) {
+			if (i < 0 || i >= numVertices) {
+				error = "pinned vertex out of range";
+				return false;
+			}
+		}
+		if (!resident.constrained) {
+			resident.constrained.reset(new ConstrainedSmoother);
+		}
+		int factored = resident.constrained->factorCount();
+		bool ok = resident.constrained->setup(mesh, pinned, cotangentWeights, request.lambda);
+		resident.factorizations += resident.constrained->factorCount() - factored;
+		if (!ok) {
+			error = "factorization failed";
+			return false;
+		}
+		if (!resident.constrained->solve(mesh)) {
+			error = "constrained solve failed";
+			return false;
+		}
+		break;
+	}
+	default:
+		error = "unknown smoothing method";
+		return false;
+	}
+	reply.seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+	reply.laplacianBuilds = resident.cache.buildCount();
+	reply.factorizations = resident.factorizations;
+	return true;
+}
+
+#ifndef _WIN32
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// How often blocked accepts and reads look at the stop flag, in ms
+static const int POLL_INTERVAL = 200;
+
+/* Bound every blocking read and write on a served connection, so a
+ * client stalling in the middle of a message cannot hold a worker. */
+static void _setTimeouts(int fd, int seconds) {
+	timeval timeout = {seconds, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/* A peer that went away must not kill the process with SIGPIPE. */
+static void _noSigPipe(int fd) {
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+	(void)fd;
+#endif
+}
+
+static bool _readAll(int fd, void* data, size_t size) {
+	char* out = static_cast< char* >(data);
+	while (size > 0) {
+		ssize_t count = recv(fd, out, size, 0);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			return false;
+		}
+		out += count;
+		size -= count;
+	}
+	return true;
+}
+
+static bool _writeAll(int fd, const void* data, size_t size) {
+	const char* in = static_cast< const char* >(data);
+	while (size > 0) {
+		ssize_t count = send(fd, in, size, SEND_FLAGS);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			return false;
+		}
+		in += count;
+		size -= count;
+	}
+	return true;
+}
+
+static bool _send(int fd, std::uint32_t magic, std::uint16_t code, std::uint32_t meshId,
+                  const void* payload, size_t payloadBytes) {
+	MeshServiceHeader header;
+	header.magic = magic;
+	header.code = code;
+	header.flags = 0;
+	header.meshId = meshId;
+	header.payloadBytes = payloadBytes;
+	return _writeAll(fd, &header, sizeof(header)) && _writeAll(fd, payload, payloadBytes);
+}
+
+static bool _reply(int fd, MeshServiceStatus status, std::uint32_t meshId, const void* payload = nullptr,
+                   size_t payloadBytes = 0) {
+	return _send(fd, MESH_SERVICE_RESPONSE_MAGIC, status, meshId, payload, payloadBytes);
+}
+
+static bool _fail(int fd, MeshServiceStatus status, std::uint32_t meshId, const std::string& reason) {
+	return _reply(fd, status, meshId, reason.data(), reason.size());
+}
+
+MeshServer::MeshServer(int numConnections, int idleSeconds)
+	: mListenFd(-1), mIdleSeconds(std::max(1, idleSeconds)), mStop(false), mActive(0), mNextId(1),
+	  mConnections(numConnections) {
+}
+
+MeshServer::~MeshServer() {
+	stop();
+	waitForConnections();
+	if (mListenFd >= 0) {
+		::close(mListenFd);
+		unlink(mSocketPath.c_str());
+	}
+}
+
+bool MeshServer::start(const std::string& socketPath) {
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cout << __FUNCTION__ << ": socket path too long: " << socketPath << "\n";
+		return false;
+	}
+	std::strcpy(address.sun_path, socketPath.c_str());
+
+	// Only a leftover socket is replaced, never some other file
+	struct stat info;
+	if (stat(socketPath.c_str(), &info) == 0) {
+		if (!S_ISSOCK(info.st_mode)) {
+			std::cout << __FUNCTION__ << ": " << socketPath << " exists and is not a socket\n";
+			return false;
+		}
+		unlink(socketPath.c_str());
+	}
+
+	mListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (mListenFd < 0 || bind(mListenFd, (const sockaddr*)&address, sizeof(address)) != 0
+	    || chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(mListenFd, 64) != 0) {
+		std::cout << __FUNCTION__ << ": cannot listen at " << socketPath << ": " << std::strerror(errno) << "\n";
+		if (mListenFd >= 0) {
+			::close(mListenFd);
+			mListenFd = -1;
+		}
+		return false;
+	}
+	mSocketPath = socketPath;
+	return true;
+}
+
+void MeshServer::run() {
+	while (!mStop && mListenFd >= 0) {
+		pollfd ready = {mListenFd, POLLIN, 0};
+		if (poll(&ready, 1, POLL_INTERVAL) <= 0) {
+			continue;
+		}
+		int fd = accept(mListenFd, nullptr, nullptr);
+		if (fd < 0) {
+			continue;
+		}
+		_noSigPipe(fd);
+		_setTimeouts(fd, mIdleSeconds);
+		++mActive;
+		mConnections.submit([this, fd]() { serveConnection(fd); });
+	}
+	waitForConnections();
+}
+
+/* Served connections notice mStop within POLL_INTERVAL once their
+ * current request is answered; queued ones close without reading. */
+void MeshServer::waitForConnections() {
+	while (mActive > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void MeshServer::stop() {
+	mStop = true;
+}
+
+int MeshServer::numMeshes() {
+	std::lock_guard< std::mutex > lock(mMutex);
+	return mMeshes.size();
+}
+
+void MeshServer::serveConnection(int fd) {
+	TRACE_THREAD_NAME("service connection");
+	std::vector< char > payload;
+	auto idleSince = std::chrono::steady_clock::now();
+	try {
+		while (!mStop) {
+			pollfd ready = {fd, POLLIN, 0};
+			int count = poll(&ready, 1, POLL_INTERVAL);
+			if (count == 0 || (count < 0 && errno == EINTR)) {
+				if (std::chrono::steady_clock::now() - idleSince > std::chrono::seconds(mIdleSeconds)) {
+					break;
+				}
+				continue;
+			}
+			MeshServiceHeader request;
+			if (count < 0 || !_readAll(fd, &request, sizeof(request))) {
+				break;
+			}
+			if (request.magic != MESH_SERVICE_REQUEST_MAGIC || request.payloadBytes > MESH_SERVICE_MAX_PAYLOAD) {
+				_fail(fd, STATUS_BAD_REQUEST, request.meshId, "bad request header");
+				break;
+			}
+			payload.resize(request.payloadBytes);
+			if (!_readAll(fd, payload.data(), payload.size()) || !handle(fd, request, payload)) {
+				break;
+			}
+			idleSince = std::chrono::steady_clock::now();
+		}
+	} catch (const std::exception& e) {
+		// Typically std::bad_alloc, always before the reply was started.
+		// The stream may be left mid-request, so the connection is closed
+		_fail(fd, STATUS_FAILED, 0, e.what());
+	}
+	::close(fd);
+	--mActive;
+}
+
+std::shared_ptr< ResidentMesh > MeshServer::find(std::uint32_t id) {
+	std::lock_guard< std::mutex > lock(mMutex);
+	auto found = mMeshes.find(id);
+	return found == mMeshes.end() ? nullptr : found->second;
+}
+
+bool MeshServer::handle(int fd, const MeshServiceHeader& request, const std::vector< char >& payload) {
+	std::uint32_t id = request.meshId;
+	if (request.code == OP_LOAD) {
+		TRACE_SCOPE("serviceLoad");
+		std::shared_ptr< ResidentMesh > resident = std::make_shared< ResidentMesh >();
+		std::string filename(payload.begin(), payload.end());
+		if (!loadResidentMesh(*resident, filename)) {
+			return _fail(fd, STATUS_FAILED, 0, "cannot load " + filename);
+		}
+		MeshServiceInfo info = residentMeshInfo(*resident);
+		{
+			std::lock_guard< std::mutex > lock(mMutex);
+			id = mNextId++;
+			mMeshes[id] = resident;
+		}
+		return _reply(fd, STATUS_OK, id, &info, sizeof(info));
+	}
+	if (request.code == OP_SHUTDOWN) {
+		mStop = true;
+		_reply(fd, STATUS_OK, 0);
+		return false;
+	}
+	if (request.code == OP_UNLOAD) {
+		std::lock_guard< std::mutex > lock(mMutex);
+		return mMeshes.erase(id) ? _reply(fd, STATUS_OK, id) : _fail(fd, STATUS_UNKNOWN_MESH, id, "unknown mesh");
+	}
+
+	std::shared_ptr< ResidentMesh > resident = find(id);
+	if (!resident) {
+		return _fail(fd, STATUS_UNKNOWN_MESH, id, "unknown mesh");
+	}
+	std::lock_guard< std::mutex > lock(resident->mutex);
+	switch (request.code) {
+	case OP_SMOOTH: {
+		SmoothRequest smooth;
+		std::vector< int > pinned;
+		if (payload.size() < sizeof(smooth)) {
+			return _fail(fd, STATUS_BAD_REQUEST, id, "short smoothing request");
+		}
+		std::memcpy(&smooth, payload.data(), sizeof(smooth));
+		if (payload.size() > sizeof(smooth)) {
+			std::int32_t count = 0;
+			size_t offset = sizeof(smooth) + sizeof(count);
+			if (payload.size() >= offset) {
+				std::memcpy(&count, payload.data() + sizeof(smooth), sizeof(count));
+			}
+			if (count < 0 || payload.size() != offset + count * sizeof(std::int32_t)) {
+				return _fail(fd, STATUS_BAD_REQUEST, id, "malformed pinned vertex list");
+			}
+			pinned.resize(count);
+			std::memcpy(pinned.data(), payload.data() + offset, count * sizeof(std::int32_t));
+		}
+		SmoothReply reply;
+		std::string error;
+		if (!checkSmoothRequest(smooth, error)) {
+			return _fail(fd, STATUS_BAD_REQUEST, id, error);
+		}
+		if (!smoothResidentMesh(*resident, smooth, pinned, reply, error)) {
+			return _fail(fd, STATUS_FAILED, id, error);
+		}
+		return _reply(fd, STATUS_OK, id, &reply, sizeof(reply));
+	}
+	case OP_STATS: {
+		MeshServiceInfo info = residentMeshInfo(*resident);
+		return _reply(fd, STATUS_OK, id, &info, sizeof(info));
+	}
+	case OP_POSITIONS: {
+		const std::vector< Vertex* >& vertices = resident->mesh->vertices();
+		std::vector< float > xyz(3 * vertices.size());
+		for (int i = 0; i < (int)vertices.size(); ++i) {
+			const Eigen::Vector3f& p = vertices[i]->position();
+			xyz[3 * i] = p[0];
+			xyz[3 * i + 1] = p[1];
+			xyz[3 * i + 2] = p[2];
+		}
+		return _reply(fd, STATUS_OK, id, xyz.data(), xyz.size() * sizeof(float));
+	}
+	case OP_RESET:
+		resetResidentMesh(*resident);
+		return _reply(fd, STATUS_OK, id);
+	default:
+		return _fail(fd, STATUS_BAD_REQUEST, id, "unknown opcode");
+	}
+}
+
+MeshClient::MeshClient() : mFd(-1) {
+}
+
+MeshClient::~MeshClient() {
+	close();
+}
+
+bool MeshClient::connect(const std::string& socketPath) {
+	close();
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		mError = "socket path too long";
+		return false;
+	}
+	std::strcpy(address.sun_path, socketPath.c_str());
+	mFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (mFd < 0 || ::connect(mFd, (const sockaddr*)&address, sizeof(address)) != 0) {
+		mError = "cannot connect to " + socketPath + ": " + std::strerror(errno);
+		close();
+		return false;
+	}
+	_noSigPipe(mFd);
+	return true;
+}
+
+void MeshClient::close() {
+	if (mFd >= 0) {
+		::close(mFd);
+		mFd = -1;
+	}
+}
+
+bool MeshClient::call(MeshServiceOp op, std::uint32_t meshId, const std::vector< char >& payload,
+                      MeshServiceHeader& response, std::vector< char >& reply) {
+	if (mFd < 0) {
+		mError = "not connected";
+		return false;
+	}
+	if (!_send(mFd, MESH_SERVICE_REQUEST_MAGIC, op, meshId, payload.data(), payload.size())
+	    || !_readAll(mFd, &response, sizeof(response)) || response.magic != MESH_SERVICE_RESPONSE_MAGIC
+	    || response.payloadBytes > MESH_SERVICE_MAX_PAYLOAD) {
+		mError = "connection to the service lost";
+		close();
+		return false;
+	}
+	reply.resize(response.payloadBytes);
+	if (!_readAll(mFd, reply.data(), reply.size())) {
+		mError = "connection to the service lost";
+		close();
+		return false;
+	}
+	if (response.code != STATUS_OK) {
+		mError.assign(reply.begin(), reply.end());
+		return false;
+	}
+	return true;
+}
+
+#else
+
+MeshServer::MeshServer(int numConnections, int idleSeconds)
+	: mListenFd(-1), mIdleSeconds(std::max(1, idleSeconds)), mStop(false), mActive(0), mNextId(1),
+	  mConnections(numConnections) {
+}
+
+MeshServer::~MeshServer() {
+}
+
+void MeshServer::waitForConnections() {
+}
+
+bool MeshServer::start(const std::string& socketPath) {
+	std::cout << __FUNCTION__ << ": Unix-domain sockets are not supported here: " << socketPath << "\n";
+	return false;
+}
+
+void MeshServer::run() {
+}
+
+void MeshServer::stop() {
+	mStop = true;
+}
+
+int MeshServer::numMeshes() {
+	std::lock_guard< std::mutex > lock(mMutex);
+	return mMeshes.size();
+}
+
+MeshClient::MeshClient() : mFd(-1) {
+}
+
+MeshClient::~MeshClient() {
+}
+
+bool MeshClient::connect(const std::string& socketPath) {
+	mError = "Unix-domain sockets are not supported here: " + socketPath;
+	return false;
+}
+
+void MeshClient::close() {
+}
+
+bool MeshClient::call(MeshServiceOp, std::uint32_t, const std::vector< char >&, MeshServiceHeader&,
+                      std::vector< char >&) {
+	mError = "not connected";
+	return false;
+}
+
+#endif
+
+/* Fixed-size reply payloads are copied out after a size check. */
+template < class T >
+static bool _decode(const std::vector< char >& reply, T& value, std::string& error) {
+	if (reply.size() != sizeof(T)) {
+		error = "unexpected reply size";
+		return false;
+	}
+	std::memcpy(&value, reply.data(), sizeof(T));
+	return true;
+}
+
+bool MeshClient::load(const std::string& filename, std::uint32_t& meshId, MeshServiceInfo* info) {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	if (!call(OP_LOAD, 0, std::vector< char >(filename.begin(), filename.end()), response, reply)) {
+		return false;
+	}
+	meshId = response.meshId;
+	MeshServiceInfo loaded;
+	if (!_decode(reply, loaded, mError)) {
+		return false;
+	}
+	if (info) {
+		*info = loaded;
+	}
+	return true;
+}
+
+bool MeshClient::unload(std::uint32_t meshId) {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	return call(OP_UNLOAD, meshId, std::vector< char >(), response, reply);
+}
+
+bool MeshClient::smooth(std::uint32_t meshId, const SmoothRequest& request, SmoothReply* reply,
+                        const std::vector< int >& pinned) {
+	std::vector< char > payload;
+	_append(payload, request);
+	if (request.method == SMOOTH_CONSTRAINED) {
+		_append(payload, std::int32_t(pinned.size()));
+		for (int i : pinned) {
+			_append(payload, std::int32_t(i));
+		}
+	}
+	MeshServiceHeader response;
+	std::vector< char > bytes;
+	SmoothReply result;
+	if (!call(OP_SMOOTH, meshId, payload, response, bytes) || !_decode(bytes, result, mError)) {
+		return false;
+	}
+	if (reply) {
+		*reply = result;
+	}
+	return true;
+}
+
+bool MeshClient::stats(std::uint32_t meshId, MeshServiceInfo& info) {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	return call(OP_STATS, meshId, std::vector< char >(), response, reply) && _decode(reply, info, mError);
+}
+
+bool MeshClient::positions(std::uint32_t meshId, std::vector< float >& xyz) {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	if (!call(OP_POSITIONS, meshId, std::vector< char >(), response, reply)) {
+		return false;
+	}
+	xyz.resize(reply.size() / sizeof(float));
+	std::memcpy(xyz.data(), reply.data(), xyz.size() * sizeof(float));
+	return true;
+}
+
+bool MeshClient::reset(std::uint32_t meshId) {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	return call(OP_RESET, meshId, std::vector< char >(), response, reply);
+}
+
+bool MeshClient::shutdown() {
+	MeshServiceHeader response;
+	std::vector< char > reply;
+	return call(OP_SHUTDOWN, 0, std::vector< char >(), response, reply);
+}
+
+const std::string& MeshClient::error() const {
+	return mError;
+}
@@ -0,0 +1,224 @@
+#ifndef MESH_SERVICE_H
+#define MESH_SERVICE_H
+
+#include "constrained_smoothing.h"
+#include "laplacian.h"
+#include "smoothing.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Mesh;
+
+/* Local mesh service: a daemon keeps loaded meshes resident together with
+ * their cached Laplacians, smoothing workspaces and constrained-smoothing
+ * factorizations, so a repeated request on a hot mesh pays only for the
+ * compute and not for parsing and half-edge construction.
+ *
+ * Clients talk to it over a Unix-domain stream socket. Every message is a
+ * fixed 16-byte header followed by payloadBytes of payload, all fields in
+ * the host's byte order (the socket never leaves the machine):
+ *
+ *   request   magic 'MSRQ', opcode, flags, mesh id, payload bytes
+ *   response  magic 'MSRS', status, reserved, mesh id, payload bytes
+ *
+ * A connection carries any number of requests, each answered in order.
+ * Requests on one mesh are serialized; different meshes and different
+ * connections are served concurrently by the server's connection pool,
+ * while the kernels themselves run on ThreadPool::global(). The server is
+ * POSIX only; elsewhere start() fails. */
+
+static const std::uint32_t MESH_SERVICE_REQUEST_MAGIC = 0x5152534d;  // "MSRQ"
+static const std::uint32_t MESH_SERVICE_RESPONSE_MAGIC = 0x5352534d; // "MSRS"
+// Larger payloads are refused instead of allocated
+static const std::uint32_t MESH_SERVICE_MAX_PAYLOAD = 1u << 30;
+// Smoothing requests beyond these bounds are refused as bad requests, so
+// a single request cannot exhaust memory or hold a mesh for hours
+static const std::uint32_t MESH_SERVICE_MAX_STEPS = 10000; // iterations or degree
+static const float MESH_SERVICE_MAX_LAMBDA = 100.0f;       // also bounds -mu
+
+enum MeshServiceOp {
+	OP_LOAD = 1,      // payload: file name; replies the new mesh id and MeshServiceInfo
+	OP_UNLOAD = 2,    // drop a mesh and everything cached for it
+	OP_SMOOTH = 3,    // payload: SmoothRequest [+ pinned indices]; replies SmoothReply
+	OP_STATS = 4,     // replies MeshServiceInfo
+	OP_POSITIONS = 5, // replies the float xyz of every vertex
+	OP_RESET = 6,     // restore the loaded positions, drop the constrained smoother
+	OP_SHUTDOWN = 7   // stop accepting; requests being handled are answered,
+	                  // then every connection is closed
+};
+
+enum MeshServiceStatus {
+	STATUS_OK = 0,
+	STATUS_BAD_REQUEST = 1,
+	STATUS_UNKNOWN_MESH = 2,
+	STATUS_FAILED = 3 // the payload holds the reason as text
+};
+
+enum SmoothMethod {
+	SMOOTH_EXPLICIT = 0,     // iterations explicit umbrella steps with lambda
+	SMOOTH_IMPLICIT = 1,     // iterations implicit steps with lambda
+	SMOOTH_TAUBIN = 2,       // degree alternating lambda / mu steps
+	SMOOTH_CHEBYSHEV = 3,    // Chebyshev low-pass of the given degree and band
+	SMOOTH_GAUSS_SEIDEL = 4, // iterations in-place sweeps with lambda
+	SMOOTH_CONSTRAINED = 5   // one implicit step with pinned vertices
+};
+
+struct MeshServiceHeader {
+	std::uint32_t magic;
+	std::uint16_t code;   // MeshServiceOp or MeshServiceStatus
+	std::uint16_t flags;
+	std::uint32_t meshId;
+	std::uint32_t payloadBytes;
+};
+
+/* OP_SMOOTH payload. Only the fields a method uses are checked: steps up
+ * to MESH_SERVICE_MAX_STEPS, 0 < lambda <= MESH_SERVICE_MAX_LAMBDA,
+ * -MESH_SERVICE_MAX_LAMBDA <= mu < 0 and 0 < passBand <= 2, the spectral
+ * range of the uniform Laplacian. SMOOTH_CONSTRAINED appends a
+ * std::int32_t count and that many pinned vertex indices. Its
+ * factorization, and the free rest positions captured with it, are kept
+ * until the pins, weights or lambda change, so later requests only move
+ * the handles (see ConstrainedSmoother). */
+struct SmoothRequest {
+	std::uint8_t method = SMOOTH_IMPLICIT;
+	std::uint8_t cotangentWeights = 1;
+	std::uint16_t reserved = 0;
+	std::uint32_t iterations = 1;
+	std::uint32_t degree = 10;
+	float lambda = 1.0f;
+	float mu = -0.53f;
+	float passBand = 0.25f;
+};
+
+struct SmoothReply {
+	double seconds = 0.0;         // compute time spent in the service
+	std::uint32_t solverIterations = 0;
+	std::uint32_t laplacianBuilds = 0;  // assemblies and refreshes, in total
+	std::uint32_t factorizations = 0;   // of the constrained smoother, in total
+	std::uint32_t reserved = 0;
+};
+
+struct MeshServiceInfo {
+	std::int32_t stats[6] = {}; // collectMeshStats: V, E, F, B, C, G
+	std::uint64_t meshBytes = 0;
+	std::uint64_t cacheBytes = 0; // Laplacians, workspace and factorization
+};
+
+/* Mesh state kept by the service between requests. */
+struct ResidentMesh {
+	ResidentMesh();
+	~ResidentMesh();
+
+	std::mutex mutex;
+	std::unique_ptr< Mesh > mesh;
+	std::string filename;
+	VertexMatrix loadedPositions;
+	LaplacianCache cache;
+	SmoothingWorkspace workspace;
+	// Created by the first SMOOTH_CONSTRAINED request, dropped by OP_RESET
+	std::unique_ptr< ConstrainedSmoother > constrained;
+	int factorizations;
+};
+
+/* Load a mesh file into a fresh ResidentMesh and remember its positions;
+ * false if it cannot be read or has no vertices. */
+bool loadResidentMesh(ResidentMesh& resident, const std::string& filename);
+/* Restore the loaded positions and drop the constrained smoother. */
+void resetResidentMesh(ResidentMesh& resident);
+/* Statistics and resident bytes of a mesh. */
+MeshServiceInfo residentMeshInfo(ResidentMesh& resident);
+/* Check the method and the ranges of a smoothing request; false with the
+ * reason in error. */
+bool checkSmoothRequest(const SmoothRequest& request, std::string& error);
+/* Run one smoothing request against the resident state, as OP_SMOOTH
+ * does; the caller holds resident.mutex if the mesh is shared. Returns
+ * false with the reason in error, also for a request checkSmoothRequest
+ * refuses. */
+bool smoothResidentMesh(ResidentMesh& resident,
+                        const SmoothRequest& request,
+                        const std::vector< int >& pinned,
+                        SmoothReply& reply,
+                        std::string& error);
+
+class MeshServer {
+public:
+	/* numConnections clients are served at once; <= 0 uses the hardware
+	 * concurrency. Further clients are accepted and wait for a slot. A
+	 * connection that sends no request for idleSeconds, or stalls that
+	 * long in the middle of a message, is closed to free its slot. */
+	explicit MeshServer(int numConnections = 0, int idleSeconds = 60);
+	/* Stops and waits until every accepted connection is closed. */
+	~MeshServer();
+
+	/* Listen at socketPath, replacing a stale socket file; the socket is
+	 * made accessible to the owner only. */
+	bool start(const std::string& socketPath);
+	/* Accept and serve clients until stop() or OP_SHUTDOWN, then wait
+	 * until every accepted connection is closed. */
+	void run();
+	/* Ask run() to return; safe from a signal handler. */
+	void stop();
+
+	int numMeshes();
+
+private:
+	void serveConnection(int fd);
+	/* Handle one request; false closes the connection. */
+	bool handle(int fd, const MeshServiceHeader& request, const std::vector< char >& payload);
+	std::shared_ptr< ResidentMesh > find(std::uint32_t id);
+	void waitForConnections();
+
+	std::string mSocketPath;
+	int mListenFd;
+	int mIdleSeconds;
+	std::atomic< bool > mStop;
+	// Accepted connections not closed yet, queued ones included
+	std::atomic< int > mActive;
+
+	std::mutex mMutex;
+	std::map< std::uint32_t, std::shared_ptr< ResidentMesh > > mMeshes;
+	std::uint32_t mNextId;
+
+	// Last, so its workers are joined before the meshes are destroyed
+	ThreadPool mConnections;
+};
+
+/* Blocking client for one connection. Every call returns false on a
+ * transport or service error, with the reason in error(). */
+class MeshClient {
+public:
+	MeshClient();
+	~MeshClient();
+
+	MeshClient(const MeshClient&) = delete;
+	MeshClient& operator=(const MeshClient&) = delete;
+
+	bool connect(const std::string& socketPath);
+	void close();
+
+	bool load(const std::string& filename, std::uint32_t& meshId, MeshServiceInfo* info = nullptr);
+	bool unload(std::uint32_t meshId);
+	bool smooth(std::uint32_t meshId, const SmoothRequest& request, SmoothReply* reply = nullptr,
+	            const std::vector< int >& pinned = std::vector< int >());
+	bool stats(std::uint32_t meshId, MeshServiceInfo& info);
+	bool positions(std::uint32_t meshId, std::vector< float >& xyz);
+	bool reset(std::uint32_t meshId);
+	bool shutdown();
+
+	const std::string& error() const;
+
+private:
+	bool call(MeshServiceOp op, std::uint32_t meshId, const std::vector< char >& payload,
+	          MeshServiceHeader& response, std::vector< char >& reply);
+
+	int mFd;
+	std::string mError;
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "multigrid.h"
+#include "trace.h"
+#include <cmath>
+
+typedef Eigen::SparseMatrix< float, Eigen::RowMajor > RowMatrix;
+
+/* Greedy clustering of the matrix graph. Every vertex whose one-ring is
+ * still free seeds an aggregate with its one-ring, leftovers join a
+ * neighboring aggregate, and isolated leftovers become singletons.
+ * Returns the number of aggregates. */
+static int _aggregate(const RowMatrix& A, std::vector< int >& agg) {
+	int n = A.rows();
+	agg.assign(n, -1);
+	int count = 0;
+
+	// Pass 1: seed aggregates from vertices with a free one-ring
+	for (int i = 0; i < n; ++i) {
+		if (agg[i] >= 0) {
+			continue;
+		}
+		bool free = true;
+		for (RowMatrix::InnerIterator it(A, i); it; ++it) {
+			if (it.col() != i && agg[it.col()] >= 0) {
+				free = false;
+				break;
+			}
+		}
+		if (!free) {
+			continue;
+		}
+		agg[i] = count;
+		for (RowMatrix::InnerIterator it(A, i); it; ++it) {
+			agg[it.col()] = count;
+		}
+		++count;
+	}
+
+	// Pass 2: attach leftovers to an adjacent aggregate
+	std::vector< int > pass2(agg);
+	for (int i = 0; i < n; ++i) {
+		if (agg[i] >= 0) {
+			continue;
+		}
+		for (RowMatrix::InnerIterator it(A, i); it; ++it) {
+			if (agg[it.col()] >= 0) {
+				pass2[i] = agg[it.col()];
+				break;
+			}
+		}
+	}
+	agg.swap(pass2);
+
+	// Pass 3: whatever is left becomes its own aggregate
+	for (int i = 0; i < n; ++i) {
+		if (agg[i] < 0) {
+			agg[i] = count++;
+		}
+	}
+	return count;
+}
+
+/* Estimate the spectral radius of D^-1 A with a few power iterations. */
+static float _estimateRadius(const RowMatrix& A, const Eigen::VectorXf& invDiag) {
+	Eigen::VectorXf x = Eigen::VectorXf::LinSpaced(A.rows(), 1.0f, 2.0f);
+	x.normalize();
+	float radius = 1.0f;
+	for (int k = 0; k < 10; ++k) {
+		Eigen::VectorXf y = invDiag.cwiseProduct(A * x);
+		radius = y.norm();
+		if (radius == 0.0f) {
+			return 1.0f;
+		}
+		x = y / radius;
+	}
+	return radius;
+}
+
+MultigridSolver::MultigridSolver() {
+	mMaxLevels = 20;
+	mCoarsestSize = 500;
+	mSmoothingSweeps = 2;
+}
+
+void MultigridSolver::setup(const Eigen::SparseMatrix< float >& A) {
+	TRACE_SCOPE("multigridSetup");
+	mLevels.clear();
+	mLevels.push_back(Level());
+	mLevels.back().A = A;
+
+	while ((int)mLevels.size() < mMaxLevels && mLevels.back().A.rows() > mCoarsestSize) {
+		const RowMatrix& fine = mLevels.back().A;
+		int n = fine.rows();
+
+		std::vector< int > agg;
+		int numAggregates = _aggregate(fine, agg);
+		if (numAggregates >= n) {
+			// No coarsening progress, stop here
+			break;
+		}
+
+		// Tentative prolongation: one column per aggregate
+		std::vector< Eigen::Triplet< float > > triplets;
+		triplets.reserve(n);
+		for (int i = 0; i < n; ++i) {
+			triplets.push_back(Eigen::Triplet< float >(i, agg[i], 1.0f));
+		}
+		RowMatrix tentative(n, numAggregates);
+		tentative.setFromTriplets(triplets.begin(), triplets.end());
+
+		// Smooth it with one damped Jacobi step: P = (I - w D^-1 A) P_t
+		Eigen::VectorXf invDiag = fine.diagonal().cwiseInverse();
+		float omega = (4.0f / 3.0f) / _estimateRadius(fine, invDiag);
+		RowMatrix jacobi = invDiag.asDiagonal() * fine;
+		RowMatrix smoothed = jacobi * tentative;
+		RowMatrix P = tentative - omega * smoothed;
+		P.prune(0.0f);
+
+		Level& level = mLevels.back();
+		level.P = P;
+		level.R = P.transpose();
+
+		RowMatrix coarse = level.R * (fine * level.P);
+		coarse.prune(0.0f);
+		mLevels.push_back(Level());
+		mLevels.back().A = coarse;
+	}
+
+	for (Level& level : mLevels) {
+		int n = level.A.rows();
+		level.b.resize(n);
+		level.x.resize(n);
+		level.r.resize(n);
+	}
+
+	Eigen::SparseMatrix< float > coarsest = mLevels.back().A;
+	coarsest.makeCompressed();
+	mCoarseSolver.compute(coarsest);
+}
+
+void MultigridSolver::gaussSeidel(const RowMatrix& A,
+                                  const Eigen::VectorXf& b,
+                                  Eigen::VectorXf& x,
+                                  bool forward) const {
+	int n = A.rows();
+	for (int k = 0; k < n; ++k) {
+		int i = forward ? k : n - 1 - k;
+		float sum = b[i];
+		float diag = 1.0f;
+		for (RowMatrix::InnerIterator it(A, i); it; ++it) {
+			if (it.col() == i) {
+				diag = it.value();
+			} else {
+				sum -= it.value() * x[it.col()];
+			}
+		}
+		x[i] = sum / diag;
+	}
+}
+
+void MultigridSolver::vcycle(int level) const {
+	Level& curr = mLevels[level];
+	if (level + 1 == (int)mLevels.size()) {
+		curr.x = mCoarseSolver.solve(curr.b);
+		return;
+	}
+
+	for (int k = 0; k < mSmoothingSweeps; ++k) {
+		gaussSeidel(curr.A, curr.b, curr.x, true);
+	}
+
+	Level& next = mLevels[level + 1];
+	curr.r.noalias() = curr.b - curr.A * curr.x;
+	next.b.noalias() = curr.R * curr.r;
+	next.x.setZero();
+	vcycle(level + 1);
+	curr.x.noalias() += curr.P * next.x;
+
+	for (int k = 0; k < mSmoothingSweeps; ++k) {
+		gaussSeidel(curr.A, curr.b, curr.x, false);
+	}
+}
+
+int MultigridSolver::solve(const Eigen::VectorXf& b,
+                           Eigen::VectorXf& x,
+                           int maxIterations,
+                           float errorTolerance) const {
+	Level& top = mLevels[0];
+	top.b = b;
+	top.x = x;
+	int i = 0;
+	for (; i < maxIterations; ++i) {
+		top.r.noalias() = top.b - top.A * top.x;
+		if (top.r.squaredNorm() < errorTolerance) {
+			break;
+		}
+		vcycle(0);
+	}
+	x = top.x;
+	return i;
+}
+
+void MultigridSolver::apply(const Eigen::VectorXf& r, Eigen::VectorXf& z) const {
+	Level& top = mLevels[0];
+	top.b = r;
+	top.x.setZero();
+	vcycle(0);
+	z = top.x;
+}
+
+int MultigridSolver::numLevels() const {
+	return mLevels.size();
+}
+
+int MultigridSolver::levelSize(int level) const {
+	return mLevels[level].A.rows();
+}
+
+int MultigridSolver::maxLevels() const {
+	return mMaxLevels;
+}
+
+int MultigridSolver::setMaxLevels(int n) {
+	mMaxLevels = n;
+	return mMaxLevels;
+}
+
+int MultigridSolver::coarsestSize() const {
+	return mCoarsestSize;
+}
+
+int MultigridSolver::setCoarsestSize(int n) {
+	mCoarsestSize = n;
+	return mCoarsestSize;
+}
+
+int MultigridSolver::smoothingSweeps() const {
+	return mSmoothingSweeps;
+}
+
+int MultigridSolver::setSmoothingSweeps(int n) {
+	mSmoothingSweeps = n;
+	return mSmoothingSweeps;
+}
@@ -0,0 +1,77 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "solver.h"
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+#include <vector>
+
+/* Multigrid solver for the implicit umbrella systems (I - lambda * L) x = b.
+ *
+ * The hierarchy is built by clustering: each level groups a vertex with
+ * its one-ring into an aggregate, starting from the mesh connectivity
+ * encoded in the sparsity of A. The tentative piecewise-constant
+ * prolongation is smoothed with one damped Jacobi step, restriction is
+ * its transpose and coarse operators are Galerkin products R * A * P.
+ * Gauss-Seidel is used as the smoother and the coarsest level is
+ * factorized directly.
+ *
+ * The solver can be used on its own (solve) or as a preconditioner for
+ * bicgstab, in which case every application is a single V-cycle. */
+class MultigridSolver : public Preconditioner {
+public:
+	MultigridSolver();
+
+	/* Build the level hierarchy for A. Must be called before solving. */
+	void setup(const Eigen::SparseMatrix< float >& A);
+
+	/* Run V-cycles until the squared residual norm drops below
+	 * errorTolerance. Returns the number of cycles performed. */
+	int solve(const Eigen::VectorXf& b,
+	          Eigen::VectorXf& x,
+	          int maxIterations,
+	          float errorTolerance) const;
+
+	/* One V-cycle from a zero initial guess. Not thread-safe: the level
+	 * workspaces are shared between calls. */
+	void apply(const Eigen::VectorXf& r, Eigen::VectorXf& z) const override;
+
+	int numLevels() const;
+	int levelSize(int level) const;
+
+	int maxLevels() const;
+	int setMaxLevels(int n);
+	int coarsestSize() const;
+	int setCoarsestSize(int n);
+	int smoothingSweeps() const;
+	int setSmoothingSweeps(int n);
+
+private:
+	typedef Eigen::SparseMatrix< float, Eigen::RowMajor > RowMatrix;
+
+	struct Level {
+		RowMatrix A;
+		RowMatrix P; // prolongation from the next coarser level
+		RowMatrix R; // restriction to the next coarser level
+
+		// Per-level workspace reused across cycles
+		Eigen::VectorXf b;
+		Eigen::VectorXf x;
+		Eigen::VectorXf r;
+	};
+
+	void vcycle(int level) const;
+	void gaussSeidel(const RowMatrix& A,
+	                 const Eigen::VectorXf& b,
+	                 Eigen::VectorXf& x,
+	                 bool forward) const;
+
+	int mMaxLevels;
+	int mCoarsestSize;
+	int mSmoothingSweeps;
+
+	mutable std::vector< Level > mLevels;
+	Eigen::SparseLU< Eigen::SparseMatrix< float > > mCoarseSolver;
+};
+
+#endif
@@ -0,0 +1,855 @@
+#include "out_of_core.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : mData(nullptr), mSize(0) {
+#ifdef _WIN32
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = nullptr;
+#else
+	mFd = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+static bool _mapView(HANDLE file, bool writable, std::int64_t bytes, void*& mapping, char*& data) {
+	if (bytes == 0) {
+		// Empty files cannot be mapped and need no view
+		return true;
+	}
+	mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+	                             DWORD(bytes >> 32), DWORD(bytes & 0xffffffff), nullptr);
+	if (!mapping) {
+		return false;
+	}
+	data = (char*)MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	return data != nullptr;
+}
+
+bool MappedFile::open(const std::string& path, bool writable) {
+	close();
+	mFile = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+	                    FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(mFile, &size);
+	mSize = size.QuadPart;
+	if (!_mapView(mFile, writable, mSize, mMapping, mData)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::create(const std::string& path, std::int64_t bytes) {
+	close();
+	mFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+	                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	size.QuadPart = bytes;
+	if (!SetFilePointerEx(mFile, size, nullptr, FILE_BEGIN) || !SetEndOfFile(mFile)) {
+		close();
+		return false;
+	}
+	mSize = bytes;
+	if (!_mapView(mFile, true, mSize, mMapping, mData)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if (mData) {
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping) {
+		CloseHandle(mMapping);
+	}
+	if (mFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(mFile);
+	}
+	mData = nullptr;
+	mSize = 0;
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = nullptr;
+}
+
+bool MappedFile::isOpen() const {
+	return mFile != INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::release(std::int64_t offset, std::int64_t bytes) const {
+	if (mData && bytes > 0) {
+		// Unlocking pages that are not locked trims them from the working set
+		VirtualUnlock(mData + offset, SIZE_T(bytes));
+	}
+}
+
+#else
+
+bool MappedFile::open(const std::string& path, bool writable) {
+	close();
+	mFd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (mFd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(mFd, &info) != 0) {
+		close();
+		return false;
+	}
+	mSize = info.st_size;
+	if (mSize > 0) {
+		void* data = mmap(nullptr, mSize, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, mFd, 0);
+		if (data == MAP_FAILED) {
+			close();
+			return false;
+		}
+		mData = (char*)data;
+	}
+	return true;
+}
+
+bool MappedFile::create(const std::string& path, std::int64_t bytes) {
+	close();
+	mFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (mFd < 0 || ftruncate(mFd, bytes) != 0) {
+		close();
+		return false;
+	}
+	mSize = bytes;
+	if (mSize > 0) {
+		void* data = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+		if (data == MAP_FAILED) {
+			close();
+			return false;
+		}
+		mData = (char*)data;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if (mData) {
+		munmap(mData, mSize);
+	}
+	if (mFd >= 0) {
+		::close(mFd);
+	}
+	mData = nullptr;
+	mSize = 0;
+	mFd = -1;
+}
+
+bool MappedFile::isOpen() const {
+	return mFd >= 0;
+}
+
+void MappedFile::release(std::int64_t offset, std::int64_t bytes) const {
+	if (!mData || bytes <= 0) {
+		return;
+	}
+	// Whole pages inside the range only, the neighbors may still be in use
+	std::int64_t page = sysconf(_SC_PAGESIZE);
+	std::int64_t begin = (offset + page - 1) / page * page;
+	std::int64_t end = (offset + bytes) / page * page;
+	if (end > begin) {
+		// Shared file pages keep their data in the page cache
+		madvise(mData + begin, end - begin, MADV_DONTNEED);
+	}
+}
+
+#endif
+
+std::int64_t MappedFile::size() const {
+	return mSize;
+}
+
+char* MappedFile::data() const {
+	return mData;
+}
+
+/* Contents of header.bin. */
+struct _OutOfCoreHeader {
+	char magic[8];
+	std::int64_t numVertices;
+	std::int64_t numFaces;
+	std::int32_t chunkVertices;
+	std::int32_t numChunks;
+};
+
+static const char _OUT_OF_CORE_MAGIC[8] = {'O', 'O', 'C', 'M', 'E', 'S', 'H', '1'};
+
+/* Spread the low 21 bits of x to every third bit. */
+static std::uint64_t _spreadBits(std::uint64_t x) {
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+
+/* Parse the vertex index of an OBJ face corner such as 7, 7/1 or 7/1/3.
+ * index is -1 unless the corner names one of the numVertices vertices
+ * read so far; 0, forward and out-of-range negative references are
+ * invalid. */
+static bool _parseCorner(char*& s, std::int64_t numVertices, int& index) {
+	while (*s == ' ' || *s == '\t') {
+		++s;
+	}
+	char* end = nullptr;
+	long long value = std::strtoll(s, &end, 10);
+	if (end == s) {
+		return false;
+	}
+	std::int64_t vertex = value < 0 ? numVertices + value : std::int64_t(value) - 1;
+	index = value != 0 && vertex >= 0 && vertex < numVertices ? int(vertex) : -1;
+	s = end;
+	while (*s && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n') {
+		++s;
+	}
+	return true;
+}
+
+bool OutOfCoreMesh::convert(const std::string& objFile, const std::string& directory, int chunkVertices) {
+	if (chunkVertices <= 0) {
+		std::cout << __FUNCTION__ << ": chunkVertices must be positive, got " << chunkVertices << "\n";
+		return false;
+	}
+	std::string prefix = directory + "/";
+	FILE* in = std::fopen(objFile.c_str(), "rb");
+	if (!in) {
+		std::cout << __FUNCTION__ << ": cannot open " << objFile << "\n";
+		return false;
+	}
+	FILE* rawPositions = std::fopen((prefix + "positions.raw").c_str(), "wb");
+	FILE* rawFaces = std::fopen((prefix + "faces.raw").c_str(), "wb");
+	if (!rawPositions || !rawFaces) {
+		std::cout << __FUNCTION__ << ": cannot write to " << directory << "\n";
+		std::fclose(in);
+		if (rawPositions) {
+			std::fclose(rawPositions);
+		}
+		if (rawFaces) {
+			std::fclose(rawFaces);
+		}
+		return false;
+	}
+
+	// Pass 1: stream vertices and triangles to raw files in input order
+	std::int64_t numVertices = 0;
+	std::int64_t numFaces = 0;
+	float bboxMin[3] = {INFINITY, INFINITY, INFINITY};
+	float bboxMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+	std::vector< char > line(1 << 16);
+	std::vector< int > polygon;
+	std::int64_t lineNumber = 0;
+	bool valid = true;
+	while (valid && std::fgets(line.data(), line.size(), in)) {
+		char* s = line.data();
+		++lineNumber;
+		if (s[0] == 'v' && (s[1] == ' ' || s[1] == '\t')) {
+			float p[3];
+			s += 2;
+			for (int k = 0; k < 3; ++k) {
+				p[k] = std::strtof(s, &s);
+				bboxMin[k] = std::min(bboxMin[k], p[k]);
+				bboxMax[k] = std::max(bboxMax[k], p[k]);
+			}
+			std::fwrite(p, sizeof(float), 3, rawPositions);
+			++numVertices;
+		} else if (s[0] == 'f' && (s[1] == ' ' || s[1] == '\t')) {
+			s += 2;
+			polygon.clear();
+			int index;
+			while (_parseCorner(s, numVertices, index)) {
+				if (index < 0) {
+					std::cout << __FUNCTION__ << ": " << objFile << ":" << lineNumber
+					          << ": face refers to a missing vertex\n";
+					valid = false;
+					break;
+				}
+				polygon.push_back(index);
+			}
+			if (!valid) {
+				break;
+			}
+			for (int k = 1; k + 1 < (int)polygon.size(); ++k) {
+				int face[3] = {polygon[0], polygon[k], polygon[k + 1]};
+				std::fwrite(face, sizeof(int), 3, rawFaces);
+				++numFaces;
+			}
+		}
+	}
+	std::fclose(in);
+	std::fclose(rawPositions);
+	std::fclose(rawFaces);
+	if (!valid) {
+		std::remove((prefix + "positions.raw").c_str());
+		std::remove((prefix + "faces.raw").c_str());
+		return false;
+	}
+
+	MappedFile raw;
+	MappedFile rawFaceMap;
+	if (!raw.open(prefix + "positions.raw", false) || !rawFaceMap.open(prefix + "faces.raw", false)) {
+		return false;
+	}
+	const float* P = raw.as< const float >();
+	const int* FR = rawFaceMap.as< const int >();
+
+	// Morton order of the vertices quantized in the bounding box
+	std::vector< std::pair< std::uint64_t, int > > keys(numVertices);
+	float scale[3];
+	for (int k = 0; k < 3; ++k) {
+		float extent = bboxMax[k] - bboxMin[k];
+		scale[k] = extent > 0.0f ? float((1 << 21) - 1) / extent : 0.0f;
+	}
+	for (std::int64_t i = 0; i < numVertices; ++i) {
+		std::uint64_t code = 0;
+		for (int k = 0; k < 3; ++k) {
+			std::uint64_t q = std::uint64_t((P[3 * i + k] - bboxMin[k]) * scale[k]);
+			code |= _spreadBits(q) << k;
+		}
+		keys[i] = std::make_pair(code, int(i));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	MappedFile positions;
+	MappedFile normals;
+	MappedFile order;
+	if (!positions.create(prefix + "positions.bin", numVertices * 3 * sizeof(float))
+	    || !normals.create(prefix + "normals.bin", numVertices * 3 * sizeof(float))
+	    || !order.create(prefix + "order.bin", numVertices * sizeof(int))) {
+		return false;
+	}
+	std::vector< int > rank(numVertices);
+	float* positionData = positions.as< float >();
+	int* orderData = order.as< int >();
+	for (std::int64_t i = 0; i < numVertices; ++i) {
+		int old = keys[i].second;
+		rank[old] = int(i);
+		orderData[i] = old;
+		std::memcpy(positionData + 3 * i, P + 3 * std::int64_t(old), 3 * sizeof(float));
+	}
+	std::vector< std::pair< std::uint64_t, int > >().swap(keys);
+	raw.close();
+	positions.close();
+	normals.close();
+	order.close();
+
+	// Faces grouped by the chunk of their lowest vertex
+	int numChunks = std::max< std::int64_t >(1, (numVertices + chunkVertices - 1) / chunkVertices);
+	std::vector< std::int64_t > cursor(numChunks + 1, 0);
+	for (std::int64_t f = 0; f < numFaces; ++f) {
+		int low = std::min(rank[FR[3 * f]], std::min(rank[FR[3 * f + 1]], rank[FR[3 * f + 2]]));
+		++cursor[low / chunkVertices + 1];
+	}
+	for (int c = 0; c < numChunks; ++c) {
+		cursor[c + 1] += cursor[c];
+	}
+	MappedFile faces;
+	if (!faces.create(prefix + "faces.bin", numFaces * 3 * sizeof(int))) {
+		return false;
+	}
+	int* F = faces.as< int >();
+	for (std::int64_t f = 0; f < numFaces; ++f) {
+		int v[3] = {rank[FR[3 * f]], rank[FR[3 * f + 1]], rank[FR[3 * f + 2]]};
+		int low = std::min(v[0], std::min(v[1], v[2]));
+		std::int64_t slot = cursor[low / chunkVertices]++;
+		std::memcpy(F + 3 * slot, v, sizeof(v));
+	}
+	std::vector< int >().swap(rank);
+	rawFaceMap.close();
+	std::remove((prefix + "positions.raw").c_str());
+	std::remove((prefix + "faces.raw").c_str());
+
+	// Every chunk lists each face touching one of its vertices once
+	MappedFile chunkOffsets;
+	if (!chunkOffsets.create(prefix + "chunk_offsets.bin", (numChunks + 1) * sizeof(std::int64_t))) {
+		return false;
+	}
+	std::int64_t* offsets = chunkOffsets.as< std::int64_t >();
+	auto chunksOf = [&](std::int64_t f, int* chunks) {
+		int count = 0;
+		for (int k = 0; k < 3; ++k) {
+			int c = F[3 * f + k] / chunkVertices;
+			if (std::find(chunks, chunks + count, c) == chunks + count) {
+				chunks[count++] = c;
+			}
+		}
+		return count;
+	};
+	int chunks[3];
+	for (std::int64_t f = 0; f < numFaces; ++f) {
+		int count = chunksOf(f, chunks);
+		for (int k = 0; k < count; ++k) {
+			++offsets[chunks[k] + 1];
+		}
+	}
+	for (int c = 0; c < numChunks; ++c) {
+		offsets[c + 1] += offsets[c];
+	}
+	MappedFile chunkFaces;
+	if (!chunkFaces.create(prefix + "chunk_faces.bin", offsets[numChunks] * sizeof(int))) {
+		return false;
+	}
+	int* list = chunkFaces.as< int >();
+	cursor.assign(offsets, offsets + numChunks);
+	for (std::int64_t f = 0; f < numFaces; ++f) {
+		int count = chunksOf(f, chunks);
+		for (int k = 0; k < count; ++k) {
+			list[cursor[chunks[k]]++] = int(f);
+		}
+	}
+
+	_OutOfCoreHeader header;
+	std::memcpy(header.magic, _OUT_OF_CORE_MAGIC, sizeof(header.magic));
+	header.numVertices = numVertices;
+	header.numFaces = numFaces;
+	header.chunkVertices = chunkVertices;
+	header.numChunks = numChunks;
+	FILE* out = std::fopen((prefix + "header.bin").c_str(), "wb");
+	if (!out) {
+		return false;
+	}
+	bool written = std::fwrite(&header, sizeof(header), 1, out) == 1;
+	std::fclose(out);
+	return written;
+}
+
+OutOfCoreMesh::OutOfCoreMesh() {
+	mNumVertices = 0;
+	mNumFaces = 0;
+	mChunkVertices = 1;
+	mNumChunks = 0;
+}
+
+std::string OutOfCoreMesh::path(const char* name) const {
+	return mDirectory + "/" + name;
+}
+
+bool OutOfCoreMesh::open(const std::string& directory) {
+	close();
+	mDirectory = directory;
+	_OutOfCoreHeader header;
+	FILE* in = std::fopen(path("header.bin").c_str(), "rb");
+	if (!in) {
+		std::cout << __FUNCTION__ << ": no out-of-core mesh in " << directory << "\n";
+		return false;
+	}
+	bool read = std::fread(&header, sizeof(header), 1, in) == 1;
+	std::fclose(in);
+	if (!read || std::memcmp(header.magic, _OUT_OF_CORE_MAGIC, sizeof(header.magic)) != 0
+	    || header.chunkVertices <= 0) {
+		std::cout << __FUNCTION__ << ": bad header in " << directory << "\n";
+		return false;
+	}
+	mNumVertices = header.numVertices;
+	mNumFaces = header.numFaces;
+	mChunkVertices = header.chunkVertices;
+	mNumChunks = header.numChunks;
+
+	if (!mPositions.open(path("positions.bin"), true) || !mNormals.open(path("normals.bin"), true)
+	    || !mFaces.open(path("faces.bin"), false) || !mOrder.open(path("order.bin"), false)
+	    || !mChunkOffsets.open(path("chunk_offsets.bin"), false)
+	    || !mChunkFaces.open(path("chunk_faces.bin"), false)) {
+		std::cout << __FUNCTION__ << ": cannot map the files in " << directory << "\n";
+		close();
+		return false;
+	}
+	return true;
+}
+
+void OutOfCoreMesh::close() {
+	mPositions.close();
+	mNormals.close();
+	mFaces.close();
+	mOrder.close();
+	mChunkOffsets.close();
+	mChunkFaces.close();
+	mNumVertices = 0;
+	mNumFaces = 0;
+	mNumChunks = 0;
+}
+
+std::int64_t OutOfCoreMesh::numVertices() const {
+	return mNumVertices;
+}
+
+std::int64_t OutOfCoreMesh::numFaces() const {
+	return mNumFaces;
+}
+
+int OutOfCoreMesh::numChunks() const {
+	return mNumChunks;
+}
+
+std::int64_t OutOfCoreMesh::chunkBegin(int c) const {
+	return std::int64_t(c) * mChunkVertices;
+}
+
+std::int64_t OutOfCoreMesh::chunkEnd(int c) const {
+	return std::min(std::int64_t(c + 1) * mChunkVertices, mNumVertices);
+}
+
+const float* OutOfCoreMesh::positions() const {
+	return mPositions.as< const float >();
+}
+
+const float* OutOfCoreMesh::normals() const {
+	return mNormals.as< const float >();
+}
+
+const int* OutOfCoreMesh::faces() const {
+	return mFaces.as< const int >();
+}
+
+const int* OutOfCoreMesh::originalIndices() const {
+	return mOrder.as< const int >();
+}
+
+/* In-memory working set of one chunk: its own vertices first, then the
+ * halo vertices of other chunks its faces reach. */
+struct OutOfCoreMesh::Chunk {
+	std::int64_t begin = 0;
+	std::int64_t end = 0;
+	std::vector< int > halo;        // global indices, sorted
+	std::vector< int > faces;       // local indices
+	std::vector< float > positions; // xyz per local vertex
+
+	int numOwned() const {
+		return int(end - begin);
+	}
+	int numLocal() const {
+		return numOwned() + halo.size();
+	}
+};
+
+void OutOfCoreMesh::loadChunk(int c, const float* positions, Chunk& chunk) const {
+	chunk.begin = chunkBegin(c);
+	chunk.end = chunkEnd(c);
+	const std::int64_t* offsets = mChunkOffsets.as< const std::int64_t >();
+	const int* list = mChunkFaces.as< const int >() + offsets[c];
+	int numFaces = int(offsets[c + 1] - offsets[c]);
+	const int* F = faces();
+
+	chunk.halo.clear();
+	for (int i = 0; i < numFaces; ++i) {
+		const int* face = F + 3 * std::int64_t(list[i]);
+		for (int k = 0; k < 3; ++k) {
+			if (face[k] < chunk.begin || face[k] >= chunk.end) {
+				chunk.halo.push_back(face[k]);
+			}
+		}
+	}
+	std::sort(chunk.halo.begin(), chunk.halo.end());
+	chunk.halo.erase(std::unique(chunk.halo.begin(), chunk.halo.end()), chunk.halo.end());
+
+	int owned = chunk.numOwned();
+	chunk.faces.resize(3 * numFaces);
+	for (int i = 0; i < numFaces; ++i) {
+		const int* face = F + 3 * std::int64_t(list[i]);
+		for (int k = 0; k < 3; ++k) {
+			int v = face[k];
+			if (v >= chunk.begin && v < chunk.end) {
+				chunk.faces[3 * i + k] = int(v - chunk.begin);
+			} else {
+				chunk.faces[3 * i + k] = owned + int(std::lower_bound(chunk.halo.begin(), chunk.halo.end(), v)
+				                                     - chunk.halo.begin());
+			}
+		}
+	}
+
+	// Halo exchange: the only reads outside the chunk's own range
+	chunk.positions.resize(3 * chunk.numLocal());
+	std::memcpy(chunk.positions.data(), positions + 3 * chunk.begin, 3 * owned * sizeof(float));
+	for (int h = 0; h < (int)chunk.halo.size(); ++h) {
+		std::memcpy(&chunk.positions[3 * (owned + h)], positions + 3 * std::int64_t(chunk.halo[h]),
+		            3 * sizeof(float));
+	}
+}
+
+static void _sub(const float* a, const float* b, double* out) {
+	for (int k = 0; k < 3; ++k) {
+		out[k] = double(a[k]) - double(b[k]);
+	}
+}
+
+static void _cross(const double* a, const double* b, double* out) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void OutOfCoreMesh::computeVertexNormals() {
+	float* N = mNormals.as< float >();
+	const std::int64_t* offsets = mChunkOffsets.as< const std::int64_t >();
+	ThreadPool::global().parallelFor(mNumChunks, [&](int c) {
+		Chunk chunk;
+		loadChunk(c, positions(), chunk);
+		int owned = chunk.numOwned();
+		std::vector< double > normals(3 * owned, 0.0);
+		const float* P = chunk.positions.data();
+		for (int i = 0; i < (int)chunk.faces.size(); i += 3) {
+			const int* face = &chunk.faces[i];
+			double e1[3], e2[3], n[3];
+			_sub(P + 3 * face[1], P + 3 * face[0], e1);
+			_sub(P + 3 * face[2], P + 3 * face[0], e2);
+			// Twice the area times the unit normal
+			_cross(e1, e2, n);
+			for (int k = 0; k < 3; ++k) {
+				if (face[k] < owned) {
+					for (int d = 0; d < 3; ++d) {
+						normals[3 * face[k] + d] += n[d];
+					}
+				}
+			}
+		}
+		float* out = N + 3 * chunk.begin;
+		for (int v = 0; v < owned; ++v) {
+			double* n = &normals[3 * v];
+			double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int d = 0; d < 3; ++d) {
+				out[3 * v + d] = length > 0.0 ? float(n[d] / length) : 0.0f;
+			}
+		}
+		mNormals.release(3 * chunk.begin * sizeof(float), 3 * owned * sizeof(float));
+		mChunkFaces.release(offsets[c] * sizeof(int), (offsets[c + 1] - offsets[c]) * sizeof(int));
+	});
+}
+
+void OutOfCoreMesh::umbrellaSmooth(bool cotangentWeights, double lambda, int iterations) {
+	if (iterations <= 0 || mNumVertices == 0) {
+		return;
+	}
+	MappedFile scratch;
+	if (!scratch.create(path("positions.next"), mPositions.size())) {
+		std::cout << __FUNCTION__ << ": cannot create the scratch positions\n";
+		return;
+	}
+
+	struct Weight {
+		int row;
+		int col;
+		double weight;
+		bool operator<(const Weight& other) const {
+			return row != other.row ? row < other.row : col < other.col;
+		}
+	};
+
+	MappedFile* source = &mPositions;
+	MappedFile* target = &scratch;
+	for (int it = 0; it < iterations; ++it) {
+		const float* X = source->as< const float >();
+		float* Y = target->as< float >();
+		ThreadPool::global().parallelFor(mNumChunks, [&](int c) {
+			Chunk chunk;
+			loadChunk(c, X, chunk);
+			int owned = chunk.numOwned();
+			const float* P = chunk.positions.data();
+
+			// Directed one-ring edges of the owned vertices with their weights
+			std::vector< Weight > weights;
+			weights.reserve(2 * chunk.faces.size());
+			for (int i = 0; i < (int)chunk.faces.size(); i += 3) {
+				const int* face = &chunk.faces[i];
+				for (int k = 0; k < 3; ++k) {
+					int a = face[k];
+					int b = face[(k + 1) % 3];
+					double w = 1.0;
+					if (cotangentWeights) {
+						// Cotangent of the angle opposite to edge ab
+						int o = face[(k + 2) % 3];
+						double u[3], v[3], n[3];
+						_sub(P + 3 * a, P + 3 * o, u);
+						_sub(P + 3 * b, P + 3 * o, v);
+						_cross(u, v, n);
+						double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+						w = area > 0.0 ? (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) / area : 0.0;
+					}
+					if (a < owned) {
+						weights.push_back(Weight{a, b, w});
+					}
+					if (b < owned) {
+						weights.push_back(Weight{b, a, w});
+					}
+				}
+			}
+			std::sort(weights.begin(), weights.end());
+
+			float* out = Y + 3 * chunk.begin;
+			std::memcpy(out, P, 3 * owned * sizeof(float));
+			for (int e = 0; e < (int)weights.size();) {
+				int row = weights[e].row;
+				double total = 0.0;
+				double sum[3] = {0.0, 0.0, 0.0};
+				while (e < (int)weights.size() && weights[e].row == row) {
+					int col = weights[e].col;
+					double w = 0.0;
+					// Both faces of an edge add up for cotangents; the
+					// uniform weight counts every neighbor once
+					for (; e < (int)weights.size() && weights[e].row == row && weights[e].col == col; ++e) {
+						w = cotangentWeights ? w + weights[e].weight : 1.0;
+					}
+					total += w;
+					for (int d = 0; d < 3; ++d) {
+						sum[d] += w * P[3 * col + d];
+					}
+				}
+				if (total != 0.0) {
+					for (int d = 0; d < 3; ++d) {
+						out[3 * row + d] = float(P[3 * row + d] + lambda * (sum[d] / total - P[3 * row + d]));
+					}
+				}
+			}
+			source->release(3 * chunk.begin * sizeof(float), 3 * owned * sizeof(float));
+		});
+		std::swap(source, target);
+	}
+
+	// The result of an odd number of steps sits in the scratch file
+	if (source != &mPositions) {
+		std::memcpy(mPositions.data(), source->data(), mPositions.size());
+	}
+	scratch.close();
+	std::remove(path("positions.next").c_str());
+	computeVertexNormals();
+}
+
+static int _find(int* parent, int v) {
+	while (parent[v] != v) {
+		parent[v] = parent[parent[v]];
+		v = parent[v];
+	}
+	return v;
+}
+
+std::vector< std::int64_t > OutOfCoreMesh::collectMeshStats() {
+	// Boundary edges are those with one face; each chunk counts the edges
+	// whose lower vertex it owns, all of whose faces it lists
+	std::vector< std::pair< int, int > > boundary;
+	std::mutex boundaryMutex;
+	ThreadPool::global().parallelFor(mNumChunks, [&](int c) {
+		const std::int64_t* offsets = mChunkOffsets.as< const std::int64_t >();
+		const int* list = mChunkFaces.as< const int >();
+		const int* F = faces();
+		std::int64_t begin = chunkBegin(c);
+		std::int64_t end = chunkEnd(c);
+		std::vector< std::uint64_t > edges;
+		for (std::int64_t i = offsets[c]; i < offsets[c + 1]; ++i) {
+			const int* face = F + 3 * std::int64_t(list[i]);
+			for (int k = 0; k < 3; ++k) {
+				std::uint32_t a = std::min(face[k], face[(k + 1) % 3]);
+				std::uint32_t b = std::max(face[k], face[(k + 1) % 3]);
+				if (a >= begin && a < end) {
+					edges.push_back(std::uint64_t(a) << 32 | b);
+				}
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		std::vector< std::pair< int, int > > local;
+		for (int e = 0; e < (int)edges.size();) {
+			int count = 1;
+			while (e + count < (int)edges.size() && edges[e + count] == edges[e]) {
+				++count;
+			}
+			if (count == 1) {
+				local.push_back(std::make_pair(int(edges[e] >> 32), int(edges[e] & 0xffffffff)));
+			}
+			e += count;
+		}
+		std::lock_guard< std::mutex > lock(boundaryMutex);
+		boundary.insert(boundary.end(), local.begin(), local.end());
+	});
+
+	// Boundary loops: components of the boundary edge graph
+	std::unordered_map< int, int > loopIds;
+	for (const std::pair< int, int >& edge : boundary) {
+		loopIds.insert(std::make_pair(edge.first, int(loopIds.size())));
+		loopIds.insert(std::make_pair(edge.second, int(loopIds.size())));
+	}
+	std::vector< int > loopParent(loopIds.size());
+	for (int i = 0; i < (int)loopParent.size(); ++i) {
+		loopParent[i] = i;
+	}
+	for (const std::pair< int, int >& edge : boundary) {
+		int a = _find(loopParent.data(), loopIds[edge.first]);
+		int b = _find(loopParent.data(), loopIds[edge.second]);
+		loopParent[a] = b;
+	}
+	std::int64_t B = 0;
+	for (int i = 0; i < (int)loopParent.size(); ++i) {
+		B += loopParent[i] == i;
+	}
+
+	// Connected components with the union-find array out of core
+	std::int64_t C = 0;
+	MappedFile scratch;
+	if (scratch.create(path("components.scratch"), mNumVertices * sizeof(int))) {
+		int* parent = scratch.as< int >();
+		for (std::int64_t v = 0; v < mNumVertices; ++v) {
+			parent[v] = int(v);
+		}
+		const int* F = faces();
+		for (std::int64_t f = 0; f < mNumFaces; ++f) {
+			int a = _find(parent, F[3 * f]);
+			for (int k = 1; k < 3; ++k) {
+				int b = _find(parent, F[3 * f + k]);
+				if (a != b) {
+					parent[b] = a;
+				}
+			}
+		}
+		for (std::int64_t v = 0; v < mNumVertices; ++v) {
+			C += _find(parent, int(v)) == v;
+		}
+		scratch.close();
+		std::remove(path("components.scratch").c_str());
+	}
+
+	std::int64_t V = mNumVertices;
+	std::int64_t E = 3 * mNumFaces + boundary.size();
+	std::int64_t F = mNumFaces;
+	std::int64_t G = (E / 2 - V - F - B) / 2 + C;
+
+	std::vector< std::int64_t > stats;
+	stats.push_back(V);
+	stats.push_back(E);
+	stats.push_back(F);
+	stats.push_back(B);
+	stats.push_back(C);
+	stats.push_back(G);
+	return stats;
+}
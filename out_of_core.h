@@ -0,0 +1,129 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* A file mapped into memory. Pages are loaded on first access and can be
+ * dropped again by the OS, so a mapping may be far larger than RAM. */
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	/* Map an existing file, read-only or read-write. */
+	bool open(const std::string& path, bool writable);
+	/* Create or truncate the file to bytes zero bytes and map it read-write. */
+	bool create(const std::string& path, std::int64_t bytes);
+	void close();
+
+	bool isOpen() const;
+	std::int64_t size() const;
+	char* data() const;
+	template < class T >
+	T* as() const {
+		return reinterpret_cast< T* >(mData);
+	}
+
+	/* Hint that a range is not needed for a while, so its pages may leave
+	 * the resident set. Written data is kept. */
+	void release(std::int64_t offset, std::int64_t bytes) const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	char* mData;
+	std::int64_t mSize;
+#ifdef _WIN32
+	void* mFile;
+	void* mMapping;
+#else
+	int mFd;
+#endif
+};
+
+/* Out-of-core triangle mesh for meshes larger than RAM.
+ *
+ * Positions, normals and connectivity live in memory-mapped files in one
+ * directory. convert() reorders the vertices along a Morton curve and
+ * cuts them into chunks of chunkVertices consecutive vertices, so every
+ * chunk is spatially compact; faces are stored grouped by the chunk of
+ * their lowest vertex, and every chunk lists all faces touching it.
+ *
+ * The streaming algorithms work on one chunk at a time: its faces and
+ * positions are gathered into a small in-memory buffer together with
+ * the halo, i.e. the vertices of those faces owned by other chunks,
+ * which is the only data exchanged between chunks. Results are written
+ * back to the chunk's own range only, and chunks are processed in
+ * parallel, so memory use is bounded by chunk size times threads.
+ *
+ * Weights follow the faces, so at the boundary cotangent weights and
+ * normals use only the faces actually present, unlike the wrap-around
+ * of the in-core Mesh versions. Vertex order is the Morton order;
+ * originalIndices() maps back to the input file. */
+class OutOfCoreMesh {
+public:
+	OutOfCoreMesh();
+
+	/* Stream an OBJ file into directory, which must exist. Polygons are
+	 * fan-triangulated. Uses O(vertices) memory for the reordering but
+	 * never holds the faces. Fails if chunkVertices is not positive or a
+	 * face refers to a vertex not defined before it. */
+	static bool convert(const std::string& objFile,
+	                    const std::string& directory,
+	                    int chunkVertices = 1 << 20);
+
+	bool open(const std::string& directory);
+	void close();
+
+	std::int64_t numVertices() const;
+	std::int64_t numFaces() const;
+	int numChunks() const;
+	/* Vertex range [chunkBegin(c), chunkEnd(c)) owned by chunk c. */
+	std::int64_t chunkBegin(int c) const;
+	std::int64_t chunkEnd(int c) const;
+
+	/* Mapped arrays: xyz per vertex and three vertex indices per face. */
+	const float* positions() const;
+	const float* normals() const;
+	const int* faces() const;
+	/* Index of every vertex in the input file. */
+	const int* originalIndices() const;
+
+	/* Area-weighted vertex normals. */
+	void computeVertexNormals();
+
+	/* Explicit umbrella steps x += lambda * L x. Every step reads the
+	 * previous positions, halo included, and writes a second file that
+	 * then becomes the current one. Normals are recomputed afterwards. */
+	void umbrellaSmooth(bool cotangentWeights = true, double lambda = 1.0, int iterations = 1);
+
+	/* Same quantities, in the same order, as Mesh::collectMeshStats:
+	 * vertices, half-edges, faces, boundary loops, connected components
+	 * and genus. Components use a union-find array in a mapped scratch
+	 * file. */
+	std::vector< std::int64_t > collectMeshStats();
+
+private:
+	struct Chunk;
+
+	void loadChunk(int c, const float* positions, Chunk& chunk) const;
+	std::string path(const char* name) const;
+
+	std::string mDirectory;
+	std::int64_t mNumVertices;
+	std::int64_t mNumFaces;
+	int mChunkVertices;
+	int mNumChunks;
+
+	MappedFile mPositions;
+	MappedFile mNormals;
+	MappedFile mFaces;
+	MappedFile mOrder;
+	MappedFile mChunkOffsets; // numChunks + 1 offsets into mChunkFaces
+	MappedFile mChunkFaces;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "perf_counters.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#if defined(MESH_PERF) && defined(__linux__)
+#define PERF_EVENTS_SUPPORTED
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const COUNTER_NAMES[PERF_COUNTER_COUNT] = {
+	"cycles", "instructions", "llcMisses", "branchMisses", "dtlbMisses"};
+
+const char* perfCounterName(int counter) {
+	return counter >= 0 && counter < PERF_COUNTER_COUNT ? COUNTER_NAMES[counter] : "";
+}
+
+static std::mutex _totalsMutex;
+// Transparent comparator: looking a scope up by its const char* name
+// must not build a string, or every scope would allocate
+static std::map< std::string, PerfKernelStats, std::less<> > _totals;
+
+#ifdef PERF_EVENTS_SUPPORTED
+
+/* Counters of one thread, opened as one group where the PMU allows, so a
+ * single read returns all of them. A counter that cannot join the group
+ * is opened on its own and read separately. fds stay open after the
+ * thread exits, so its totals still add up, they just stop growing. */
+struct _ThreadCounters {
+	int group = -1;                // leader fd of the group
+	int slots[PERF_COUNTER_COUNT]; // position in the group read, or -1
+	int fds[PERF_COUNTER_COUNT];   // counters outside the group, or -1
+};
+
+/* Attached threads, append-only. Scopes read them without a lock: an
+ * entry is filled before the count that publishes it. */
+static const int MAX_ATTACHED_THREADS = 1024;
+static std::mutex _attachMutex;
+static _ThreadCounters* _threads[MAX_ATTACHED_THREADS];
+static std::atomic< int > _numThreads(0);
+static std::atomic< bool > _available(false);
+
+/* Open a counter of the calling thread: as the leader of a new group when
+ * group is -1 and leader is set, as a member of group, or on its own. */
+static int _open(std::uint32_t type, std::uint64_t config, int group, bool leader) {
+	perf_event_attr attr;
+	std::fill(reinterpret_cast< char* >(&attr), reinterpret_cast< char* >(&attr) + sizeof(attr), 0);
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+	                   | (leader ? PERF_FORMAT_GROUP : 0);
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static std::uint64_t _cacheMiss(std::uint64_t cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+void perfThreadAttach() {
+	thread_local bool attached = false;
+	if (attached) {
+		return;
+	}
+	attached = true;
+	const std::uint32_t types[PERF_COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+	                                                 PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+	const std::uint64_t configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	                                                   _cacheMiss(PERF_COUNT_HW_CACHE_LL), PERF_COUNT_HW_BRANCH_MISSES,
+	                                                   _cacheMiss(PERF_COUNT_HW_CACHE_DTLB)};
+	std::unique_ptr< _ThreadCounters > counters(new _ThreadCounters);
+	int numSlots = 0;
+	bool any = false;
+	for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+		counters->slots[c] = -1;
+		counters->fds[c] = -1;
+		// The kernel refuses a member the group could never be scheduled with
+		int fd = _open(types[c], configs[c], counters->group, counters->group < 0);
+		if (fd >= 0) {
+			counters->group = counters->group < 0 ? fd : counters->group;
+			counters->slots[c] = numSlots++;
+		} else if (counters->group >= 0) {
+			counters->fds[c] = _open(types[c], configs[c], -1, false);
+		}
+		any = any || counters->slots[c] >= 0 || counters->fds[c] >= 0;
+	}
+	if (!any) {
+		return;
+	}
+	std::lock_guard< std::mutex > lock(_attachMutex);
+	int count = _numThreads.load(std::memory_order_relaxed);
+	if (count < MAX_ATTACHED_THREADS) {
+		_threads[count] = counters.release();
+		_numThreads.store(count + 1, std::memory_order_release);
+		_available = true;
+	}
+}
+
+bool perfCountersAvailable() {
+	perfThreadAttach();
+	return _available;
+}
+
+/* Sum of the scaled counts over every attached thread: one read per
+ * thread for its group, plus one per counter left outside it. */
+static void _read(double* values) {
+	std::fill(values, values + PERF_COUNTER_COUNT, 0.0);
+	int count = _numThreads.load(std::memory_order_acquire);
+	for (int t = 0; t < count; ++t) {
+		const _ThreadCounters& counters = *_threads[t];
+		// nr, time enabled, time running, then one value per member
+		std::uint64_t group[3 + PERF_COUNTER_COUNT];
+		ssize_t size = read(counters.group, group, sizeof(group));
+		if (size >= ssize_t(3 * sizeof(std::uint64_t)) && group[2]) {
+			double scale = double(group[1]) / double(group[2]);
+			for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+				if (counters.slots[c] >= 0 && std::uint64_t(counters.slots[c]) < group[0]) {
+					values[c] += double(group[3 + counters.slots[c]]) * scale;
+				}
+			}
+		}
+		for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+			std::uint64_t data[3]; // value, time enabled, time running
+			if (counters.fds[c] >= 0 && read(counters.fds[c], data, sizeof(data)) == sizeof(data) && data[2]) {
+				values[c] += double(data[0]) * double(data[1]) / double(data[2]);
+			}
+		}
+	}
+}
+
+#else
+
+void perfThreadAttach() {
+}
+
+bool perfCountersAvailable() {
+	return false;
+}
+
+#ifdef MESH_PERF
+static void _read(double* values) {
+	std::fill(values, values + PERF_COUNTER_COUNT, 0.0);
+}
+#endif
+
+#endif
+
+#ifdef MESH_PERF
+
+PerfScope::PerfScope(const char* name) : mName(name), mActive(perfCountersAvailable()) {
+	if (mActive) {
+		_read(mStart);
+	}
+}
+
+PerfScope::~PerfScope() {
+	if (!mActive) {
+		return;
+	}
+	double values[PERF_COUNTER_COUNT];
+	_read(values);
+	for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+		values[c] = std::max(0.0, values[c] - mStart[c]);
+	}
+	{
+		std::lock_guard< std::mutex > lock(_totalsMutex);
+		auto found = _totals.find(mName);
+		if (found == _totals.end()) {
+			found = _totals.emplace(mName, PerfKernelStats()).first;
+			found->second.name = mName;
+		}
+		PerfKernelStats& stats = found->second;
+		++stats.calls;
+		for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+			stats.values[c] += values[c];
+		}
+	}
+#ifdef MESH_TRACE
+	traceCounters(mName, traceNow(), COUNTER_NAMES, values, PERF_COUNTER_COUNT);
+#endif
+}
+
+#endif
+
+std::vector< PerfKernelStats > perfCounterTotals() {
+	std::lock_guard< std::mutex > lock(_totalsMutex);
+	std::vector< PerfKernelStats > totals;
+	for (const std::pair< const std::string, PerfKernelStats >& entry : _totals) {
+		totals.push_back(entry.second);
+	}
+	return totals;
+}
+
+void resetPerfCounters() {
+	std::lock_guard< std::mutex > lock(_totalsMutex);
+	_totals.clear();
+}
+
+std::string perfCountersJson() {
+	std::ostringstream out;
+	out.precision(15);
+	out << "{";
+	std::vector< PerfKernelStats > totals = perfCounterTotals();
+	for (size_t i = 0; i < totals.size(); ++i) {
+		out << (i ? ", " : "") << "\"" << totals[i].name << "\": {\"calls\": " << totals[i].calls;
+		for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+			out << ", \"" << COUNTER_NAMES[c] << "\": " << (long long)totals[i].values[c];
+		}
+		out << "}";
+	}
+	out << "}";
+	return out.str();
+}
@@ -0,0 +1,86 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+
+/* Hardware performance counters around the mesh kernels, from Linux
+ * perf_event_open, to show what a layout change does to cache and TLB
+ * misses rather than only to wall time.
+ *
+ * Every thread that takes part opens its own user-space counters, as one
+ * group where the PMU allows: the pool workers when they start and any
+ * other thread at its first scope. A PERF_SCOPE reads the counters of all
+ * those threads on entry and on exit, without a lock, so the work a
+ * kernel hands to the pool is included, and so is whatever else runs
+ * concurrently. That is one read syscall per thread at each end, so
+ * scopes belong on whole kernels (a solve, a smoothing call), never on a
+ * product or anything else run once per solver iteration. Counters the
+ * PMU has to multiplex are scaled by their enabled / running time. The
+ * deltas are summed per scope name and, in MESH_TRACE builds, also
+ * emitted as trace counter events.
+ *
+ * Built with MESH_PERF defined; otherwise PERF_SCOPE expands to nothing.
+ * Where the counters cannot be opened (other systems, containers, a
+ * restrictive perf_event_paranoid) perfCountersAvailable() is false and
+ * nothing is recorded. */
+
+enum PerfCounter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_COUNTER_COUNT
+};
+
+/* Name used in the JSON output, e.g. "llcMisses". */
+const char* perfCounterName(int counter);
+
+struct PerfKernelStats {
+	std::string name;
+	long long calls = 0;
+	double values[PERF_COUNTER_COUNT] = {};
+};
+
+bool perfCountersAvailable();
+
+/* Open counters for the calling thread if it has none yet. */
+void perfThreadAttach();
+
+/* Totals per scope name since the last reset, sorted by name. */
+std::vector< PerfKernelStats > perfCounterTotals();
+void resetPerfCounters();
+/* {"name": {"calls": n, "cycles": ..., ...}, ...} */
+std::string perfCountersJson();
+
+#ifdef MESH_PERF
+
+class PerfScope {
+public:
+	/* The name is copied when the scope ends. */
+	explicit PerfScope(const char* name);
+	~PerfScope();
+
+	PerfScope(const PerfScope&) = delete;
+	PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+	const char* mName;
+	bool mActive;
+	double mStart[PERF_COUNTER_COUNT];
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_SCOPE(name) PerfScope PERF_CONCAT(_perfScope, __LINE__)(name)
+#define PERF_THREAD_ATTACH() perfThreadAttach()
+
+#else
+
+#define PERF_SCOPE(name)
+#define PERF_THREAD_ATTACH()
+
+#endif
+
+#endif
@@ -0,0 +1,254 @@
+"""NumPy views of meshes processed by the native kernels.
+
+Wraps the C interface in mesh_python.h. The positions, normals, colors and
+faces properties are NumPy arrays aliasing native buffers, so taking a view
+copies nothing:
+
+    import mesh_numpy
+    mesh = mesh_numpy.Mesh("bunny.obj")
+    mesh.positions[:, 2] *= 2.0         # edits the native buffer
+    reply = mesh.smooth("implicit", cotangent=True, lam=1.0)
+    print(reply["seconds"], mesh.normals[:3])
+
+The native mesh does not live in these buffers, though, so every call
+pays a pass over all vertices. Each smooth(), stats() and commit()
+compares the positions and colors of every vertex with the mesh and
+copies the changed ones in. Each smooth() and reset() then copies all
+positions and normals back out, 24 bytes per vertex. normals and faces
+are read-only views.
+
+A view keeps its buffers alive on its own, even past the Mesh. load()
+gives the mesh fresh buffers, so views taken before it keep showing the
+previous mesh, and edits made through them no longer reach the native
+mesh. Every native call releases the GIL, so smoothing in one thread does
+not block the others, but a view should not be read while a smooth() on
+its mesh is running.
+
+The shared library is built from the mesh sources including
+mesh_python.cpp and found through MESH_LIBRARY, or as libmesh.so,
+libmesh.dylib or mesh.dll next to this file.
+"""
+
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+SMOOTH_METHODS = {
+    "explicit": 0,
+    "implicit": 1,
+    "taubin": 2,
+    "chebyshev": 3,
+    "gauss-seidel": 4,
+    "constrained": 5,
+}
+
+
+class _SmoothRequest(ctypes.Structure):
+    _fields_ = [
+        ("method", ctypes.c_uint8),
+        ("cotangentWeights", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint16),
+        ("iterations", ctypes.c_uint32),
+        ("degree", ctypes.c_uint32),
+        ("lambda_", ctypes.c_float),
+        ("mu", ctypes.c_float),
+        ("passBand", ctypes.c_float),
+    ]
+
+
+class _SmoothReply(ctypes.Structure):
+    _fields_ = [
+        ("seconds", ctypes.c_double),
+        ("solverIterations", ctypes.c_uint32),
+        ("laplacianBuilds", ctypes.c_uint32),
+        ("factorizations", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+    ]
+
+
+class _MeshServiceInfo(ctypes.Structure):
+    _fields_ = [
+        ("stats", ctypes.c_int32 * 6),
+        ("meshBytes", ctypes.c_uint64),
+        ("cacheBytes", ctypes.c_uint64),
+    ]
+
+
+def _library_path():
+    path = os.environ.get("MESH_LIBRARY")
+    if path:
+        return path
+    if sys.platform == "win32":
+        name = "mesh.dll"
+    elif sys.platform == "darwin":
+        name = "libmesh.dylib"
+    else:
+        name = "libmesh.so"
+    return os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+
+
+def _load_library():
+    # CDLL, unlike PyDLL, releases the GIL for the duration of every call
+    lib = ctypes.CDLL(_library_path())
+    handle = ctypes.c_void_p
+    signatures = {
+        "meshPyCreate": (handle, []),
+        "meshPyDestroy": (None, [handle]),
+        "meshPyError": (ctypes.c_char_p, [handle]),
+        "meshPyLoad": (ctypes.c_int, [handle, ctypes.c_char_p]),
+        "meshPyNumVertices": (ctypes.c_int, [handle]),
+        "meshPyNumFaces": (ctypes.c_int, [handle]),
+        "meshPyAcquireBuffers": (ctypes.c_void_p, [handle]),
+        "meshPyReleaseBuffers": (None, [ctypes.c_void_p]),
+        "meshPyBuffersNumVertices": (ctypes.c_int, [ctypes.c_void_p]),
+        "meshPyBuffersNumFaces": (ctypes.c_int, [ctypes.c_void_p]),
+        "meshPyPositions": (ctypes.POINTER(ctypes.c_float), [ctypes.c_void_p]),
+        "meshPyNormals": (ctypes.POINTER(ctypes.c_float), [ctypes.c_void_p]),
+        "meshPyColors": (ctypes.POINTER(ctypes.c_float), [ctypes.c_void_p]),
+        "meshPyFaces": (ctypes.POINTER(ctypes.c_int), [ctypes.c_void_p]),
+        "meshPyCommit": (ctypes.c_int, [handle]),
+        "meshPySmooth": (ctypes.c_int, [handle, ctypes.POINTER(_SmoothRequest),
+                                        ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+                                        ctypes.POINTER(_SmoothReply)]),
+        "meshPyStats": (ctypes.c_int, [handle, ctypes.POINTER(_MeshServiceInfo)]),
+        "meshPyReset": (ctypes.c_int, [handle]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    return lib
+
+
+_lib = _load_library()
+
+
+class _Buffers(object):
+    """One native reference to the buffers of a load, released when the
+    last view using it is gone."""
+
+    def __init__(self, handle):
+        self._buffers = _lib.meshPyAcquireBuffers(handle)
+
+    def __del__(self):
+        buffers, self._buffers = getattr(self, "_buffers", None), None
+        if buffers:
+            _lib.meshPyReleaseBuffers(buffers)
+
+
+class Mesh(object):
+    """A mesh loaded into native memory, with cached Laplacians and
+    factorizations kept between smoothing calls."""
+
+    def __init__(self, filename=None):
+        self._handle = _lib.meshPyCreate()
+        if filename is not None:
+            self.load(filename)
+
+    def __del__(self):
+        handle, self._handle = getattr(self, "_handle", None), None
+        if handle:
+            _lib.meshPyDestroy(handle)
+
+    def _check(self, ok):
+        if not ok:
+            raise RuntimeError(_lib.meshPyError(self._handle).decode())
+
+    def _view(self, name, faces=False, writeable=True):
+        # A ctypes array over the native memory; NumPy takes it through the
+        # buffer protocol and keeps it, and it keeps the reference, alive
+        ctype, dtype = (ctypes.c_int, np.int32) if faces else (ctypes.c_float, np.float32)
+        buffers = _Buffers(self._handle)
+        rows = 0
+        if buffers._buffers:
+            count = _lib.meshPyBuffersNumFaces if faces else _lib.meshPyBuffersNumVertices
+            rows = count(buffers._buffers)
+        if not rows:
+            return np.zeros((0, 3), dtype)
+        pointer = getattr(_lib, name)(buffers._buffers)
+        buffer = (ctype * (rows * 3)).from_address(ctypes.addressof(pointer.contents))
+        buffer._owner = buffers
+        view = np.frombuffer(buffer, dtype=dtype).reshape(rows, 3)
+        view.flags.writeable = writeable
+        return view
+
+    def load(self, filename):
+        """Load a mesh file into fresh buffers. Views taken before keep
+        the previous data and are no longer tied to the mesh."""
+        self._check(_lib.meshPyLoad(self._handle, os.fsencode(filename)))
+
+    @property
+    def num_vertices(self):
+        return _lib.meshPyNumVertices(self._handle)
+
+    @property
+    def num_faces(self):
+        return _lib.meshPyNumFaces(self._handle)
+
+    @property
+    def positions(self):
+        """float32 array of shape (num_vertices, 3), writable."""
+        return self._view("meshPyPositions")
+
+    @property
+    def normals(self):
+        """float32 array of shape (num_vertices, 3), read-only; recomputed
+        by the kernels and by commit()."""
+        return self._view("meshPyNormals", writeable=False)
+
+    @property
+    def colors(self):
+        """float32 rgb array of shape (num_vertices, 3), writable."""
+        return self._view("meshPyColors")
+
+    @property
+    def faces(self):
+        """int32 array of shape (num_faces, 3) of vertex indices,
+        read-only; the connectivity is fixed."""
+        return self._view("meshPyFaces", faces=True, writeable=False)
+
+    def commit(self):
+        """Apply edits made through positions and colors to the mesh,
+        comparing every vertex."""
+        self._check(_lib.meshPyCommit(self._handle))
+
+    def smooth(self, method="implicit", cotangent=True, lam=1.0, mu=-0.53, band=0.25,
+               iterations=1, degree=10, pinned=None):
+        """Smooth in place with one of SMOOTH_METHODS; "constrained" keeps
+        the pinned vertex indices fixed. Returns timing and cache counters."""
+        request = _SmoothRequest()
+        request.method = SMOOTH_METHODS[method]
+        request.cotangentWeights = 1 if cotangent else 0
+        request.iterations = iterations
+        request.degree = degree
+        request.lambda_ = lam
+        request.mu = mu
+        request.passBand = band
+        pins = np.ascontiguousarray(pinned if pinned is not None else [], dtype=np.int32)
+        reply = _SmoothReply()
+        self._check(_lib.meshPySmooth(self._handle, ctypes.byref(request),
+                                      pins.ctypes.data_as(ctypes.POINTER(ctypes.c_int)), len(pins),
+                                      ctypes.byref(reply)))
+        return {
+            "seconds": reply.seconds,
+            "solver_iterations": reply.solverIterations,
+            "laplacian_builds": reply.laplacianBuilds,
+            "factorizations": reply.factorizations,
+        }
+
+    def stats(self):
+        """Vertex, edge, face, boundary loop, component and genus counts,
+        and the native bytes held for this mesh."""
+        info = _MeshServiceInfo()
+        self._check(_lib.meshPyStats(self._handle, ctypes.byref(info)))
+        names = ("vertices", "edges", "faces", "boundary_loops", "components", "genus")
+        stats = dict(zip(names, info.stats))
+        stats["mesh_bytes"] = info.meshBytes
+        stats["cache_bytes"] = info.cacheBytes
+        return stats
+
+    def reset(self):
+        """Restore the positions the mesh was loaded with."""
+        self._check(_lib.meshPyReset(self._handle))
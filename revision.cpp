@@ -0,0 +1,46 @@
+#include "revision.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+struct MeshRevisions {
+	Revision topology = 0;
+	Revision geometry = 0;
+};
+
+static std::atomic< Revision > gNextRevision(1);
+static std::mutex gRevisionMutex;
+static std::unordered_map< const Mesh*, MeshRevisions > gRevisions;
+
+Revision topologyRevision(const Mesh& mesh) {
+	std::lock_guard< std::mutex > lock(gRevisionMutex);
+	auto it = gRevisions.find(&mesh);
+	return it == gRevisions.end() ? 0 : it->second.topology;
+}
+
+Revision geometryRevision(const Mesh& mesh) {
+	std::lock_guard< std::mutex > lock(gRevisionMutex);
+	auto it = gRevisions.find(&mesh);
+	return it == gRevisions.end() ? 0 : it->second.geometry;
+}
+
+Revision bumpTopologyRevision(const Mesh& mesh) {
+	Revision revision = gNextRevision++;
+	std::lock_guard< std::mutex > lock(gRevisionMutex);
+	MeshRevisions& revisions = gRevisions[&mesh];
+	revisions.topology = revision;
+	revisions.geometry = revision;
+	return revision;
+}
+
+Revision bumpGeometryRevision(const Mesh& mesh) {
+	Revision revision = gNextRevision++;
+	std::lock_guard< std::mutex > lock(gRevisionMutex);
+	gRevisions[&mesh].geometry = revision;
+	return revision;
+}
+
+void forgetRevisions(const Mesh& mesh) {
+	std::lock_guard< std::mutex > lock(gRevisionMutex);
+	gRevisions.erase(&mesh);
+}
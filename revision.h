@@ -0,0 +1,41 @@
+#ifndef REVISION_H
+#define REVISION_H
+
+#include <cstdint>
+
+class Mesh;
+
+/* Change tracking for caches derived from a mesh.
+ *
+ * Every mesh has a topology revision, bumped whenever its connectivity
+ * is rebuilt, and a geometry revision, bumped whenever its positions
+ * change. Unlike the dirty flags, which belong to the renderer, any
+ * number of caches can remember the revisions they were built from and
+ * compare them later. All revisions are drawn from one process-wide
+ * counter, so they only ever increase and a value is never handed out
+ * twice, not even to a new mesh that reuses a freed address.
+ *
+ * Mesh::loadMeshFile and Mesh::clear bump the topology, which also
+ * bumps the geometry. Mesh::setVertexPosDirty(true) bumps the geometry.
+ * Vertex::setPosition does NOT: a vertex has no link to its mesh, so any
+ * code moving vertices must call setVertexPosDirty(true) once done, as
+ * every writer in this tree does. Skipping it leaves geometry caches
+ * silently stale. Code building faces with Mesh::addFace calls
+ * bumpTopologyRevision when done.
+ *
+ * The revisions live in a table keyed by mesh, since Mesh has no room
+ * for them; the table is thread-safe. A mesh that was never bumped
+ * reports revision 0. */
+typedef std::uint64_t Revision;
+
+Revision topologyRevision(const Mesh& mesh);
+Revision geometryRevision(const Mesh& mesh);
+
+/* Bump the topology, and with it the geometry. Returns the new revision. */
+Revision bumpTopologyRevision(const Mesh& mesh);
+Revision bumpGeometryRevision(const Mesh& mesh);
+
+/* Drop the entry of a mesh being destroyed. */
+void forgetRevisions(const Mesh& mesh);
+
+#endif
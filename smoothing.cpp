@@ -0,0 +1,403 @@
+#include "smoothing.h"
+#include "laplacian.h"
+#include "mesh.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+/* Gather vertex positions as an N x 3 double matrix. */
+static Eigen::MatrixXd _positions(const Mesh& mesh) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	Eigen::MatrixXd X(vertices.size(), 3);
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		X.row(i) = vertices[i]->position().cast< double >().transpose();
+	}
+	return X;
+}
+
+/* Write positions back and notify the shaders. */
+static void _setPositions(Mesh& mesh, const Eigen::MatrixXd& X) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		vertices[i]->setPosition(X.row(i).transpose().cast< float >());
+	}
+	mesh.computeVertexNormals();
+	mesh.setVertexPosDirty(true);
+}
+
+static void _implicitSmooth(Mesh& mesh,
+                            const Eigen::SparseMatrix< double >& L,
+                            const ImplicitSmoothOptions& options,
+                            std::chrono::steady_clock::time_point assemblyStart) {
+	int n = mesh.vertices().size();
+	Eigen::SparseMatrix< double > I(n, n);
+	I.setIdentity();
+	Eigen::SparseMatrix< float > A = (I - options.lambda * L).cast< float >();
+
+	Eigen::MatrixXd B = _positions(mesh);
+
+	SolveTrace trace;
+	trace.source = "implicitSmooth";
+	trace.assemblySeconds = std::chrono::duration< double >(
+		std::chrono::steady_clock::now() - assemblyStart).count();
+	Eigen::MatrixXd X;
+	solveColumns(A, B, X, options.solve, &trace);
+	reportSolveTrace(trace, options.solve);
+	_setPositions(mesh, X);
+}
+
+void implicitSmooth(Mesh& mesh, const ImplicitSmoothOptions& options) {
+	auto assemblyStart = std::chrono::steady_clock::now();
+	_implicitSmooth(mesh, umbrellaOperator(mesh, options.cotangentWeights), options, assemblyStart);
+}
+
+void implicitSmooth(Mesh& mesh, LaplacianCache& cache, const ImplicitSmoothOptions& options) {
+	TRACE_SCOPE("implicitSmooth");
+	auto assemblyStart = std::chrono::steady_clock::now();
+	_implicitSmooth(mesh, cache.matrix(mesh, options.cotangentWeights), options, assemblyStart);
+}
+
+/* Damped Chebyshev coefficients of h(t) on t in [lower, upper], scaled
+ * so the resulting polynomial is exactly 1 at t = 0. lower <= 0 <= upper
+ * and degree >= 0. Below 0, h is held at h(0). */
+template < class Response >
+static void _chebyshevCoefficients(const Response& h, int degree, double lower, double upper, std::vector< double >& c) {
+	const double pi = 3.14159265358979323846;
+	int numNodes = std::max(64, 4 * degree);
+	c.assign(degree + 1, 0.0);
+	for (int j = 0; j < numNodes; ++j) {
+		double theta = pi * (j + 0.5) / numNodes;
+		double t = lower + 0.5 * (std::cos(theta) + 1.0) * (upper - lower);
+		double value = h(std::max(t, 0.0));
+		for (int k = 0; k <= degree; ++k) {
+			c[k] += 2.0 / numNodes * value * std::cos(k * theta);
+		}
+	}
+	c[0] *= 0.5;
+
+	// Jackson damping against Gibbs oscillations
+	double a = pi / (degree + 2);
+	for (int k = 0; k <= degree; ++k) {
+		c[k] *= ((degree + 2 - k) * std::cos(k * a) + std::sin(k * a) / std::tan(a)) / (degree + 2);
+	}
+
+	// Value at t = 0, i.e. s0 = -(lower + upper) / (upper - lower), by the
+	// recurrence; s0 = -1 for [0, 2]
+	double s0 = -(lower + upper) / (upper - lower);
+	double prev = 1.0;
+	double curr = s0;
+	double dc = c[0];
+	for (int k = 1; k <= degree; ++k) {
+		dc += c[k] * curr;
+		double next = 2.0 * s0 * curr - prev;
+		prev = curr;
+		curr = next;
+	}
+	if (dc != 0.0) {
+		for (double& ck : c) {
+			ck /= dc;
+		}
+	}
+}
+
+/* Positions into an n x 3 workspace matrix, reusing its storage. */
+static void _gatherPositions(const std::vector< Vertex* >& vertices, VertexMatrix& X) {
+	X.resize(vertices.size(), 3);
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		X.row(i) = vertices[i]->position().transpose();
+	}
+}
+
+static void _scatterPositions(Mesh& mesh, const VertexMatrix& X) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	for (int i = 0; i < (int)vertices.size(); ++i) {
+		vertices[i]->setPosition(X.row(i).transpose());
+	}
+	mesh.computeVertexNormals();
+	mesh.setVertexPosDirty(true);
+}
+
+size_t SmoothingWorkspace::memoryBytes() const {
+	return sizeof(float) * (positions.size() + product.size() + prev.size() + curr.size() + next.size() + result.size())
+	       + sizeof(double) * coefficients.capacity();
+}
+
+void polynomialSmooth(Mesh& mesh, LaplacianCache& cache, const PolynomialSmoothOptions& options) {
+	SmoothingWorkspace workspace;
+	polynomialSmooth(mesh, cache, options, workspace);
+}
+
+void polynomialSmooth(Mesh& mesh, LaplacianCache& cache, const PolynomialSmoothOptions& options,
+                      SmoothingWorkspace& workspace) {
+	TRACE_SCOPE("polynomialSmooth");
+	PERF_SCOPE("polynomialSmooth");
+	const SellMatrix& L = cache.sell(mesh, options.cotangentWeights);
+	int n = mesh.vertices().size();
+
+	// A negative degree is an empty polynomial, i.e. no smoothing
+	int degree = std::max(0, options.degree);
+
+	VertexMatrix& X = workspace.positions;
+	VertexMatrix& LX = workspace.product;
+	_gatherPositions(mesh.vertices(), X);
+	LX.resize(n, 3);
+
+	if (options.filter == FILTER_TAUBIN) {
+		for (int k = 0; k < degree; ++k) {
+			L.multiply(X, LX);
+			X += float(k % 2 ? options.mu : options.lambda) * LX;
+		}
+	} else {
+		// The expansion interval must hold the whole spectrum of -L, or
+		// modes outside it grow like T_k. That is [0, 2] unless obtuse
+		// triangles made cotangent weights negative.
+		double lower = 0.0;
+		double upper = 2.0;
+		cache.eigenvalueBounds(mesh, options.cotangentWeights, lower, upper);
+		lower = std::min(lower, 0.0);
+		upper = std::max(upper, 2.0);
+
+		std::vector< double >& c = workspace.coefficients;
+		if (options.response) {
+			_chebyshevCoefficients(options.response, degree, lower, upper, c);
+		} else {
+			double passBand = options.passBand;
+			_chebyshevCoefficients([passBand](double t) { return 1.0 / (1.0 + std::pow(t / passBand, 4.0)); },
+			                       degree, lower, upper, c);
+		}
+
+		// Three-term recurrence in S = alpha (-L) - beta I, which maps
+		// [lower, upper] onto [-1, 1]; S = -L - I for [0, 2]:
+		// T_0 = X, T_1 = S X, T_k+1 = 2 S T_k - T_k-1
+		float alpha = float(2.0 / (upper - lower));
+		float beta = float((upper + lower) / (upper - lower));
+		VertexMatrix& prev = workspace.prev;
+		VertexMatrix& curr = workspace.curr;
+		VertexMatrix& next = workspace.next;
+		VertexMatrix& Y = workspace.result;
+		prev = X;
+		curr.resize(n, 3);
+		next.resize(n, 3);
+		Y.resize(n, 3);
+		Y = float(c[0]) * prev;
+		if (degree >= 1) {
+			L.multiply(prev, LX);
+			curr = -alpha * LX - beta * prev;
+			Y += float(c[1]) * curr;
+		}
+		for (int k = 2; k <= degree; ++k) {
+			L.multiply(curr, LX);
+			next = -2.0f * (alpha * LX + beta * curr) - prev;
+			Y += float(c[k]) * next;
+			prev.swap(curr);
+			curr.swap(next);
+		}
+		X = Y;
+	}
+
+	_scatterPositions(mesh, X);
+}
+
+void gaussSeidelSmooth(Mesh& mesh, LaplacianCache& cache, const GaussSeidelSmoothOptions& options) {
+	SmoothingWorkspace workspace;
+	gaussSeidelSmooth(mesh, cache, options, workspace);
+}
+
+void gaussSeidelSmooth(Mesh& mesh, LaplacianCache& cache, const GaussSeidelSmoothOptions& options,
+                       SmoothingWorkspace& workspace) {
+	TRACE_SCOPE("gaussSeidelSmooth");
+	PERF_SCOPE("gaussSeidelSmooth");
+	typedef Eigen::SparseMatrix< float, Eigen::RowMajor > RowMatrix;
+	const RowMatrix& L = cache.rows(mesh, options.cotangentWeights);
+	const VertexColoring& coloring = cache.coloring(mesh);
+
+	VertexMatrix& X = workspace.positions;
+	_gatherPositions(mesh.vertices(), X);
+
+	// Vertices per parallel task within a color class
+	const int CHUNK = 4096;
+	float lambda = options.lambda;
+	for (int sweep = 0; sweep < options.sweeps; ++sweep) {
+		for (int c = 0; c < coloring.numColors(); ++c) {
+			int begin = coloring.classOffsets[c];
+			int end = coloring.classOffsets[c + 1];
+			int numChunks = (end - begin + CHUNK - 1) / CHUNK;
+			ThreadPool::global().parallelFor(numChunks, [&](int chunk) {
+				int first = begin + chunk * CHUNK;
+				int last = std::min(end, first + CHUNK);
+				for (int k = first; k < last; ++k) {
+					int i = coloring.order[k];
+					Eigen::RowVector3f delta = Eigen::RowVector3f::Zero();
+					for (RowMatrix::InnerIterator it(L, i); it; ++it) {
+						delta += it.value() * X.row(it.col());
+					}
+					X.row(i) += lambda * delta;
+				}
+			});
+		}
+	}
+
+	_scatterPositions(mesh, X);
+}
+
+VertexRegion flaggedRegion(const Mesh& mesh, int flag) {
+	std::vector< int > selected;
+	for (Vertex* vertex : mesh.vertices()) {
+		if (flag == 0 ? vertex->flag() != 0 : vertex->flag() == flag) {
+			selected.push_back(vertex->index());
+		}
+	}
+	return vertexRegion(mesh, selected);
+}
+
+VertexRegion vertexRegion(const Mesh& mesh, const std::vector< int >& vertices) {
+	VertexRegion region;
+	int n = mesh.vertices().size();
+	for (int i : vertices) {
+		if (i < 0 || i >= n) {
+			std::cout << __FUNCTION__ << ": invalid vertex " << i << "\n";
+			return region;
+		}
+	}
+	std::unordered_set< int > interior;
+	for (int i : vertices) {
+		if (interior.insert(i).second) {
+			region.interior.push_back(i);
+		}
+	}
+	std::unordered_set< int > boundary;
+	for (int i : region.interior) {
+		OneRingVertex ring(mesh.vertices()[i]);
+		while (Vertex* neighbor = ring.nextVertex()) {
+			int j = neighbor->index();
+			if (!interior.count(j) && boundary.insert(j).second) {
+				region.boundary.push_back(j);
+			}
+		}
+	}
+	return region;
+}
+
+/* Local umbrella operator of a region: rows are the interior vertices,
+ * columns the interior followed by the boundary layer. */
+static Eigen::SparseMatrix< double > _regionOperator(const Mesh& mesh,
+                                                     const VertexRegion& region,
+                                                     bool cotangentWeights) {
+	int numInterior = region.interior.size();
+	int numLocal = numInterior + region.boundary.size();
+	std::unordered_map< int, int > local;
+	local.reserve(numLocal);
+	for (int k = 0; k < numInterior; ++k) {
+		local[region.interior[k]] = k;
+	}
+	for (int k = 0; k < (int)region.boundary.size(); ++k) {
+		local[region.boundary[k]] = numInterior + k;
+	}
+
+	std::vector< Eigen::Triplet< double > > triplets;
+	triplets.reserve(numInterior * 7);
+	std::vector< Vertex* > neighbors;
+	std::vector< double > weights;
+	for (int k = 0; k < numInterior; ++k) {
+		triplets.push_back(Eigen::Triplet< double >(k, k, -1.0));
+		umbrellaWeights(mesh.vertices()[region.interior[k]], cotangentWeights, neighbors, weights);
+		for (int j = 0; j < (int)neighbors.size(); ++j) {
+			triplets.push_back(Eigen::Triplet< double >(k, local[neighbors[j]->index()], weights[j]));
+		}
+	}
+	Eigen::SparseMatrix< double > L(numInterior, numLocal);
+	L.setFromTriplets(triplets.begin(), triplets.end());
+	return L;
+}
+
+/* Area-weighted vertex normal, the weighting Mesh::computeVertexNormals uses. */
+static Eigen::Vector3f _vertexNormal(const Vertex* center) {
+	Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+	HEdge* edge = center->halfEdge();
+	HEdge* curr = edge;
+	do {
+		HEdge* next = curr->twin()->next();
+		const Eigen::Vector3f& a = curr->end()->position();
+		const Eigen::Vector3f& b = next->end()->position();
+		float area = triangleArea(center->position(), b, a);
+		normal += triangleNormal(center->position(), b, a) * area;
+		curr = next;
+	} while (curr != edge);
+	return normal.normalized();
+}
+
+/* Write back the interior positions and refresh the normals the move
+ * can affect, i.e. those of the interior and its one-ring. */
+static void _setRegionPositions(Mesh& mesh, const VertexRegion& region, const Eigen::MatrixXd& X) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	for (int k = 0; k < (int)region.interior.size(); ++k) {
+		vertices[region.interior[k]]->setPosition(X.row(k).transpose().cast< float >());
+	}
+	for (int i : region.interior) {
+		vertices[i]->setNormal(_vertexNormal(vertices[i]));
+	}
+	for (int i : region.boundary) {
+		vertices[i]->setNormal(_vertexNormal(vertices[i]));
+	}
+	mesh.setVertexNormalDirty(true);
+	mesh.setVertexPosDirty(true);
+}
+
+/* Positions of the interior followed by the boundary layer. */
+static Eigen::MatrixXd _regionPositions(const Mesh& mesh, const VertexRegion& region) {
+	const std::vector< Vertex* >& vertices = mesh.vertices();
+	int numInterior = region.interior.size();
+	Eigen::MatrixXd X(numInterior + region.boundary.size(), 3);
+	for (int k = 0; k < numInterior; ++k) {
+		X.row(k) = vertices[region.interior[k]]->position().cast< double >().transpose();
+	}
+	for (int k = 0; k < (int)region.boundary.size(); ++k) {
+		X.row(numInterior + k) = vertices[region.boundary[k]]->position().cast< double >().transpose();
+	}
+	return X;
+}
+
+void regionUmbrellaSmooth(Mesh& mesh, const VertexRegion& region, bool cotangentWeights, double lambda) {
+	if (region.interior.empty()) {
+		return;
+	}
+	Eigen::SparseMatrix< double > L = _regionOperator(mesh, region, cotangentWeights);
+	Eigen::MatrixXd X = _regionPositions(mesh, region);
+	Eigen::MatrixXd Y = X.topRows(region.interior.size()) + lambda * (L * X);
+	_setRegionPositions(mesh, region, Y);
+}
+
+void regionImplicitSmooth(Mesh& mesh, const VertexRegion& region, const ImplicitSmoothOptions& options) {
+	if (region.interior.empty()) {
+		return;
+	}
+	auto assemblyStart = std::chrono::steady_clock::now();
+	int numInterior = region.interior.size();
+	int numBoundary = region.boundary.size();
+	Eigen::SparseMatrix< double > L = _regionOperator(mesh, region, options.cotangentWeights);
+	Eigen::MatrixXd X = _regionPositions(mesh, region);
+
+	Eigen::SparseMatrix< double > I(numInterior, numInterior);
+	I.setIdentity();
+	Eigen::SparseMatrix< double > L_II = L.leftCols(numInterior);
+	Eigen::SparseMatrix< float > A = (I - options.lambda * L_II).cast< float >();
+	Eigen::MatrixXd B = X.topRows(numInterior);
+	if (numBoundary > 0) {
+		Eigen::SparseMatrix< double > L_IB = L.rightCols(numBoundary);
+		B += options.lambda * (L_IB * X.bottomRows(numBoundary));
+	}
+
+	SolveTrace trace;
+	trace.source = "regionImplicitSmooth";
+	trace.assemblySeconds = std::chrono::duration< double >(
+		std::chrono::steady_clock::now() - assemblyStart).count();
+	Eigen::MatrixXd Y = B;
+	solveColumns(A, B, Y, options.solve, &trace);
+	reportSolveTrace(trace, options.solve);
+	_setRegionPositions(mesh, region, Y);
+}
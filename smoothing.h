@@ -0,0 +1,117 @@
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+
+#include "solver.h"
+#include <functional>
+#include <vector>
+
+class Mesh;
+class LaplacianCache;
+
+/* Configurable smoothing entry points complementing the Mesh members. */
+
+struct ImplicitSmoothOptions {
+	bool cotangentWeights = true;
+	double lambda = 1.0;
+	SolveOptions solve;
+};
+
+/* One implicit umbrella step, solving (I - lambda * L) x' = x. Set
+ * options.solve.precision to SOLVER_MIXED for double-accurate results
+ * from float matrix storage. The solve trace goes to
+ * options.solve.traceCallback. Normals are recomputed afterwards. */
+void implicitSmooth(Mesh& mesh, const ImplicitSmoothOptions& options);
+/* Same, taking the operator from cache instead of assembling it. */
+void implicitSmooth(Mesh& mesh, LaplacianCache& cache, const ImplicitSmoothOptions& options);
+
+enum PolynomialFilter {
+	FILTER_TAUBIN,   // alternating lambda / mu umbrella steps
+	FILTER_CHEBYSHEV // Chebyshev expansion of a target frequency response
+};
+
+struct PolynomialSmoothOptions {
+	bool cotangentWeights = true;
+	PolynomialFilter filter = FILTER_CHEBYSHEV;
+	// Number of SpMVs, i.e. the polynomial degree
+	int degree = 10;
+
+	// Taubin: shrink with lambda > 0, inflate with mu < -lambda
+	double lambda = 0.5;
+	double mu = -0.53;
+
+	// Chebyshev: response h(t) over the eigenvalues t of -L, which lie in
+	// [0, 2] unless negative cotangent weights widen the range (see
+	// LaplacianCache::eigenvalueBounds; h is held at h(0) below 0).
+	// When empty, the low-pass 1 / (1 + (t / passBand)^4) is used.
+	std::function< double(double) > response;
+	double passBand = 0.25;
+};
+
+/* Buffers of the cached smoothers, kept by the caller across calls. Once
+ * they and the cache have grown to the mesh, polynomialSmooth and
+ * gaussSeidelSmooth run without a single heap allocation, including the
+ * normal update that follows. The overloads without a workspace use a
+ * fresh one every call. */
+struct SmoothingWorkspace {
+	VertexMatrix positions;
+	VertexMatrix product;
+	VertexMatrix prev;
+	VertexMatrix curr;
+	VertexMatrix next;
+	VertexMatrix result;
+	std::vector< double > coefficients;
+
+	/* Bytes of the buffers held. */
+	size_t memoryBytes() const;
+};
+
+/* Solve-free smoothing by a polynomial in the umbrella operator, costing
+ * exactly options.degree products with the cached operator. Both filters
+ * keep the zero frequency intact, so the mesh does not shrink or drift
+ * the way repeated explicit steps do. Normals are recomputed afterwards. */
+void polynomialSmooth(Mesh& mesh, LaplacianCache& cache, const PolynomialSmoothOptions& options);
+void polynomialSmooth(Mesh& mesh, LaplacianCache& cache, const PolynomialSmoothOptions& options,
+                      SmoothingWorkspace& workspace);
+
+struct GaussSeidelSmoothOptions {
+	bool cotangentWeights = true;
+	double lambda = 1.0;
+	int sweeps = 1;
+};
+
+/* In-place Gauss-Seidel umbrella smoothing: every vertex moves by
+ * lambda * L x using the already updated positions of its neighbors.
+ * Color classes of the cached one-ring coloring are swept one after the
+ * other, each in parallel, so no second copy of the positions is needed.
+ * Normals are recomputed afterwards. */
+void gaussSeidelSmooth(Mesh& mesh, LaplacianCache& cache, const GaussSeidelSmoothOptions& options);
+void gaussSeidelSmooth(Mesh& mesh, LaplacianCache& cache, const GaussSeidelSmoothOptions& options,
+                       SmoothingWorkspace& workspace);
+
+/* A patch of vertices to smooth. interior vertices move; boundary is the
+ * one-ring layer around them, which stays fixed and only feeds the
+ * interior rows. Both hold vertex indices. */
+struct VertexRegion {
+	std::vector< int > interior;
+	std::vector< int > boundary;
+};
+
+/* Region of the vertices with the given flag, or of every flagged vertex
+ * when flag is 0. Accepts both raw selection flags and the handle ids
+ * assigned by Mesh::groupingVertexFlags. This scans all vertices once. */
+VertexRegion flaggedRegion(const Mesh& mesh, int flag = 0);
+
+/* Region of the given vertices plus their one-ring. Costs only the size
+ * of the selection. An index outside the mesh yields an empty region. */
+VertexRegion vertexRegion(const Mesh& mesh, const std::vector< int >& vertices);
+
+/* Explicit umbrella step x += lambda * L x over the interior of region.
+ * The operator is built over the region only, and normals are refreshed
+ * for the region only, so the cost scales with the selection. */
+void regionUmbrellaSmooth(Mesh& mesh, const VertexRegion& region, bool cotangentWeights, double lambda = 1.0);
+
+/* Implicit step over the interior of region with the boundary layer as
+ * Dirichlet values: (I - lambda * L_II) x_I = x_I + lambda * L_IB x_B. */
+void regionImplicitSmooth(Mesh& mesh, const VertexRegion& region, const ImplicitSmoothOptions& options);
+
+#endif
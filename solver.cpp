@@ -0,0 +1,555 @@
+#include "solver.h"
+#include "multigrid.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+static void _multiply(const Eigen::SparseMatrix< float >& A,
+                      const Eigen::VectorXf& x,
+                      Eigen::VectorXf& y) {
+	y.noalias() = A * x;
+}
+
+static void _multiply(const SellMatrix& A,
+                      const Eigen::VectorXf& x,
+                      Eigen::VectorXf& y) {
+	A.multiply(x, y);
+}
+
+template < class Matrix >
+static int _bicgstab(const Matrix& A,
+                     const Eigen::VectorXf& b,
+                     Eigen::VectorXf& x,
+                     int maxIterations,
+                     float errorTolerance,
+                     const Preconditioner* M,
+                     KrylovTrace* trace) {
+	TRACE_SCOPE("bicgstab");
+	auto start = std::chrono::steady_clock::now();
+	int n = A.rows();
+	Eigen::VectorXf r(n);
+	_multiply(A, x, r);
+	r = b - r;
+	int spmvCount = 1;
+	Eigen::VectorXf r_star = r;
+	Eigen::VectorXf p = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf v = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf p_hat(n), s(n), s_hat(n), t(n);
+	double rou = 1.0;
+	double alpha = 1.0;
+	double w = 1.0;
+
+	int i = 0;
+	double error = r.squaredNorm();
+	bool recorded = false; // error already in the trace
+	if (trace) {
+		// Room for the whole history up front keeps the iterations free of
+		// allocations
+		trace->residuals.reserve(trace->residuals.size() + maxIterations + 1);
+	}
+	for (; i < maxIterations; ++i) {
+		TRACE_SCOPE("bicgstab iteration");
+		if (trace) {
+			trace->residuals.push_back(error);
+		}
+		recorded = true;
+		if (error < errorTolerance) {
+			// very close, further calculation not needed
+			break;
+		}
+		recorded = false;
+
+		double rou_next = r_star.dot(r);
+		double beta = (rou_next / rou) * (alpha / w);
+		p = r + beta * (p - w * v);
+		if (M) {
+			M->apply(p, p_hat);
+		} else {
+			p_hat = p;
+		}
+		_multiply(A, p_hat, v);
+		++spmvCount;
+		alpha = rou_next / r_star.dot(v);
+
+		s = r - alpha * v;
+		error = s.squaredNorm();
+		if (error < errorTolerance) {
+			x += alpha * p_hat;
+			++i;
+			break;
+		}
+
+		if (M) {
+			M->apply(s, s_hat);
+		} else {
+			s_hat = s;
+		}
+		_multiply(A, s_hat, t);
+		++spmvCount;
+		w = t.dot(s) / t.dot(t);
+		x += alpha * p_hat + w * s_hat;
+		r = s - w * t;
+		rou = rou_next;
+		error = r.squaredNorm();
+	}
+
+	if (trace) {
+		if (!recorded) {
+			trace->residuals.push_back(error);
+		}
+		trace->iterations += i;
+		trace->spmvCount += spmvCount;
+		trace->seconds += _seconds(start);
+		trace->converged = error < errorTolerance;
+		trace->hitMaxIterations = !trace->converged && i >= maxIterations;
+	}
+	return i;
+}
+
+int bicgstab(const Eigen::SparseMatrix< float >& A,
+             const Eigen::VectorXf& b,
+             Eigen::VectorXf& x,
+             int maxIterations,
+             float errorTolerance,
+             const Preconditioner* M,
+             KrylovTrace* trace) {
+	return _bicgstab(A, b, x, maxIterations, errorTolerance, M, trace);
+}
+
+int bicgstab(const SellMatrix& A,
+             const Eigen::VectorXf& b,
+             Eigen::VectorXf& x,
+             int maxIterations,
+             float errorTolerance,
+             const Preconditioner* M,
+             KrylovTrace* trace) {
+	return _bicgstab(A, b, x, maxIterations, errorTolerance, M, trace);
+}
+
+/* Per-block state of blockBicgstab. */
+struct _BlockState {
+	double rou = 1.0;
+	double alpha = 1.0;
+	double w = 1.0;
+	double error = 0.0;
+	int iterations = 0;
+	bool active = true;
+	bool converged = false;
+};
+
+int blockBicgstab(const SellMatrix& A,
+                  const std::vector< int >& blockOffsets,
+                  const Eigen::VectorXf& b,
+                  Eigen::VectorXf& x,
+                  int maxIterations,
+                  float errorTolerance,
+                  const Preconditioner* M,
+                  KrylovTrace* trace) {
+	TRACE_SCOPE("blockBicgstab");
+	PERF_SCOPE("blockBicgstab");
+	auto start = std::chrono::steady_clock::now();
+	ThreadPool& pool = *A.pool();
+	int n = A.rows();
+	int numBlocks = blockOffsets.size() - 1;
+	Eigen::VectorXf r(n);
+	A.multiply(x, r);
+	r = b - r;
+	int spmvCount = 1;
+	Eigen::VectorXf r_star = r;
+	Eigen::VectorXf p = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf v = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf p_hat = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf s = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf s_hat = Eigen::VectorXf::Zero(n);
+	Eigen::VectorXf t(n);
+	std::vector< _BlockState > blocks(numBlocks);
+	// Blocks are small, so the per-block work is handed out in groups
+	const int BLOCKS_PER_TASK = 16;
+	int numTasks = (numBlocks + BLOCKS_PER_TASK - 1) / BLOCKS_PER_TASK;
+	auto forActiveBlocks = [&](const auto& fn) {
+		pool.parallelFor(numTasks, [&](int task) {
+			int last = std::min(numBlocks, (task + 1) * BLOCKS_PER_TASK);
+			for (int k = task * BLOCKS_PER_TASK; k < last; ++k) {
+				if (blocks[k].active) {
+					fn(k, blockOffsets[k], blockOffsets[k + 1] - blockOffsets[k]);
+				}
+			}
+		});
+	};
+	forActiveBlocks([&](int k, int begin, int size) {
+		blocks[k].error = r.segment(begin, size).squaredNorm();
+	});
+	auto totalError = [&]() {
+		double total = 0.0;
+		for (const _BlockState& block : blocks) {
+			total += block.error;
+		}
+		return total;
+	};
+
+	int i = 0;
+	for (; i < maxIterations; ++i) {
+		TRACE_SCOPE("blockBicgstab iteration");
+		if (trace) {
+			trace->residuals.push_back(totalError());
+		}
+		int numActive = 0;
+		for (_BlockState& block : blocks) {
+			if (block.active && block.error < errorTolerance) {
+				block.active = false;
+				block.converged = true;
+			}
+			numActive += block.active;
+		}
+		if (numActive == 0) {
+			break;
+		}
+
+		forActiveBlocks([&](int k, int begin, int size) {
+			_BlockState& block = blocks[k];
+			double rou_next = r_star.segment(begin, size).dot(r.segment(begin, size));
+			double beta = (rou_next / block.rou) * (block.alpha / block.w);
+			p.segment(begin, size) = r.segment(begin, size) + beta * (p.segment(begin, size) - block.w * v.segment(begin, size));
+			block.rou = rou_next;
+		});
+		if (M) {
+			M->apply(p, p_hat);
+		} else {
+			p_hat = p;
+		}
+		A.multiply(p_hat, v);
+		++spmvCount;
+		forActiveBlocks([&](int k, int begin, int size) {
+			_BlockState& block = blocks[k];
+			double denominator = r_star.segment(begin, size).dot(v.segment(begin, size));
+			if (denominator == 0.0) {
+				// Breakdown: keep the iterate, the block cannot proceed
+				block.active = false;
+				return;
+			}
+			block.alpha = block.rou / denominator;
+			s.segment(begin, size) = r.segment(begin, size) - block.alpha * v.segment(begin, size);
+			block.error = s.segment(begin, size).squaredNorm();
+			++block.iterations;
+			if (block.error < errorTolerance) {
+				x.segment(begin, size) += block.alpha * p_hat.segment(begin, size);
+				block.active = false;
+				block.converged = true;
+			}
+		});
+
+		if (M) {
+			M->apply(s, s_hat);
+		} else {
+			s_hat = s;
+		}
+		A.multiply(s_hat, t);
+		++spmvCount;
+		forActiveBlocks([&](int k, int begin, int size) {
+			_BlockState& block = blocks[k];
+			double tt = t.segment(begin, size).squaredNorm();
+			block.w = tt > 0.0 ? t.segment(begin, size).dot(s.segment(begin, size)) / tt : 0.0;
+			x.segment(begin, size) += block.alpha * p_hat.segment(begin, size) + block.w * s_hat.segment(begin, size);
+			r.segment(begin, size) = s.segment(begin, size) - block.w * t.segment(begin, size);
+			block.error = r.segment(begin, size).squaredNorm();
+			if (block.w == 0.0) {
+				block.active = false;
+				block.converged = block.error < errorTolerance;
+			}
+		});
+	}
+
+	int iterations = 0;
+	bool converged = true;
+	for (const _BlockState& block : blocks) {
+		iterations = std::max(iterations, block.iterations);
+		converged = converged && block.converged;
+	}
+	if (trace) {
+		trace->residuals.push_back(totalError());
+		trace->iterations += iterations;
+		trace->spmvCount += spmvCount;
+		trace->seconds += _seconds(start);
+		trace->converged = converged;
+		trace->hitMaxIterations = !converged && i >= maxIterations;
+	}
+	return iterations;
+}
+
+int refinedSolve(const SellMatrix& A,
+                 const Eigen::VectorXd& b,
+                 Eigen::VectorXd& x,
+                 const SolveOptions& options,
+                 const Preconditioner* M,
+                 KrylovTrace* trace) {
+	auto start = std::chrono::steady_clock::now();
+	int n = A.rows();
+	Eigen::VectorXd r(n);
+	Eigen::VectorXf rf(n);
+	Eigen::VectorXf d(n);
+	KrylovTrace inner;
+	int iterations = 0;
+	int spmvCount = 0;
+	double norm2 = 0.0;
+	double tolerance = options.refinementTolerance * b.squaredNorm();
+	for (int k = 0; k < options.maxRefinements; ++k) {
+		A.multiply(x, r);
+		++spmvCount;
+		r = b - r;
+		norm2 = r.squaredNorm();
+		if (norm2 <= tolerance || iterations >= options.maxIterations) {
+			break;
+		}
+		// Solve for the correction on a unit residual so float keeps its
+		// full relative precision however small r has become
+		double scale = std::sqrt(norm2);
+		rf = (r / scale).cast< float >();
+		d.setZero();
+		inner = KrylovTrace();
+		iterations += bicgstab(A, rf, d, options.maxIterations - iterations,
+		                       options.innerReduction, M, trace ? &inner : nullptr);
+		x += scale * d.cast< double >();
+		if (trace) {
+			for (double residual : inner.residuals) {
+				trace->residuals.push_back(residual * norm2);
+			}
+			spmvCount += inner.spmvCount;
+		}
+	}
+
+	if (trace) {
+		trace->residuals.push_back(norm2);
+		trace->iterations += iterations;
+		trace->spmvCount += spmvCount;
+		trace->seconds += _seconds(start);
+		trace->converged = norm2 <= tolerance;
+		trace->hitMaxIterations = !trace->converged && iterations >= options.maxIterations;
+	}
+	return iterations;
+}
+
+/* Double BiCGSTAB of Eigen on a single right-hand side. Eigen exposes
+ * no residual history, so the trace holds the initial and final ones. */
+static void _doubleSolve(const Eigen::SparseMatrix< double >& A,
+                         const Eigen::VectorXd& b,
+                         Eigen::VectorXd& x,
+                         const SolveOptions& options,
+                         KrylovTrace* trace) {
+	auto start = std::chrono::steady_clock::now();
+	double initial = trace ? (b - A * x).squaredNorm() : 0.0;
+	Eigen::BiCGSTAB< Eigen::SparseMatrix< double >, Eigen::DiagonalPreconditioner< double > > solver(A);
+	solver.setMaxIterations(options.maxIterations);
+	// Eigen stops on |r| <= tolerance * |b|, the root of the squared test
+	solver.setTolerance(std::sqrt(options.refinementTolerance));
+	x = solver.solveWithGuess(b, x);
+	if (trace) {
+		double norm2 = (b - A * x).squaredNorm();
+		trace->iterations += solver.iterations();
+		// Two products per iteration plus the initial residual
+		trace->spmvCount += 2 * solver.iterations() + 1;
+		trace->seconds += _seconds(start);
+		trace->residuals.push_back(initial);
+		trace->residuals.push_back(norm2);
+		trace->converged = norm2 <= options.refinementTolerance * b.squaredNorm();
+		trace->hitMaxIterations = !trace->converged && solver.iterations() >= options.maxIterations;
+	}
+}
+
+void solveColumns(const Eigen::SparseMatrix< float >& A,
+                  const Eigen::MatrixXd& B,
+                  Eigen::MatrixXd& X,
+                  const SolveOptions& options,
+                  SolveTrace* trace) {
+	TRACE_SCOPE("solveColumns");
+	PERF_SCOPE("solveColumns");
+	auto start = std::chrono::steady_clock::now();
+	int n = A.rows();
+	if (X.rows() != B.rows() || X.cols() != B.cols()) {
+		X.setZero(B.rows(), B.cols());
+	}
+
+	bool useDouble = options.precision == SOLVER_DOUBLE;
+	Eigen::SparseMatrix< double > Ad;
+	SellMatrix sell;
+	// One hierarchy serves every right-hand side
+	MultigridSolver multigrid;
+	const Preconditioner* M = nullptr;
+	if (useDouble) {
+		Ad = A.cast< double >();
+	} else {
+		sell.assign(A);
+	}
+	if (!useDouble && n >= options.multigridMinSize) {
+		multigrid.setup(A);
+		M = &multigrid;
+	}
+
+	if (trace) {
+		trace->rows = n;
+		trace->nonZeros = A.nonZeros();
+		trace->precision = options.precision;
+		trace->multigridLevels = M ? multigrid.numLevels() : 0;
+		trace->errorTolerance = options.precision != SOLVER_SINGLE ? options.refinementTolerance : options.errorTolerance;
+		trace->maxIterations = options.maxIterations;
+		trace->setupSeconds = _seconds(start);
+		trace->columns.assign(B.cols(), KrylovTrace());
+	}
+	auto solveStart = std::chrono::steady_clock::now();
+
+	for (int j = 0; j < B.cols(); ++j) {
+		KrylovTrace* column = trace ? &trace->columns[j] : nullptr;
+		if (useDouble) {
+			Eigen::VectorXd x = X.col(j);
+			_doubleSolve(Ad, B.col(j), x, options, column);
+			X.col(j) = x;
+		} else if (options.precision == SOLVER_MIXED) {
+			Eigen::VectorXd x = X.col(j);
+			refinedSolve(sell, B.col(j), x, options, M, column);
+			X.col(j) = x;
+		} else {
+			Eigen::VectorXf b = B.col(j).cast< float >();
+			Eigen::VectorXf x = X.col(j).cast< float >();
+			bicgstab(sell, b, x, options.maxIterations, options.errorTolerance, M, column);
+			X.col(j) = x.cast< double >();
+		}
+	}
+
+	if (trace) {
+		trace->solveSeconds = _seconds(solveStart);
+	}
+}
+
+bool SolveTrace::converged() const {
+	for (const KrylovTrace& column : columns) {
+		if (!column.converged) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int SolveTrace::iterations() const {
+	int count = 0;
+	for (const KrylovTrace& column : columns) {
+		count += column.iterations;
+	}
+	return count;
+}
+
+int SolveTrace::spmvCount() const {
+	int count = 0;
+	for (const KrylovTrace& column : columns) {
+		count += column.spmvCount;
+	}
+	return count;
+}
+
+static std::mutex gTraceMutex;
+static SolveTraceCallback gTraceCallback;
+
+void setSolveTraceCallback(SolveTraceCallback callback) {
+	std::lock_guard< std::mutex > lock(gTraceMutex);
+	gTraceCallback = callback;
+}
+
+void reportSolveTrace(const SolveTrace& trace, const SolveOptions& options) {
+	if (options.traceCallback) {
+		options.traceCallback(trace);
+		return;
+	}
+	SolveTraceCallback callback;
+	{
+		std::lock_guard< std::mutex > lock(gTraceMutex);
+		callback = gTraceCallback;
+	}
+	if (callback) {
+		callback(trace);
+	}
+}
+
+static void _appendString(std::ostringstream& out, const std::string& text) {
+	out << '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			out << escaped;
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+/* JSON has no nan or inf. */
+static void _appendNumber(std::ostringstream& out, double value) {
+	if (std::isfinite(value)) {
+		out << value;
+	} else {
+		out << "null";
+	}
+}
+
+static const char* _precisionName(SolverPrecision precision) {
+	switch (precision) {
+	case SOLVER_MIXED:
+		return "mixed";
+	case SOLVER_DOUBLE:
+		return "double";
+	default:
+		return "single";
+	}
+}
+
+std::string solveTraceToJson(const SolveTrace& trace) {
+	std::ostringstream out;
+	out.precision(9);
+	out << "{\"source\":";
+	_appendString(out, trace.source);
+	out << ",\"rows\":" << trace.rows
+	    << ",\"nonZeros\":" << trace.nonZeros
+	    << ",\"precision\":\"" << _precisionName(trace.precision) << "\""
+	    << ",\"direct\":" << (trace.direct ? "true" : "false")
+	    << ",\"multigridLevels\":" << trace.multigridLevels
+	    << ",\"errorTolerance\":";
+	_appendNumber(out, trace.errorTolerance);
+	out << ",\"maxIterations\":" << trace.maxIterations
+	    << ",\"assemblySeconds\":";
+	_appendNumber(out, trace.assemblySeconds);
+	out << ",\"setupSeconds\":";
+	_appendNumber(out, trace.setupSeconds);
+	out << ",\"solveSeconds\":";
+	_appendNumber(out, trace.solveSeconds);
+	out << ",\"converged\":" << (trace.converged() ? "true" : "false")
+	    << ",\"columns\":[";
+	for (int j = 0; j < (int)trace.columns.size(); ++j) {
+		const KrylovTrace& column = trace.columns[j];
+		out << (j ? "," : "")
+		    << "{\"iterations\":" << column.iterations
+		    << ",\"spmvCount\":" << column.spmvCount
+		    << ",\"seconds\":";
+		_appendNumber(out, column.seconds);
+		out << ",\"converged\":" << (column.converged ? "true" : "false")
+		    << ",\"hitMaxIterations\":" << (column.hitMaxIterations ? "true" : "false")
+		    << ",\"residuals\":[";
+		for (int k = 0; k < (int)column.residuals.size(); ++k) {
+			out << (k ? "," : "");
+			_appendNumber(out, column.residuals[k]);
+		}
+		out << "]}";
+	}
+	out << "]}";
+	return out.str();
+}
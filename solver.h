@@ -0,0 +1,169 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "spmv.h"
+#include <Eigen/Sparse>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Arithmetic used by solveColumns. */
+enum SolverPrecision {
+	SOLVER_SINGLE, // float matrix and float Krylov iterations
+	SOLVER_MIXED,  // float inner iterations inside double iterative refinement
+	SOLVER_DOUBLE  // double matrix and Krylov iterations; also reported by direct solves
+};
+
+/* Convergence record of one Krylov solve, i.e. one right-hand side.
+ * Direct solves have no iterations and record only the final residual. */
+struct KrylovTrace {
+	int iterations = 0;
+	int spmvCount = 0;
+	double seconds = 0.0;
+	bool converged = false;
+	// Stopped because the iteration budget ran out
+	bool hitMaxIterations = false;
+	// Squared residual norm at the start of every iteration, plus the final one
+	std::vector< double > residuals;
+};
+
+/* Structured record of one linear system solved by solveColumns. */
+struct SolveTrace {
+	std::string source; // who issued the solve, e.g. "Mesh::implicitUmbrellaSmooth"
+	int rows = 0;
+	int nonZeros = 0;
+	SolverPrecision precision = SOLVER_SINGLE;
+	bool direct = false;     // a sparse factorization, no Krylov iterations
+	int multigridLevels = 0; // 0 when no preconditioner was used
+	double errorTolerance = 0.0; // refinementTolerance, relative, for mixed and double solves
+	int maxIterations = 0;
+
+	// Wall times in seconds. Assembly is filled in by the caller. Setup
+	// is the preconditioner or factorization built for this solve; reused
+	// ones count as 0.
+	double assemblySeconds = 0.0;
+	double setupSeconds = 0.0;
+	double solveSeconds = 0.0;
+
+	std::vector< KrylovTrace > columns;
+
+	/* True when every column reached the tolerance. */
+	bool converged() const;
+	/* Totals over all columns. */
+	int iterations() const;
+	int spmvCount() const;
+};
+
+typedef std::function< void(const SolveTrace&) > SolveTraceCallback;
+
+struct SolveOptions {
+	int maxIterations = 2000;
+	// Stop once the squared residual norm drops below this
+	double errorTolerance = 1e-7;
+	SolverPrecision precision = SOLVER_SINGLE;
+	// Systems at least this large use the multigrid preconditioner
+	int multigridMinSize = 100000;
+
+	// Mixed precision only: refinement steps, and the squared residual
+	// reduction each inner float solve aims for
+	int maxRefinements = 10;
+	float innerReduction = 1e-8f;
+	// Mixed precision only: refinement stops once the squared residual
+	// norm relative to that of b drops below this. It replaces
+	// errorTolerance, which is a float-level target, so the result is
+	// accurate to double precision of the float-stored matrix.
+	double refinementTolerance = 1e-24;
+
+	// Receives the trace of every solve issued with these options. When
+	// empty the process-wide callback is used instead.
+	SolveTraceCallback traceCallback;
+};
+
+/* Interface of the preconditioners accepted by the Krylov solvers. */
+class Preconditioner {
+public:
+	virtual ~Preconditioner() {}
+
+	/* Approximately solve M z = r. z is sized by the caller. */
+	virtual void apply(const Eigen::VectorXf& r, Eigen::VectorXf& z) const = 0;
+};
+
+/* Right-preconditioned BiCGSTAB for the non-symmetric umbrella systems.
+ * x holds the initial guess on entry and the solution on exit. Iteration
+ * stops once the squared residual norm drops below errorTolerance, the
+ * same criterion the implicit smoother has always used. Returns the
+ * number of iterations performed and accumulates into trace when given. */
+int bicgstab(const Eigen::SparseMatrix< float >& A,
+             const Eigen::VectorXf& b,
+             Eigen::VectorXf& x,
+             int maxIterations,
+             float errorTolerance,
+             const Preconditioner* M = nullptr,
+             KrylovTrace* trace = nullptr);
+
+/* Same solver running its products through the SELL-C kernel. */
+int bicgstab(const SellMatrix& A,
+             const Eigen::VectorXf& b,
+             Eigen::VectorXf& x,
+             int maxIterations,
+             float errorTolerance,
+             const Preconditioner* M = nullptr,
+             KrylovTrace* trace = nullptr);
+
+/* BiCGSTAB on a block-diagonal system whose diagonal blocks are rows
+ * blockOffsets[k] .. blockOffsets[k + 1] - 1. Every block runs its own
+ * iteration: inner products, step lengths and the stopping test on the
+ * squared residual norm are per block, so each block converges exactly
+ * as if it were solved alone and stops on its own, while the products
+ * still go through the one stacked matrix. M must be block-diagonal as
+ * well; the multigrid hierarchy of a block-diagonal matrix is. Returns
+ * the iterations of the slowest block. trace sums the squared residuals
+ * over the blocks and is converged when every block is. */
+int blockBicgstab(const SellMatrix& A,
+                  const std::vector< int >& blockOffsets,
+                  const Eigen::VectorXf& b,
+                  Eigen::VectorXf& x,
+                  int maxIterations,
+                  float errorTolerance,
+                  const Preconditioner* M = nullptr,
+                  KrylovTrace* trace = nullptr);
+
+/* Mixed-precision iterative refinement. The matrix stays in float and
+ * every correction A d = r is solved by float bicgstab, while residuals
+ * r = b - A x and the solution x are kept in double. Refinement stops on
+ * the relative options.refinementTolerance. Returns the total number of
+ * inner iterations. The trace records the inner residuals rescaled to
+ * the original system. */
+int refinedSolve(const SellMatrix& A,
+                 const Eigen::VectorXd& b,
+                 Eigen::VectorXd& x,
+                 const SolveOptions& options,
+                 const Preconditioner* M = nullptr,
+                 KrylovTrace* trace = nullptr);
+
+/* Solve A X = B column by column with the solver picked by options.
+ * SOLVER_DOUBLE converts A to double and stops on the relative
+ * options.refinementTolerance like the mixed solver; it uses neither
+ * multigrid nor SELL-C, and traces only the first and last residual.
+ * X holds the initial guess on entry, or is zero-initialized when its
+ * size does not match B. Fills everything in trace but the source and
+ * the assembly time, which belong to the caller. */
+void solveColumns(const Eigen::SparseMatrix< float >& A,
+                  const Eigen::MatrixXd& B,
+                  Eigen::MatrixXd& X,
+                  const SolveOptions& options = SolveOptions(),
+                  SolveTrace* trace = nullptr);
+
+/* Hand a finished trace to options.traceCallback, or to the process-wide
+ * callback when that is empty. */
+void reportSolveTrace(const SolveTrace& trace, const SolveOptions& options);
+
+/* Install the process-wide trace callback, or clear it with an empty
+ * function. It may run on any thread that issues a solve. */
+void setSolveTraceCallback(SolveTraceCallback callback);
+
+/* One-line JSON rendering of a trace for logs and alerting. Non-finite
+ * numbers, e.g. residuals after a breakdown, are written as null. */
+std::string solveTraceToJson(const SolveTrace& trace);
+
+#endif
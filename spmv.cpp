@@ -0,0 +1,270 @@
+#include "spmv.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SPMV_USE_AVX2
+#endif
+
+// Below this many entries a product is cheaper than waking the pool
+static const int PARALLEL_MIN_NONZEROS = 1 << 16;
+
+SellMatrix::SellMatrix() : mRows(0), mCols(0), mNonZeros(0), mPool(nullptr) {
+	mSliceOffsets.push_back(0);
+}
+
+SellMatrix::SellMatrix(const Eigen::SparseMatrix< float >& A) : mPool(nullptr) {
+	assign(A);
+}
+
+void SellMatrix::assign(const Eigen::SparseMatrix< float >& A) {
+	Eigen::SparseMatrix< float, Eigen::RowMajor > R = A;
+	R.makeCompressed();
+
+	mRows = R.rows();
+	mCols = R.cols();
+	mNonZeros = R.nonZeros();
+
+	int numSlices = (mRows + SLICE_HEIGHT - 1) / SLICE_HEIGHT;
+	mSliceOffsets.assign(numSlices + 1, 0);
+	mSliceWidths.assign(numSlices, 0);
+	for (int s = 0; s < numSlices; ++s) {
+		int width = 0;
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			int row = s * SLICE_HEIGHT + k;
+			if (row < mRows) {
+				width = std::max(width, (int)(R.outerIndexPtr()[row + 1] - R.outerIndexPtr()[row]));
+			}
+		}
+		mSliceWidths[s] = width;
+		mSliceOffsets[s + 1] = mSliceOffsets[s] + width * SLICE_HEIGHT;
+	}
+
+	// Padding entries point at column 0 with a zero weight so the kernels
+	// never need a bounds check
+	mColumns.assign(mSliceOffsets[numSlices], 0);
+	mValues.assign(mSliceOffsets[numSlices], 0.0f);
+	for (int s = 0; s < numSlices; ++s) {
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			int row = s * SLICE_HEIGHT + k;
+			if (row >= mRows) {
+				break;
+			}
+			int begin = R.outerIndexPtr()[row];
+			int end = R.outerIndexPtr()[row + 1];
+			for (int j = 0; j < end - begin; ++j) {
+				int dst = mSliceOffsets[s] + j * SLICE_HEIGHT + k;
+				mColumns[dst] = R.innerIndexPtr()[begin + j];
+				mValues[dst] = R.valuePtr()[begin + j];
+			}
+		}
+	}
+
+	buildPartitions();
+}
+
+void SellMatrix::updateValues(const Eigen::SparseMatrix< float, Eigen::RowMajor >& R) {
+	int numSlices = mSliceWidths.size();
+	for (int s = 0; s < numSlices; ++s) {
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			int row = s * SLICE_HEIGHT + k;
+			if (row >= mRows) {
+				break;
+			}
+			int begin = R.outerIndexPtr()[row];
+			int end = R.outerIndexPtr()[row + 1];
+			for (int j = 0; j < end - begin; ++j) {
+				mValues[mSliceOffsets[s] + j * SLICE_HEIGHT + k] = R.valuePtr()[begin + j];
+			}
+		}
+	}
+}
+
+void SellMatrix::buildPartitions() {
+	int numSlices = mSliceWidths.size();
+	int numParts = 1;
+	if (mNonZeros >= PARALLEL_MIN_NONZEROS) {
+		numParts = std::min(pool()->size(), numSlices);
+	}
+
+	// Split the slices so every partition holds about the same number of
+	// stored entries
+	mPartitions.assign(1, 0);
+	long long total = mSliceOffsets[numSlices];
+	for (int s = 0, p = 1; s < numSlices && p < numParts; ++s) {
+		if ((long long)mSliceOffsets[s + 1] * numParts >= total * p) {
+			mPartitions.push_back(s + 1);
+			++p;
+		}
+	}
+	if (mPartitions.back() != numSlices) {
+		mPartitions.push_back(numSlices);
+	}
+}
+
+int SellMatrix::rows() const {
+	return mRows;
+}
+
+int SellMatrix::cols() const {
+	return mCols;
+}
+
+int SellMatrix::nonZeros() const {
+	return mNonZeros;
+}
+
+int SellMatrix::paddedNonZeros() const {
+	return mSliceOffsets.back();
+}
+
+size_t SellMatrix::memoryBytes() const {
+	return sizeof(int) * (mSliceOffsets.capacity() + mSliceWidths.capacity() + mColumns.capacity() + mPartitions.capacity())
+	       + sizeof(float) * mValues.capacity();
+}
+
+ThreadPool* SellMatrix::pool() const {
+	return mPool ? mPool : &ThreadPool::global();
+}
+
+ThreadPool* SellMatrix::setPool(ThreadPool* pool) {
+	mPool = pool;
+	buildPartitions();
+	return mPool;
+}
+
+void SellMatrix::multiply(const Eigen::VectorXf& x, Eigen::VectorXf& y) const {
+	y.resize(mRows);
+	int numParts = mPartitions.size() - 1;
+	if (numParts <= 1) {
+		multiplySlices(0, mSliceWidths.size(), x.data(), y.data());
+		return;
+	}
+	pool()->parallelFor(numParts, [&](int p) {
+		multiplySlices(mPartitions[p], mPartitions[p + 1], x.data(), y.data());
+	});
+}
+
+void SellMatrix::multiply(const Eigen::VectorXd& x, Eigen::VectorXd& y) const {
+	y.resize(mRows);
+	int numParts = mPartitions.size() - 1;
+	if (numParts <= 1) {
+		multiplySlicesDouble(0, mSliceWidths.size(), x.data(), y.data());
+		return;
+	}
+	pool()->parallelFor(numParts, [&](int p) {
+		multiplySlicesDouble(mPartitions[p], mPartitions[p + 1], x.data(), y.data());
+	});
+}
+
+void SellMatrix::multiply(const VertexMatrix& x, VertexMatrix& y) const {
+	y.resize(mRows, 3);
+	int numParts = mPartitions.size() - 1;
+	if (numParts <= 1) {
+		multiplySlices3(0, mSliceWidths.size(), x.data(), y.data());
+		return;
+	}
+	pool()->parallelFor(numParts, [&](int p) {
+		multiplySlices3(mPartitions[p], mPartitions[p + 1], x.data(), y.data());
+	});
+}
+
+void SellMatrix::multiplySlices(int begin, int end, const float* x, float* y) const {
+	for (int s = begin; s < end; ++s) {
+		const int* col = &mColumns[mSliceOffsets[s]];
+		const float* val = &mValues[mSliceOffsets[s]];
+		int width = mSliceWidths[s];
+		float acc[SLICE_HEIGHT];
+#ifdef SPMV_USE_AVX2
+		__m256 sum = _mm256_setzero_ps();
+		for (int j = 0; j < width; ++j) {
+			__m256i idx = _mm256_loadu_si256((const __m256i*)(col + j * SLICE_HEIGHT));
+			__m256 v = _mm256_loadu_ps(val + j * SLICE_HEIGHT);
+			sum = _mm256_fmadd_ps(v, _mm256_i32gather_ps(x, idx, 4), sum);
+		}
+		_mm256_storeu_ps(acc, sum);
+#else
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			acc[k] = 0.0f;
+		}
+		for (int j = 0; j < width; ++j) {
+			for (int k = 0; k < SLICE_HEIGHT; ++k) {
+				acc[k] += val[j * SLICE_HEIGHT + k] * x[col[j * SLICE_HEIGHT + k]];
+			}
+		}
+#endif
+		int row0 = s * SLICE_HEIGHT;
+		int count = std::min(SLICE_HEIGHT, mRows - row0);
+		for (int k = 0; k < count; ++k) {
+			y[row0 + k] = acc[k];
+		}
+	}
+}
+
+void SellMatrix::multiplySlicesDouble(int begin, int end, const double* x, double* y) const {
+	for (int s = begin; s < end; ++s) {
+		const int* col = &mColumns[mSliceOffsets[s]];
+		const float* val = &mValues[mSliceOffsets[s]];
+		int width = mSliceWidths[s];
+		double acc[SLICE_HEIGHT];
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			acc[k] = 0.0;
+		}
+		for (int j = 0; j < width; ++j) {
+			for (int k = 0; k < SLICE_HEIGHT; ++k) {
+				acc[k] += (double)val[j * SLICE_HEIGHT + k] * x[col[j * SLICE_HEIGHT + k]];
+			}
+		}
+		int row0 = s * SLICE_HEIGHT;
+		int count = std::min(SLICE_HEIGHT, mRows - row0);
+		for (int k = 0; k < count; ++k) {
+			y[row0 + k] = acc[k];
+		}
+	}
+}
+
+void SellMatrix::multiplySlices3(int begin, int end, const float* x, float* y) const {
+	for (int s = begin; s < end; ++s) {
+		const int* col = &mColumns[mSliceOffsets[s]];
+		const float* val = &mValues[mSliceOffsets[s]];
+		int width = mSliceWidths[s];
+		float acc[3][SLICE_HEIGHT];
+#ifdef SPMV_USE_AVX2
+		__m256 sx = _mm256_setzero_ps();
+		__m256 sy = _mm256_setzero_ps();
+		__m256 sz = _mm256_setzero_ps();
+		for (int j = 0; j < width; ++j) {
+			__m256i idx = _mm256_loadu_si256((const __m256i*)(col + j * SLICE_HEIGHT));
+			idx = _mm256_add_epi32(idx, _mm256_add_epi32(idx, idx));
+			__m256 v = _mm256_loadu_ps(val + j * SLICE_HEIGHT);
+			sx = _mm256_fmadd_ps(v, _mm256_i32gather_ps(x, idx, 4), sx);
+			sy = _mm256_fmadd_ps(v, _mm256_i32gather_ps(x + 1, idx, 4), sy);
+			sz = _mm256_fmadd_ps(v, _mm256_i32gather_ps(x + 2, idx, 4), sz);
+		}
+		_mm256_storeu_ps(acc[0], sx);
+		_mm256_storeu_ps(acc[1], sy);
+		_mm256_storeu_ps(acc[2], sz);
+#else
+		for (int k = 0; k < SLICE_HEIGHT; ++k) {
+			acc[0][k] = acc[1][k] = acc[2][k] = 0.0f;
+		}
+		for (int j = 0; j < width; ++j) {
+			for (int k = 0; k < SLICE_HEIGHT; ++k) {
+				float v = val[j * SLICE_HEIGHT + k];
+				const float* p = x + 3 * col[j * SLICE_HEIGHT + k];
+				acc[0][k] += v * p[0];
+				acc[1][k] += v * p[1];
+				acc[2][k] += v * p[2];
+			}
+		}
+#endif
+		int row0 = s * SLICE_HEIGHT;
+		int count = std::min(SLICE_HEIGHT, mRows - row0);
+		for (int k = 0; k < count; ++k) {
+			y[3 * (row0 + k) + 0] = acc[0][k];
+			y[3 * (row0 + k) + 1] = acc[1][k];
+			y[3 * (row0 + k) + 2] = acc[2][k];
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef SPMV_H
+#define SPMV_H
+
+#include <Eigen/Sparse>
+#include <vector>
+
+class ThreadPool;
+
+/* N x 3 vertex attributes with interleaved xyz, the layout the gathers in
+ * SellMatrix::multiply read best. */
+typedef Eigen::Matrix< float, Eigen::Dynamic, 3, Eigen::RowMajor > VertexMatrix;
+
+/* Sparse matrix in sliced ELLPACK (SELL-C) layout for mesh Laplacians.
+ *
+ * Rows are grouped in slices of SLICE_HEIGHT consecutive rows and every
+ * slice is padded to its longest row. Entries are stored column-major
+ * within a slice so one SIMD lane handles one row. Triangle meshes have
+ * a near-constant valence, so the padding overhead stays small.
+ *
+ * Products are row-partitioned over the thread pool with partitions
+ * balanced by non-zero count, and use AVX2 gathers when the build
+ * enables them. */
+class SellMatrix {
+public:
+	static const int SLICE_HEIGHT = 8;
+
+	SellMatrix();
+	explicit SellMatrix(const Eigen::SparseMatrix< float >& A);
+
+	/* Rebuild from an Eigen sparse matrix. */
+	void assign(const Eigen::SparseMatrix< float >& A);
+	/* Copy new weights from a compressed matrix with the sparsity pattern
+	 * of the last assign, keeping the layout. Allocates nothing. */
+	void updateValues(const Eigen::SparseMatrix< float, Eigen::RowMajor >& R);
+
+	int rows() const;
+	int cols() const;
+	int nonZeros() const;
+	/* Stored entries including slice padding. */
+	int paddedNonZeros() const;
+	/* Bytes of the arrays held. */
+	size_t memoryBytes() const;
+
+	/* Pool used for the products. Defaults to ThreadPool::global(). */
+	ThreadPool* pool() const;
+	ThreadPool* setPool(ThreadPool* pool);
+
+	/* y = A * x */
+	void multiply(const Eigen::VectorXf& x, Eigen::VectorXf& y) const;
+	/* y = A * x with float weights and double accumulation, used for the
+	 * residuals of mixed-precision refinement. */
+	void multiply(const Eigen::VectorXd& x, Eigen::VectorXd& y) const;
+	/* Y = A * X for interleaved xyz right-hand sides. */
+	void multiply(const VertexMatrix& x, VertexMatrix& y) const;
+
+private:
+	void buildPartitions();
+	void multiplySlices(int begin, int end, const float* x, float* y) const;
+	void multiplySlicesDouble(int begin, int end, const double* x, double* y) const;
+	void multiplySlices3(int begin, int end, const float* x, float* y) const;
+
+	int mRows;
+	int mCols;
+	int mNonZeros;
+
+	std::vector< int > mSliceOffsets; // first stored entry of each slice
+	std::vector< int > mSliceWidths;  // padded row length of each slice
+	std::vector< int > mColumns;
+	std::vector< float > mValues;
+
+	std::vector< int > mPartitions; // slice ranges handed to the threads
+	ThreadPool* mPool;
+};
+
+#endif
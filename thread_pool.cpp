@@ -0,0 +1,157 @@
+#include "thread_pool.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+
+struct ThreadPool::ParallelJob {
+	ThreadPool* pool;
+	TaskFunction fn;
+	const void* context;
+	int numTasks;
+	std::atomic< int > next;
+	std::atomic< int > done;
+	// The caller plus the helpers that have not finished with the job
+	std::atomic< int > refs;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+
+ThreadPool::ThreadPool(int numThreads) : mQueueHead(0), mQueueSize(0), mStop(false) {
+	if (numThreads <= 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (int i = 0; i < numThreads; ++i) {
+		mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard< std::mutex > lock(mMutex);
+		mStop = true;
+	}
+	mCondition.notify_all();
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+}
+
+int ThreadPool::size() const {
+	return mWorkers.size();
+}
+
+std::future< void > ThreadPool::submit(std::function< void() > task) {
+	auto packaged = std::make_shared< std::packaged_task< void() > >(task);
+	std::future< void > result = packaged->get_future();
+	{
+		std::lock_guard< std::mutex > lock(mMutex);
+		pushTask([packaged]() { (*packaged)(); });
+	}
+	mCondition.notify_one();
+	return result;
+}
+
+void ThreadPool::runParallel(int numTasks, TaskFunction fn, const void* context) {
+	if (numTasks <= 0) {
+		return;
+	}
+	if (numTasks == 1 || mWorkers.empty()) {
+		for (int i = 0; i < numTasks; ++i) {
+			fn(context, i);
+		}
+		return;
+	}
+
+	// Helpers and the caller pull task indices from a shared counter. The
+	// caller only waits for the tasks themselves, never for helpers that
+	// have not started yet, so nested calls cannot deadlock. A job goes
+	// back to the free list once the last helper has let go of it.
+	int numHelpers = std::min((int)mWorkers.size(), numTasks - 1);
+	ParallelJob* job;
+	{
+		std::lock_guard< std::mutex > lock(mMutex);
+		if (mFreeJobs.empty()) {
+			mJobs.emplace_back(new ParallelJob);
+			mJobs.back()->pool = this;
+			mFreeJobs.push_back(mJobs.back().get());
+		}
+		job = mFreeJobs.back();
+		mFreeJobs.pop_back();
+		job->fn = fn;
+		job->context = context;
+		job->numTasks = numTasks;
+		job->next = 0;
+		job->done = 0;
+		job->refs = numHelpers + 1;
+		for (int i = 0; i < numHelpers; ++i) {
+			pushTask([job]() {
+				job->pool->runTasks(job);
+				job->pool->releaseJob(job);
+			});
+		}
+	}
+	mCondition.notify_all();
+
+	runTasks(job);
+	{
+		std::unique_lock< std::mutex > lock(job->mutex);
+		job->finished.wait(lock, [&]() { return job->done.load() == numTasks; });
+	}
+	releaseJob(job);
+}
+
+void ThreadPool::runTasks(ParallelJob* job) {
+	int i;
+	while ((i = job->next.fetch_add(1)) < job->numTasks) {
+		job->fn(job->context, i);
+		if (job->done.fetch_add(1) + 1 == job->numTasks) {
+			std::lock_guard< std::mutex > lock(job->mutex);
+			job->finished.notify_all();
+		}
+	}
+}
+
+void ThreadPool::releaseJob(ParallelJob* job) {
+	if (job->refs.fetch_sub(1) == 1) {
+		std::lock_guard< std::mutex > lock(mMutex);
+		mFreeJobs.push_back(job);
+	}
+}
+
+void ThreadPool::pushTask(std::function< void() > task) {
+	if (mQueueSize == mQueue.size()) {
+		std::vector< std::function< void() > > grown(std::max< size_t >(16, 2 * mQueue.size()));
+		for (size_t k = 0; k < mQueueSize; ++k) {
+			grown[k] = std::move(mQueue[(mQueueHead + k) % mQueue.size()]);
+		}
+		mQueue.swap(grown);
+		mQueueHead = 0;
+	}
+	mQueue[(mQueueHead + mQueueSize) % mQueue.size()] = std::move(task);
+	++mQueueSize;
+}
+
+ThreadPool& ThreadPool::global() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::workerLoop() {
+	TRACE_THREAD_NAME("pool worker");
+	PERF_THREAD_ATTACH();
+	while (true) {
+		std::function< void() > task;
+		{
+			std::unique_lock< std::mutex > lock(mMutex);
+			mCondition.wait(lock, [this]() { return mStop || mQueueSize > 0; });
+			if (mStop && mQueueSize == 0) {
+				return;
+			}
+			task = std::move(mQueue[mQueueHead]);
+			mQueueHead = (mQueueHead + 1) % mQueue.size();
+			--mQueueSize;
+		}
+		task();
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed-size pool of worker threads shared by the parallel mesh kernels. */
+class ThreadPool {
+public:
+	/* numThreads <= 0 uses the hardware concurrency. */
+	explicit ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	int size() const;
+
+	/* Queue a task and return a future for its completion. */
+	std::future< void > submit(std::function< void() > task);
+
+	/* Run fn(i) for every i in [0, numTasks) and wait for all of them.
+	 * The calling thread takes part, so this is safe to call from inside
+	 * a pool task. fn is any callable taking an int and is used in place,
+	 * so once the pool has warmed up a call allocates nothing. */
+	template < class Fn >
+	void parallelFor(int numTasks, const Fn& fn) {
+		runParallel(numTasks, &ThreadPool::invoke< Fn >, &fn);
+	}
+
+	/* Process-wide pool used by the kernels when none is given. */
+	static ThreadPool& global();
+
+private:
+	typedef void (*TaskFunction)(const void* fn, int i);
+
+	template < class Fn >
+	static void invoke(const void* fn, int i) {
+		(*static_cast< const Fn* >(fn))(i);
+	}
+
+	/* State of one parallelFor, recycled through mFreeJobs. */
+	struct ParallelJob;
+
+	void runParallel(int numTasks, TaskFunction fn, const void* context);
+	void runTasks(ParallelJob* job);
+	void releaseJob(ParallelJob* job);
+	/* Append to the task ring; mMutex must be held. */
+	void pushTask(std::function< void() > task);
+	void workerLoop();
+
+	std::vector< std::thread > mWorkers;
+	// Ring of queued tasks, grown when full and otherwise reused
+	std::vector< std::function< void() > > mQueue;
+	size_t mQueueHead;
+	size_t mQueueSize;
+	std::vector< std::unique_ptr< ParallelJob > > mJobs;
+	std::vector< ParallelJob* > mFreeJobs;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStop;
+};
+
+#endif
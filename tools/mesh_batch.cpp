@@ -0,0 +1,333 @@
+/* Headless batch processing: load, run a pipeline of stages, save.
+ *
+ * Usage: mesh_batch [options] pipeline input...
+ *
+ *   pipeline   comma-separated stages, each a name followed by
+ *              colon-separated flags and key=value parameters:
+ *                explicit[:cot|:uniform][:lambda=1][:iters=1]
+ *                implicit[:cot|:uniform][:lambda=1][:iters=1][:mixed]
+ *                taubin[:cot|:uniform][:lambda=0.5][:mu=-0.53][:degree=10]
+ *                chebyshev[:cot|:uniform][:band=0.25][:degree=10]
+ *                gauss-seidel[:cot|:uniform][:lambda=1][:sweeps=1]
+ *                normals
+ *                stats
+ *              e.g. implicit:cot:lambda=1:iters=10,normals
+ *   input      mesh files or quoted glob patterns such as "*.obj"
+ *
+ *   -o dir       output directory, default "."; results keep the input
+ *                file name with the extension of --format
+ *   --format f   ply, obj or mbin, default ply
+ *   --jobs n     files processed concurrently, default all cores
+ *   --no-save    run the pipeline without writing results
+ *   --trace f    write a Chrome trace of the run (MESH_TRACE builds)
+ *
+ * Every file prints its per-stage timings when done, and a summary per
+ * stage closes the run. Exits with 1 if any file failed. */
+#include "laplacian.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "smoothing.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <direct.h>
+#include <windows.h>
+#else
+#include <glob.h>
+#include <sys/stat.h>
+#endif
+
+struct Stage {
+	std::string name;
+	std::string spec;
+	bool cotangentWeights = true;
+	bool mixed = false;
+	double lambda = 1.0;
+	double mu = -0.53;
+	double band = 0.25;
+	int iterations = 1;
+};
+
+/* Parse one stage; returns false with a message on bad input. */
+static bool _parseStage(const std::string& spec, Stage& stage) {
+	std::vector< std::string > parts;
+	size_t begin = 0;
+	while (true) {
+		size_t end = spec.find(':', begin);
+		parts.push_back(spec.substr(begin, end - begin));
+		if (end == std::string::npos) {
+			break;
+		}
+		begin = end + 1;
+	}
+	stage.name = parts[0];
+	stage.spec = spec;
+	if (stage.name == "taubin") {
+		stage.lambda = 0.5;
+		stage.iterations = 10;
+	} else if (stage.name == "chebyshev") {
+		stage.iterations = 10;
+	} else if (stage.name != "explicit" && stage.name != "implicit" && stage.name != "gauss-seidel"
+	           && stage.name != "normals" && stage.name != "stats") {
+		std::fprintf(stderr, "unknown stage '%s'\n", stage.name.c_str());
+		return false;
+	}
+
+	for (size_t i = 1; i < parts.size(); ++i) {
+		const std::string& part = parts[i];
+		size_t equals = part.find('=');
+		std::string key = part.substr(0, equals);
+		double value = equals == std::string::npos ? 0.0 : std::atof(part.c_str() + equals + 1);
+		if (key == "cot") {
+			stage.cotangentWeights = true;
+		} else if (key == "uniform") {
+			stage.cotangentWeights = false;
+		} else if (key == "mixed") {
+			stage.mixed = true;
+		} else if (key == "lambda") {
+			stage.lambda = value;
+		} else if (key == "mu") {
+			stage.mu = value;
+		} else if (key == "band") {
+			stage.band = value;
+		} else if (key == "iters" || key == "degree" || key == "sweeps") {
+			stage.iterations = std::max(1, int(value));
+		} else {
+			std::fprintf(stderr, "unknown parameter '%s' in stage '%s'\n", part.c_str(), spec.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static void _runStage(Mesh& mesh, LaplacianCache& cache, const Stage& stage, std::string& log) {
+	if (stage.name == "explicit") {
+		std::vector< int > all(mesh.vertices().size());
+		std::iota(all.begin(), all.end(), 0);
+		VertexRegion region = vertexRegion(mesh, all);
+		for (int i = 0; i < stage.iterations; ++i) {
+			regionUmbrellaSmooth(mesh, region, stage.cotangentWeights, stage.lambda);
+		}
+	} else if (stage.name == "implicit") {
+		ImplicitSmoothOptions options;
+		options.cotangentWeights = stage.cotangentWeights;
+		options.lambda = stage.lambda;
+		options.solve.precision = stage.mixed ? SOLVER_MIXED : SOLVER_SINGLE;
+		for (int i = 0; i < stage.iterations; ++i) {
+			implicitSmooth(mesh, cache, options);
+		}
+	} else if (stage.name == "taubin" || stage.name == "chebyshev") {
+		PolynomialSmoothOptions options;
+		options.cotangentWeights = stage.cotangentWeights;
+		options.filter = stage.name == "taubin" ? FILTER_TAUBIN : FILTER_CHEBYSHEV;
+		options.degree = stage.iterations;
+		options.lambda = stage.lambda;
+		options.mu = stage.mu;
+		options.passBand = stage.band;
+		polynomialSmooth(mesh, cache, options);
+	} else if (stage.name == "gauss-seidel") {
+		GaussSeidelSmoothOptions options;
+		options.cotangentWeights = stage.cotangentWeights;
+		options.lambda = stage.lambda;
+		options.sweeps = stage.iterations;
+		gaussSeidelSmooth(mesh, cache, options);
+	} else if (stage.name == "normals") {
+		mesh.computeVertexNormals();
+	} else if (stage.name == "stats") {
+		std::vector< int > stats = mesh.collectMeshStats();
+		char line[160];
+		std::snprintf(line, sizeof(line), "    V %d  E %d  F %d  B %d  C %d  G %d\n",
+		              stats[0], stats[1], stats[2], stats[3], stats[4], stats[5]);
+		log += line;
+	}
+}
+
+/* Expand a glob pattern; plain names pass through unchanged. */
+static std::vector< std::string > _expand(const std::string& pattern) {
+	std::vector< std::string > files;
+	if (pattern.find_first_of("*?[") == std::string::npos) {
+		files.push_back(pattern);
+		return files;
+	}
+#ifdef _WIN32
+	std::string directory;
+	size_t slash = pattern.find_last_of("/\\");
+	if (slash != std::string::npos) {
+		directory = pattern.substr(0, slash + 1);
+	}
+	WIN32_FIND_DATAA found;
+	HANDLE handle = FindFirstFileA(pattern.c_str(), &found);
+	if (handle != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				files.push_back(directory + found.cFileName);
+			}
+		} while (FindNextFileA(handle, &found));
+		FindClose(handle);
+	}
+#else
+	glob_t matches;
+	if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+		for (size_t i = 0; i < matches.gl_pathc; ++i) {
+			files.push_back(matches.gl_pathv[i]);
+		}
+	}
+	globfree(&matches);
+#endif
+	if (files.empty()) {
+		std::fprintf(stderr, "no files match %s\n", pattern.c_str());
+	}
+	return files;
+}
+
+static void _makeDirectory(const std::string& path) {
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+static std::string _outputName(const std::string& input, const std::string& directory, const std::string& format) {
+	size_t slash = input.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+	name = name.substr(0, name.find_last_of('.'));
+	return directory + "/" + name + "." + format;
+}
+
+static double _seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	std::string outputDirectory = ".";
+	std::string format = "ply";
+	std::string traceFile;
+	int jobs = 0;
+	bool save = true;
+	std::vector< std::string > positional;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-o" && hasValue) {
+			outputDirectory = argv[++i];
+		} else if (arg == "--format" && hasValue) {
+			format = argv[++i];
+		} else if (arg == "--jobs" && hasValue) {
+			jobs = std::atoi(argv[++i]);
+		} else if (arg == "--trace" && hasValue) {
+			traceFile = argv[++i];
+		} else if (arg == "--no-save") {
+			save = false;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+			return 1;
+		} else {
+			positional.push_back(arg);
+		}
+	}
+	if (positional.size() < 2) {
+		std::fprintf(stderr, "usage: mesh_batch [-o dir] [--format ply|obj|mbin] [--jobs n] [--no-save] "
+		                     "[--trace file] pipeline input...\n");
+		return 1;
+	}
+	if (format != "ply" && format != "obj" && format != "mbin") {
+		std::fprintf(stderr, "unknown format %s\n", format.c_str());
+		return 1;
+	}
+
+	std::vector< Stage > stages;
+	const std::string& pipeline = positional[0];
+	for (size_t begin = 0; begin <= pipeline.size();) {
+		size_t end = std::min(pipeline.find(',', begin), pipeline.size());
+		Stage stage;
+		if (!_parseStage(pipeline.substr(begin, end - begin), stage)) {
+			return 1;
+		}
+		stages.push_back(stage);
+		begin = end + 1;
+	}
+	std::vector< std::string > inputs;
+	for (size_t i = 1; i < positional.size(); ++i) {
+		std::vector< std::string > files = _expand(positional[i]);
+		inputs.insert(inputs.end(), files.begin(), files.end());
+	}
+	if (save) {
+		_makeDirectory(outputDirectory);
+	}
+
+	// Per-stage totals over all files: load, the stages, save
+	std::vector< std::string > columns(1, "load");
+	for (const Stage& stage : stages) {
+		columns.push_back(stage.spec);
+	}
+	columns.push_back("save");
+	std::vector< double > totals(columns.size(), 0.0);
+	std::mutex mutex;
+	int failures = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	// One task per file; the kernels inside share the global pool
+	ThreadPool pool(jobs <= 0 ? 0 : std::min< int >(jobs, inputs.size()));
+	auto process = [&](const std::string& input) {
+		std::vector< double > times(columns.size(), 0.0);
+		std::string log;
+		bool ok = true;
+
+		Mesh mesh;
+		auto stageStart = std::chrono::steady_clock::now();
+		ok = mesh.loadMeshFile(input);
+		times[0] = _seconds(stageStart);
+		if (ok) {
+			LaplacianCache cache;
+			for (size_t s = 0; s < stages.size(); ++s) {
+				stageStart = std::chrono::steady_clock::now();
+				_runStage(mesh, cache, stages[s], log);
+				times[s + 1] = _seconds(stageStart);
+			}
+			if (save) {
+				stageStart = std::chrono::steady_clock::now();
+				ok = saveMesh(mesh, _outputName(input, outputDirectory, format));
+				times.back() = _seconds(stageStart);
+			}
+		}
+
+		std::lock_guard< std::mutex > lock(mutex);
+		std::printf("%s: %s, %d vertices\n", input.c_str(), ok ? "done" : "FAILED", (int)mesh.vertices().size());
+		for (size_t c = 0; c < columns.size(); ++c) {
+			std::printf("  %-36s %10.3f ms\n", columns[c].c_str(), 1e3 * times[c]);
+			totals[c] += times[c];
+		}
+		std::fputs(log.c_str(), stdout);
+		std::fflush(stdout);
+		failures += ok ? 0 : 1;
+	};
+	std::vector< std::future< void > > pending;
+	for (const std::string& input : inputs) {
+		pending.push_back(pool.submit([&process, &input]() { process(input); }));
+	}
+	for (std::future< void >& task : pending) {
+		task.get();
+	}
+
+	std::printf("\n%d files, %d failed, %.3f s wall with %d jobs\n", (int)inputs.size(), failures,
+	            _seconds(start), pool.size());
+	for (size_t c = 0; c < columns.size(); ++c) {
+		std::printf("  %-36s %10.3f ms total\n", columns[c].c_str(), 1e3 * totals[c]);
+	}
+	if (!traceFile.empty()) {
+		writeChromeTrace(traceFile);
+	}
+	return failures || inputs.empty() ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/* Command-line client of mesh_daemon.
+ *
+ * Usage: mesh_client [--socket path] command
+ *
+ *   load file             load a mesh, print its id and statistics
+ *   smooth id method      method is a name followed by colon-separated
+ *                         flags and key=value parameters:
+ *                           explicit[:cot|:uniform][:lambda=1][:iters=1]
+ *                           implicit[:cot|:uniform][:lambda=1][:iters=1]
+ *                           taubin[:cot|:uniform][:lambda=0.5][:mu=-0.53][:degree=10]
+ *                           chebyshev[:cot|:uniform][:band=0.25][:degree=10]
+ *                           gauss-seidel[:cot|:uniform][:lambda=1][:sweeps=1]
+ *                           constrained[:cot|:uniform][:lambda=1] index...
+ *                         constrained pins the listed vertex indices
+ *   stats id              print statistics and resident bytes
+ *   positions id [file]   fetch the positions; written to file as raw
+ *                         float xyz, or summarized on stdout
+ *   reset id              restore the loaded positions
+ *   unload id             drop the mesh
+ *   shutdown              stop the daemon
+ *
+ * The socket defaults to /tmp/mesh_daemon.sock. Exits with 1 when the
+ * request fails. */
+#include "mesh_service.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static void _printInfo(std::uint32_t id, const MeshServiceInfo& info) {
+	std::printf("mesh %u: %d vertices, %d edges, %d faces, %d boundary loops, %d components, genus %d\n", id,
+	            info.stats[0], info.stats[1], info.stats[2], info.stats[3], info.stats[4], info.stats[5]);
+	std::printf("resident: %llu mesh bytes, %llu cache bytes\n", (unsigned long long)info.meshBytes,
+	            (unsigned long long)info.cacheBytes);
+}
+
+/* Parse a method spec as mesh_batch parses its stages. */
+static bool _parseMethod(const std::string& spec, SmoothRequest& request) {
+	std::vector< std::string > parts;
+	size_t begin = 0;
+	while (true) {
+		size_t end = spec.find(':', begin);
+		parts.push_back(spec.substr(begin, end - begin));
+		if (end == std::string::npos) {
+			break;
+		}
+		begin = end + 1;
+	}
+	const std::string& name = parts[0];
+	if (name == "explicit") {
+		request.method = SMOOTH_EXPLICIT;
+	} else if (name == "implicit") {
+		request.method = SMOOTH_IMPLICIT;
+	} else if (name == "taubin") {
+		request.method = SMOOTH_TAUBIN;
+		request.lambda = 0.5f;
+	} else if (name == "chebyshev") {
+		request.method = SMOOTH_CHEBYSHEV;
+	} else if (name == "gauss-seidel") {
+		request.method = SMOOTH_GAUSS_SEIDEL;
+	} else if (name == "constrained") {
+		request.method = SMOOTH_CONSTRAINED;
+	} else {
+		std::fprintf(stderr, "unknown method '%s'\n", name.c_str());
+		return false;
+	}
+
+	for (size_t i = 1; i < parts.size(); ++i) {
+		const std::string& part = parts[i];
+		size_t equals = part.find('=');
+		std::string key = part.substr(0, equals);
+		double value = equals == std::string::npos ? 0.0 : std::atof(part.c_str() + equals + 1);
+		if (key == "cot") {
+			request.cotangentWeights = 1;
+		} else if (key == "uniform") {
+			request.cotangentWeights = 0;
+		} else if (key == "lambda") {
+			request.lambda = value;
+		} else if (key == "mu") {
+			request.mu = value;
+		} else if (key == "band") {
+			request.passBand = value;
+		} else if (key == "iters" || key == "sweeps") {
+			request.iterations = std::max(1, int(value));
+		} else if (key == "degree") {
+			request.degree = std::max(1, int(value));
+		} else {
+			std::fprintf(stderr, "unknown parameter '%s' in '%s'\n", part.c_str(), spec.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string socketPath = "/tmp/mesh_daemon.sock";
+	int first = 1;
+	if (argc > 2 && std::string(argv[1]) == "--socket") {
+		socketPath = argv[2];
+		first = 3;
+	}
+	std::vector< std::string > args(argv + first, argv + argc);
+	if (args.empty()) {
+		std::fprintf(stderr, "usage: mesh_client [--socket path] load file | smooth id method [index...] | stats id |"
+		                     " positions id [file] | reset id | unload id | shutdown\n");
+		return 1;
+	}
+
+	MeshClient client;
+	if (!client.connect(socketPath)) {
+		std::fprintf(stderr, "%s\n", client.error().c_str());
+		return 1;
+	}
+	const std::string& command = args[0];
+	std::uint32_t id = args.size() > 1 ? std::strtoul(args[1].c_str(), nullptr, 10) : 0;
+	bool ok = false;
+	if (command == "load" && args.size() == 2) {
+		MeshServiceInfo info;
+		ok = client.load(args[1], id, &info);
+		if (ok) {
+			_printInfo(id, info);
+		}
+	} else if (command == "smooth" && args.size() >= 3) {
+		SmoothRequest request;
+		if (!_parseMethod(args[2], request)) {
+			return 1;
+		}
+		std::vector< int > pinned;
+		for (size_t i = 3; i < args.size(); ++i) {
+			pinned.push_back(std::atoi(args[i].c_str()));
+		}
+		SmoothReply reply;
+		ok = client.smooth(id, request, &reply, pinned);
+		if (ok) {
+			std::printf("%.6f s in the service, %u solver iterations, %u Laplacian builds, %u factorizations\n",
+			            reply.seconds, reply.solverIterations, reply.laplacianBuilds, reply.factorizations);
+		}
+	} else if (command == "stats" && args.size() == 2) {
+		MeshServiceInfo info;
+		ok = client.stats(id, info);
+		if (ok) {
+			_printInfo(id, info);
+		}
+	} else if (command == "positions" && (args.size() == 2 || args.size() == 3)) {
+		std::vector< float > xyz;
+		ok = client.positions(id, xyz);
+		if (ok && args.size() == 3) {
+			FILE* out = std::fopen(args[2].c_str(), "wb");
+			ok = out && std::fwrite(xyz.data(), sizeof(float), xyz.size(), out) == xyz.size();
+			if (out) {
+				std::fclose(out);
+			}
+			if (!ok) {
+				std::fprintf(stderr, "cannot write %s\n", args[2].c_str());
+				return 1;
+			}
+		} else if (ok) {
+			std::printf("%zu vertices", xyz.size() / 3);
+			if (xyz.size() >= 3) {
+				std::printf(", first at (%g, %g, %g)", xyz[0], xyz[1], xyz[2]);
+			}
+			std::printf("\n");
+		}
+	} else if (command == "reset" && args.size() == 2) {
+		ok = client.reset(id);
+	} else if (command == "unload" && args.size() == 2) {
+		ok = client.unload(id);
+	} else if (command == "shutdown" && args.size() == 1) {
+		ok = client.shutdown();
+	} else {
+		std::fprintf(stderr, "bad command; run without arguments for usage\n");
+		return 1;
+	}
+	if (!ok) {
+		std::fprintf(stderr, "%s failed: %s\n", command.c_str(), client.error().c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,74 @@
+/* Resident mesh service.
+ *
+ * Usage: mesh_daemon [--socket path] [--connections n] [--idle-timeout s]
+ *                    [--trace file]
+ *
+ *   --socket path      Unix-domain socket to listen at, default
+ *                      /tmp/mesh_daemon.sock; readable by the owner only
+ *   --connections n    clients served at once, default all cores
+ *   --idle-timeout s   close connections idle for s seconds, default 60
+ *   --trace file       write a Chrome trace on exit (MESH_TRACE builds)
+ *
+ * Loaded meshes stay in memory with their Laplacians, workspaces and
+ * factorizations until unloaded, so clients such as mesh_client pay for
+ * parsing and half-edge construction once per mesh. The protocol is
+ * described in mesh_service.h. Runs until SIGINT, SIGTERM or a shutdown
+ * request. */
+#include "mesh_service.h"
+#include "trace.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static MeshServer* gServer = nullptr;
+
+static void _onSignal(int) {
+	if (gServer) {
+		gServer->stop();
+	}
+}
+
+int main(int argc, char** argv) {
+	std::string socketPath = "/tmp/mesh_daemon.sock";
+	std::string traceFile;
+	int connections = 0;
+	int idleSeconds = 60;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--socket" && hasValue) {
+			socketPath = argv[++i];
+		} else if (arg == "--connections" && hasValue) {
+			connections = std::atoi(argv[++i]);
+		} else if (arg == "--idle-timeout" && hasValue) {
+			idleSeconds = std::atoi(argv[++i]);
+		} else if (arg == "--trace" && hasValue) {
+			traceFile = argv[++i];
+		} else {
+			std::fprintf(stderr, "usage: mesh_daemon [--socket path] [--connections n] [--idle-timeout s] "
+			                     "[--trace file]\n");
+			return 1;
+		}
+	}
+
+	MeshServer server(connections, idleSeconds);
+	if (!server.start(socketPath)) {
+		return 1;
+	}
+	gServer = &server;
+	std::signal(SIGINT, _onSignal);
+	std::signal(SIGTERM, _onSignal);
+#ifdef SIGPIPE
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+	std::fprintf(stderr, "mesh_daemon listening at %s\n", socketPath.c_str());
+	server.run();
+	gServer = nullptr;
+	std::fprintf(stderr, "mesh_daemon stopping with %d meshes resident\n", server.numMeshes());
+
+	if (!traceFile.empty() && !writeChromeTrace(traceFile)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,260 @@
+#include "trace.h"
+#include <fstream>
+#include <iostream>
+
+#ifdef MESH_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+static const int RING_SIZE = 1 << 16; // events per thread, a power of two
+
+/* Slots are atomics so that a dump racing with the writer is well
+ * defined; relaxed stores cost the same as plain ones. */
+struct _TraceEvent {
+	std::atomic< const char* > name;
+	std::atomic< std::uint64_t > start;
+	std::atomic< std::uint64_t > end;
+};
+
+/* Single-writer ring: only the owning thread pushes. mHead counts every
+ * event ever pushed and is published after the slot is filled. */
+struct _TraceRing {
+	_TraceRing(int id) : events(new _TraceEvent[RING_SIZE]), head(0), floor(0), threadName(nullptr), thread(id) {}
+
+	std::unique_ptr< _TraceEvent[] > events;
+	std::atomic< std::uint64_t > head;
+	std::atomic< std::uint64_t > floor; // events below were cleared
+	std::atomic< const char* > threadName;
+	int thread;
+};
+
+/* Rings are never freed, so events of finished threads stay exportable. */
+static std::mutex& _registryMutex() {
+	static std::mutex mutex;
+	return mutex;
+}
+
+static std::vector< std::unique_ptr< _TraceRing > >& _registry() {
+	static std::vector< std::unique_ptr< _TraceRing > > rings;
+	return rings;
+}
+
+static _TraceRing& _threadRing() {
+	thread_local _TraceRing* ring = nullptr;
+	if (!ring) {
+		std::lock_guard< std::mutex > lock(_registryMutex());
+		std::vector< std::unique_ptr< _TraceRing > >& rings = _registry();
+		rings.emplace_back(new _TraceRing(rings.size() + 1));
+		ring = rings.back().get();
+	}
+	return *ring;
+}
+
+void traceComplete(const char* name, std::uint64_t start, std::uint64_t end) {
+	_TraceRing& ring = _threadRing();
+	std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+	_TraceEvent& event = ring.events[head & (RING_SIZE - 1)];
+	event.name.store(name, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.end.store(end, std::memory_order_relaxed);
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name) {
+	_threadRing().threadName.store(name, std::memory_order_relaxed);
+}
+
+static const int COUNTER_SERIES = 8; // series kept per counter sample
+
+struct _CounterSample {
+	const char* name; // interned, see _internName
+	std::uint64_t time;
+	int count;
+	const char* series[COUNTER_SERIES];
+	double values[COUNTER_SERIES];
+};
+
+/* A ring like the thread rings, but shared and locked. The slots are
+ * allocated by the first sample and names are copied once each, so a
+ * sample allocates nothing once its scope name has been seen. */
+static std::mutex _counterMutex;
+static std::unique_ptr< _CounterSample[] > _counterSamples;
+static std::uint64_t _counterHead = 0;
+static std::uint64_t _counterFloor = 0;
+static std::set< std::string, std::less<> > _counterNames; // never shrinks
+
+static const char* _internName(const char* name) {
+	auto found = _counterNames.find(name);
+	if (found == _counterNames.end()) {
+		found = _counterNames.emplace(name).first;
+	}
+	return found->c_str();
+}
+
+void traceCounters(const char* name, std::uint64_t time, const char* const* series, const double* values, int count) {
+	std::lock_guard< std::mutex > lock(_counterMutex);
+	if (!_counterSamples) {
+		_counterSamples.reset(new _CounterSample[RING_SIZE]);
+	}
+	_CounterSample& sample = _counterSamples[_counterHead & (RING_SIZE - 1)];
+	sample.name = _internName(name);
+	sample.time = time;
+	sample.count = std::min(count, COUNTER_SERIES);
+	for (int i = 0; i < sample.count; ++i) {
+		sample.series[i] = series[i];
+		sample.values[i] = values[i];
+	}
+	++_counterHead;
+}
+
+struct _Snapshot {
+	const char* name;
+	std::uint64_t start;
+	std::uint64_t end;
+	int thread;
+};
+
+static void _appendEscaped(std::ostringstream& out, const char* text) {
+	for (; *text; ++text) {
+		if (*text == '"' || *text == '\\') {
+			out << '\\';
+		}
+		out << *text;
+	}
+}
+
+/* Copy the buffered events of every thread, and the thread names. */
+static void _snapshot(std::vector< _Snapshot >& events, std::vector< std::pair< int, const char* > >& names) {
+	std::lock_guard< std::mutex > lock(_registryMutex());
+	for (const std::unique_ptr< _TraceRing >& ring : _registry()) {
+		std::uint64_t head = ring->head.load(std::memory_order_acquire);
+		std::uint64_t first = std::max(ring->floor.load(), head > RING_SIZE ? head - RING_SIZE : 0);
+		size_t count = events.size();
+		for (std::uint64_t i = first; i < head; ++i) {
+			const _TraceEvent& event = ring->events[i & (RING_SIZE - 1)];
+			events.push_back({event.name.load(std::memory_order_relaxed),
+			                  event.start.load(std::memory_order_relaxed),
+			                  event.end.load(std::memory_order_relaxed), ring->thread});
+		}
+		// Drop what the writer may have overwritten meanwhile, including
+		// the slot of an event it is filling but has not published yet
+		std::uint64_t after = ring->head.load(std::memory_order_acquire);
+		std::uint64_t valid = after + 1 > RING_SIZE ? after + 1 - RING_SIZE : 0;
+		if (valid > first) {
+			size_t stale = std::min< std::uint64_t >(valid - first, head - first);
+			events.erase(events.begin() + count, events.begin() + count + stale);
+		}
+		if (const char* name = ring->threadName.load()) {
+			names.push_back(std::make_pair(ring->thread, name));
+		}
+	}
+}
+
+std::string chromeTraceJson() {
+	std::vector< _Snapshot > events;
+	std::vector< std::pair< int, const char* > > names;
+	_snapshot(events, names);
+
+	std::vector< _CounterSample > counters;
+	{
+		std::lock_guard< std::mutex > lock(_counterMutex);
+		std::uint64_t first = std::max(_counterFloor, _counterHead > RING_SIZE ? _counterHead - RING_SIZE : 0);
+		for (std::uint64_t i = first; i < _counterHead; ++i) {
+			counters.push_back(_counterSamples[i & (RING_SIZE - 1)]);
+		}
+	}
+
+	std::uint64_t origin = ~std::uint64_t(0);
+	for (const _Snapshot& event : events) {
+		origin = std::min(origin, event.start);
+	}
+	for (const _CounterSample& sample : counters) {
+		origin = std::min(origin, sample.time);
+	}
+	std::ostringstream out;
+	out.precision(3);
+	out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for (const std::pair< int, const char* >& name : names) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << name.first
+		    << ",\"args\":{\"name\":\"";
+		_appendEscaped(out, name.second);
+		out << "\"}}";
+		first = false;
+	}
+	for (const _Snapshot& event : events) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"";
+		_appendEscaped(out, event.name);
+		out << "\",\"cat\":\"mesh\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+		    << ",\"ts\":" << (event.start - origin) * 1e-3 << ",\"dur\":" << (event.end - event.start) * 1e-3 << "}";
+		first = false;
+	}
+	for (const _CounterSample& sample : counters) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"";
+		_appendEscaped(out, sample.name);
+		out << "\",\"cat\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << (sample.time - origin) * 1e-3 << ",\"args\":{";
+		for (int i = 0; i < sample.count; ++i) {
+			out << (i ? ",\"" : "\"");
+			_appendEscaped(out, sample.series[i]);
+			out << "\":" << sample.values[i];
+		}
+		out << "}}";
+		first = false;
+	}
+	out << "\n]}\n";
+	return out.str();
+}
+
+double traceSeconds(const char* name) {
+	std::vector< _Snapshot > events;
+	std::vector< std::pair< int, const char* > > names;
+	_snapshot(events, names);
+	std::uint64_t total = 0;
+	for (const _Snapshot& event : events) {
+		if (event.name == name || std::strcmp(event.name, name) == 0) {
+			total += event.end - event.start;
+		}
+	}
+	return total * 1e-9;
+}
+
+void clearTrace() {
+	std::lock_guard< std::mutex > lock(_registryMutex());
+	for (const std::unique_ptr< _TraceRing >& ring : _registry()) {
+		ring->floor.store(ring->head.load(std::memory_order_acquire));
+	}
+	std::lock_guard< std::mutex > counterLock(_counterMutex);
+	_counterFloor = _counterHead;
+}
+
+#else
+
+std::string chromeTraceJson() {
+	return "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n";
+}
+
+double traceSeconds(const char*) {
+	return 0.0;
+}
+
+void clearTrace() {
+}
+
+#endif
+
+bool writeChromeTrace(const std::string& filename) {
+	std::ofstream out(filename.c_str());
+	out << chromeTraceJson();
+	if (!out) {
+		std::cout << __FUNCTION__ << ": cannot write " << filename << "\n";
+		return false;
+	}
+	return true;
+}
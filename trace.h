@@ -0,0 +1,78 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* Hot-path tracing without an external profiler. TRACE_SCOPE("name")
+ * records the time from the macro to the end of the enclosing block as
+ * one complete event. Every thread writes into its own fixed-size ring
+ * buffer without locks, so the newest events survive long jobs and the
+ * oldest are overwritten. The name must be a string literal, or at least
+ * outlive the trace: only the pointer is stored.
+ *
+ * Tracing is built with MESH_TRACE defined. Without it the macros expand
+ * to nothing and the dump functions write an empty trace. */
+
+#ifdef MESH_TRACE
+
+/* Nanoseconds on the steady clock. */
+inline std::uint64_t traceNow() {
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(
+	           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Append to the calling thread's buffer. */
+void traceComplete(const char* name, std::uint64_t start, std::uint64_t end);
+
+/* Label the calling thread in the exported trace. */
+void traceThreadName(const char* name);
+
+/* One sample of several named counter series, shown as a counter track.
+ * Meant for coarse events such as per-kernel hardware counters; samples
+ * go to a shared, locked buffer of the same size as a thread ring. The
+ * name is copied the first time it is seen, the series names are stored
+ * as pointers and only the first 8 series are kept. */
+void traceCounters(const char* name, std::uint64_t time, const char* const* series, const double* values, int count);
+
+class TraceScope {
+public:
+	explicit TraceScope(const char* name) : mName(name), mStart(traceNow()) {}
+	~TraceScope() { traceComplete(mName, mStart, traceNow()); }
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* mName;
+	std::uint64_t mStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+
+#endif
+
+/* All buffered events as Chrome trace JSON, which chrome://tracing and
+ * ui.perfetto.dev open. Safe to call while other threads keep tracing;
+ * events overwritten during the dump are left out. */
+std::string chromeTraceJson();
+bool writeChromeTrace(const std::string& filename);
+
+/* Total duration in seconds of the buffered events with the given name,
+ * over every thread. Lets a caller time one phase of a call that is
+ * instrumented anyway, from that very call. 0 without MESH_TRACE. */
+double traceSeconds(const char* name);
+
+/* Forget the events recorded so far, on every thread. */
+void clearTrace();
+
+#endif